@@ -0,0 +1,481 @@
+//
+//  OscBenchmarkApp.cpp
+//  OscBenchmark
+//
+//  Times building, copying and reading a /head message on its own, then sends
+//  from an osc::Sender to an osc::Listener over loopback at increasing rates,
+//  for each message shape the installation uses, and writes the results as
+//  JSON so changes to the OSC stack can be compared against a baseline.
+//    --out <path>          results file (default osc_benchmark.json next to the app)
+//    --duration <seconds>  length of each run (default 2)
+//    --port <n>            loopback port (default 7200)
+//    --transport <name>    udp, or shm for the same host shared memory ring (default udp)
+//  Every message starts with a sequence number and its send time in
+//  microseconds, so latency covers encode, the kernel, the listener's thread
+//  or shared memory ring, and the queue, up to the moment the consumer pops it.
+//  Each run first sends enough to go twice round the listener's queue, so
+//  allocation counts are for the steady state rather than slots filling up.
+//
+
+#include "cinder/app/AppBasic.h"
+#include "cinder/gl/gl.h"
+#include "cinder/Thread.h"
+#include "cinder/Utilities.h"
+#include "OscSender.h"
+#include "OscListener.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <new>
+#include <stdlib.h>
+
+using namespace ci;
+using namespace ci::app;
+using namespace std;
+
+// COUNTING ALLOCATOR
+// Every allocation in the process goes through here. The UI thread turns
+// counting off for itself in setup(), so a run's count divided by its messages
+// is the allocation cost per message on the sender, listener and consumer
+// threads, whatever draw() is doing meanwhile.
+#if defined( _MSC_VER )
+	#define THREAD_LOCAL __declspec( thread )
+#else
+	#define THREAD_LOCAL __thread
+#endif
+
+static std::atomic<uint64_t> sNumAllocations( 0 );
+static THREAD_LOCAL bool sIsCountingAllocations = true;
+
+void* operator new( size_t size )
+{
+	if( sIsCountingAllocations )
+		sNumAllocations.fetch_add( 1, std::memory_order_relaxed );
+	void *p = malloc( size ? size : 1 );
+	if( ! p )
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[]( size_t size )
+{
+	return operator new( size );
+}
+
+void operator delete( void *p ) throw()
+{
+	free( p );
+}
+
+void operator delete[]( void *p ) throw()
+{
+	free( p );
+}
+
+static int64_t getMicroseconds()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+struct RunResult {
+	string		mShape;
+	int			mRate;				// Messages per second asked for
+	uint32_t	mSent;
+	uint32_t	mReceived;
+	double		mSeconds;
+	double		mP50Us, mP99Us, mMaxUs;
+	double		mAllocationsPerMessage;
+	uint32_t	mQueueDrops;		// Listener's ring was full
+	uint32_t	mKernelDrops;		// Socket buffer overflowed, Linux only, or the shared memory ring was full
+};
+
+struct MessageResult {
+	string		mOperation;
+	double		mNsPerMessage;
+	double		mAllocationsPerMessage;	// Should stay 0 for a message this small
+};
+
+class OscBenchmarkApp : public AppBasic {
+  public:
+	void	prepareSettings( Settings *settings );
+	void	setup();
+	void	update();
+	void	draw();
+	void	shutdown();
+
+  private:
+	enum Shape { SHAPE_HEAD, SHAPE_SKELETON, SHAPE_STRINGS, SHAPE_NESTED_BUNDLE, NUM_SHAPES };
+
+	void		runSuite();
+	void		runMessageBenchmark();
+	RunResult	run( Shape shape, int rate );
+	void		fillMessage( Shape shape, osc::Message *message, int32_t sequence );
+	void		writeResults();
+	static const char*	getShapeName( Shape shape );
+
+	fs::path					mOutPath;
+	double						mDuration;
+	int							mPort;
+	bool						mUseSharedMemory;
+
+	std::shared_ptr<std::thread>	mThread;
+	std::mutex					mMutex;
+	vector<MessageResult>		mMessageResults;	// Guarded by mMutex
+	vector<RunResult>			mResults;		// Same
+	string						mStatus;		// Same
+	std::atomic<bool>			mIsFinished;
+};
+
+void OscBenchmarkApp::prepareSettings( Settings *settings )
+{
+	settings->setWindowSize( 480, 280 );
+}
+
+void OscBenchmarkApp::setup()
+{
+	sIsCountingAllocations = false;
+	mOutPath	= getAppPath() / "osc_benchmark.json";
+	mDuration	= 2.0;
+	mPort		= 7200;
+	mUseSharedMemory = false;
+	const vector<string> &args = getArgs();
+	for( size_t i = 1; i + 1 < args.size(); i++ ){
+		if( args[i] == "--out" )
+			mOutPath = args[++i];
+		else if( args[i] == "--duration" )
+			mDuration = fromString<double>( args[++i] );
+		else if( args[i] == "--port" )
+			mPort = fromString<int>( args[++i] );
+		else if( args[i] == "--transport" )
+			mUseSharedMemory = args[++i] == "shm";
+	}
+
+	mIsFinished = false;
+	mStatus = "starting";
+	mThread = std::shared_ptr<std::thread>( new std::thread( &OscBenchmarkApp::runSuite, this ) );
+}
+
+void OscBenchmarkApp::runSuite()
+{
+	static const int RATES[] = { 1000, 10000, 50000, 200000 };
+	static const int NUM_RATES = sizeof( RATES ) / sizeof( RATES[0] );
+
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mStatus = "message operations";
+	}
+	runMessageBenchmark();
+
+	for( int shape = 0; shape < NUM_SHAPES; shape++ ){
+		for( int r = 0; r < NUM_RATES; r++ ){
+			{
+				std::lock_guard<std::mutex> lock( mMutex );
+				mStatus = string( getShapeName( (Shape)shape ) ) + " at " + toString( RATES[r] ) + "/s";
+			}
+			RunResult result = run( (Shape)shape, RATES[r] );
+			std::lock_guard<std::mutex> lock( mMutex );
+			mResults.push_back( result );
+		}
+	}
+
+	writeResults();
+	mIsFinished = true;
+}
+
+void OscBenchmarkApp::runMessageBenchmark()
+{
+	static const int ITERATIONS = 1000000;
+	static const int NUM_OPERATIONS = 3;
+	static const char *OPERATIONS[NUM_OPERATIONS] = { "create", "copy", "read" };
+
+	// One of each first, so interning the address isn't counted
+	osc::Message source, copy;
+	source.setAddress( "/head" );
+	source.addFloatArg( 0.1f );
+	source.addFloatArg( 1.7f );
+	source.addFloatArg( -2.3f );
+	copy = source;
+
+	volatile float sink = 0;
+	for( int op = 0; op < NUM_OPERATIONS; op++ ){
+		uint64_t allocationsBefore = sNumAllocations.load();
+		int64_t start = getMicroseconds();
+		for( int i = 0; i < ITERATIONS; i++ ){
+			if( op == 0 ){
+				copy.clear();
+				copy.setAddress( "/head" );
+				copy.addFloatArg( 0.1f );
+				copy.addFloatArg( 1.7f );
+				copy.addFloatArg( (float)i );
+			}
+			else if( op == 1 )
+				copy = source;
+			else
+				sink = sink + source.getArgAsFloat( 0 ) + source.getArgAsFloat( 1 ) + source.getArgAsFloat( 2 ) + (float)source.getAddress().size();
+		}
+		MessageResult result;
+		result.mOperation				= OPERATIONS[op];
+		result.mNsPerMessage			= ( getMicroseconds() - start ) * 1000.0 / ITERATIONS;
+		result.mAllocationsPerMessage	= (double)( sNumAllocations.load() - allocationsBefore ) / ITERATIONS;
+		std::lock_guard<std::mutex> lock( mMutex );
+		mMessageResults.push_back( result );
+	}
+}
+
+const char* OscBenchmarkApp::getShapeName( Shape shape )
+{
+	switch( shape ){
+		case SHAPE_HEAD:			return "head";
+		case SHAPE_SKELETON:		return "skeleton";
+		case SHAPE_STRINGS:			return "strings";
+		case SHAPE_NESTED_BUNDLE:	return "nestedBundle";
+		default:					return "unknown";
+	}
+}
+
+void OscBenchmarkApp::fillMessage( Shape shape, osc::Message *message, int32_t sequence )
+{
+	message->clear();
+	switch( shape ){
+		case SHAPE_HEAD:
+		case SHAPE_NESTED_BUNDLE:
+			message->setAddress( "/head" );
+			break;
+		case SHAPE_SKELETON:
+			message->setAddress( "/skeleton" );
+			break;
+		case SHAPE_STRINGS:
+			message->setAddress( "/label" );
+			break;
+		default:
+			break;
+	}
+
+	// Header: sequence and send time, wrapped to 32 bits. Runs are far shorter than the wrap.
+	message->addIntArg( sequence );
+	message->addIntArg( (int32_t)getMicroseconds() );
+
+	// PAYLOAD
+	if( shape == SHAPE_HEAD || shape == SHAPE_NESTED_BUNDLE ){
+		message->addFloatArg( 0.1f );
+		message->addFloatArg( 1.7f );
+		message->addFloatArg( -2.3f );
+	}
+	else if( shape == SHAPE_SKELETON ){
+		// 20 joints, xyz each
+		for( int i = 0; i < 60; i++ )
+			message->addFloatArg( i * 0.01f );
+	}
+	else if( shape == SHAPE_STRINGS ){
+		message->addStringArg( "tracked" );
+		message->addStringArg( "a label long enough to spill out of the inline buffer" );
+	}
+}
+
+RunResult OscBenchmarkApp::run( Shape shape, int rate )
+{
+	// Nested bundles carry four messages each, two per inner bundle
+	static const int MESSAGES_PER_BUNDLE = 4;
+	static const int64_t TICK_US = 1000;
+	// Slots in the listener's queue, and with shared memory 1KB records in its ring
+	static const int QUEUE_CAPACITY = 16384;
+	// Twice round the queue, at 100 a tick, so every slot has grown to fit this shape
+	static const int WARMUP_MESSAGES = QUEUE_CAPACITY * 2;
+	static const int WARMUP_PER_TICK = 100;
+
+	osc::Listener listener;
+	osc::Sender sender;
+	if( mUseSharedMemory ){
+		listener.setupSharedMemory( "OscBenchmark", QUEUE_CAPACITY );
+		sender.setupSharedMemory( "OscBenchmark" );
+	}
+	else {
+		listener.setup( mPort, QUEUE_CAPACITY, 4 * 1024 * 1024 );
+		sender.setup( "127.0.0.1", mPort );
+	}
+
+	// CONSUMER
+	// Polls the queue like an app would, only much more often
+	std::atomic<bool> isSending( true );
+	uint32_t received = 0;
+	vector<double> latencies;
+	// With room to spare, growing it mid-run would show up as allocations
+	latencies.reserve( (size_t)( rate * mDuration ) + 4096 );
+	std::thread consumer( [&]() {
+		osc::Message message;
+		int64_t drainUntil = 0;
+		while( true ){
+			if( listener.getNextMessage( &message ) ){
+				// Warm up messages count backwards to 0
+				if( message.getArgAsInt32( 0 ) < 0 )
+					continue;
+				uint32_t sent = (uint32_t)message.getArgAsInt32( 1 );
+				latencies.push_back( (double)(int32_t)( (uint32_t)getMicroseconds() - sent ) );
+				received++;
+				continue;
+			}
+			// Give stragglers a moment once the sender's done
+			if( ! isSending ){
+				if( drainUntil == 0 )
+					drainUntil = getMicroseconds() + 200000;
+				else if( getMicroseconds() > drainUntil )
+					break;
+			}
+			std::this_thread::yield();
+		}
+	} );
+
+	// PRODUCER
+	osc::Message message;
+	osc::Bundle outer, inner[2];
+	// Queues one message, or a nested bundle of them, starting at sequence. Returns how many.
+	auto send = [&]( int32_t sequence ) -> int {
+		if( shape == SHAPE_NESTED_BUNDLE ){
+			outer.clear();
+			for( int b = 0; b < 2; b++ ){
+				inner[b].clear();
+				for( int m = 0; m < MESSAGES_PER_BUNDLE / 2; m++ ){
+					fillMessage( shape, &message, sequence++ );
+					inner[b].addMessage( message );
+				}
+				outer.addBundle( inner[b] );
+			}
+			sender.sendBundle( outer );
+			return MESSAGES_PER_BUNDLE;
+		}
+		fillMessage( shape, &message, sequence );
+		sender.queueMessage( message );
+		return 1;
+	};
+
+	// WARM UP
+	// A queue slot keeps whatever its arguments grew to, so until every slot has held a
+	// message of this shape the counts are the warm up, not the steady state
+	for( int32_t sequence = -WARMUP_MESSAGES; sequence < 0; ){
+		for( int n = 0; n < WARMUP_PER_TICK && sequence < 0; ){
+			int count = send( sequence );
+			sequence += count;
+			n += count;
+		}
+		sender.flush();
+		std::this_thread::sleep_for( std::chrono::microseconds( TICK_US ) );
+	}
+	std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+	uint32_t queueDropsBefore = listener.getNumDroppedMessages();
+	uint32_t kernelDropsBefore = listener.getNumDroppedPackets();
+
+	uint32_t sent = 0;
+	int64_t start = getMicroseconds();
+	int64_t end = start + (int64_t)( mDuration * 1000000.0 );
+	uint64_t allocationsBefore = sNumAllocations.load();
+	double owed = 0;
+
+	for( int64_t tick = start; tick < end; tick += TICK_US ){
+		owed += rate * ( TICK_US / 1000000.0 );
+		while( owed >= 1 ){
+			int count = send( (int32_t)sent );
+			sent += count;
+			owed -= count;
+		}
+		sender.flush();
+
+		int64_t wait = tick + TICK_US - getMicroseconds();
+		if( wait > 0 )
+			std::this_thread::sleep_for( std::chrono::microseconds( wait ) );
+	}
+	double seconds = ( getMicroseconds() - start ) / 1000000.0;
+	uint64_t allocations = sNumAllocations.load() - allocationsBefore;
+
+	isSending = false;
+	consumer.join();
+
+	RunResult result;
+	result.mShape					= getShapeName( shape );
+	result.mRate					= rate;
+	result.mSent					= sent;
+	result.mReceived				= received;
+	result.mSeconds					= seconds;
+	result.mAllocationsPerMessage	= sent ? (double)allocations / sent : 0;
+	result.mQueueDrops				= listener.getNumDroppedMessages() - queueDropsBefore;
+	result.mKernelDrops				= listener.getNumDroppedPackets() - kernelDropsBefore;
+
+	std::sort( latencies.begin(), latencies.end() );
+	result.mP50Us = result.mP99Us = result.mMaxUs = 0;
+	if( ! latencies.empty() ){
+		result.mP50Us	= latencies[latencies.size() / 2];
+		result.mP99Us	= latencies[std::min( latencies.size() - 1, latencies.size() * 99 / 100 )];
+		result.mMaxUs	= latencies.back();
+	}
+
+	listener.shutdown();
+	return result;
+}
+
+void OscBenchmarkApp::writeResults()
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+
+	std::ofstream out( mOutPath.string().c_str() );
+	out << "{" << std::endl;
+	out << "  \"durationSeconds\": " << mDuration << "," << std::endl;
+	out << "  \"transport\": \"" << ( mUseSharedMemory ? "shm" : "udp" ) << "\"," << std::endl;
+	out << "  \"message\": [" << std::endl;
+	for( size_t i = 0; i < mMessageResults.size(); i++ ){
+		const MessageResult &r = mMessageResults[i];
+		out << "    { \"operation\": \"" << r.mOperation << "\", \"nsPerMessage\": " << r.mNsPerMessage
+			<< ", \"allocationsPerMessage\": " << r.mAllocationsPerMessage << " }";
+		out << ( i + 1 < mMessageResults.size() ? "," : "" ) << std::endl;
+	}
+	out << "  ]," << std::endl;
+	out << "  \"runs\": [" << std::endl;
+	for( size_t i = 0; i < mResults.size(); i++ ){
+		const RunResult &r = mResults[i];
+		double dropRate = r.mSent ? 1.0 - (double)r.mReceived / r.mSent : 0;
+		out << "    { \"shape\": \"" << r.mShape << "\", \"rate\": " << r.mRate
+			<< ", \"sent\": " << r.mSent << ", \"received\": " << r.mReceived
+			<< ", \"messagesPerSecond\": " << r.mReceived / r.mSeconds
+			<< ", \"dropRate\": " << std::max( dropRate, 0.0 )
+			<< ", \"queueDrops\": " << r.mQueueDrops << ", \"kernelDrops\": " << r.mKernelDrops
+			<< ", \"p50Us\": " << r.mP50Us << ", \"p99Us\": " << r.mP99Us << ", \"maxUs\": " << r.mMaxUs
+			<< ", \"allocationsPerMessage\": " << r.mAllocationsPerMessage << " }";
+		out << ( i + 1 < mResults.size() ? "," : "" ) << std::endl;
+	}
+	out << "  ]" << std::endl << "}" << std::endl;
+
+	mStatus = "wrote " + mOutPath.string();
+	console() << "OscBenchmark: wrote " << mOutPath << std::endl;
+}
+
+void OscBenchmarkApp::update()
+{
+	if( mIsFinished )
+		quit();
+}
+
+void OscBenchmarkApp::draw()
+{
+	gl::clear( Color::black() );
+
+	std::lock_guard<std::mutex> lock( mMutex );
+	gl::drawString( mStatus, Vec2f( 10, 10 ) );
+	float y = 30;
+	for( size_t i = 0; i < mMessageResults.size(); i++, y += 12 ){
+		const MessageResult &r = mMessageResults[i];
+		gl::drawString( "/head " + r.mOperation + ": " + toString( r.mNsPerMessage ) + "ns, " + toString( r.mAllocationsPerMessage ) + " allocations", Vec2f( 10, y ) );
+	}
+	for( size_t i = 0; i < mResults.size(); i++, y += 12 ){
+		const RunResult &r = mResults[i];
+		gl::drawString( r.mShape + " " + toString( r.mRate ) + "/s: " + toString( r.mReceived ) + "/" + toString( r.mSent )
+			+ " p99 " + toString( (int)r.mP99Us ) + "us", Vec2f( 10, y ) );
+	}
+}
+
+void OscBenchmarkApp::shutdown()
+{
+	if( mThread )
+		mThread->join();
+}
+
+CINDER_APP_BASIC( OscBenchmarkApp, RendererGl )
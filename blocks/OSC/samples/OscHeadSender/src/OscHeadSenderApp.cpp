@@ -0,0 +1,204 @@
+//
+//  OscHeadSenderApp.cpp
+//  OscHeadSender
+//
+//  Stands in for the Kinect tracker: sends /head x y z in meters, walking a
+//  slow loop in front of the sensor, so the renderer can be driven without
+//  one. With --listen it's the other end instead, and reports how long
+//  messages took from being written to being popped off the listener's queue,
+//  so two copies measure delivery between processes.
+//    --shm <name>      write into the shared memory ring the listener created,
+//                      e.g. the name given to TerrainApp's --osc-shm
+//    --host <address>  otherwise send over UDP (default 127.0.0.1)
+//    --port <n>        (default 7111, TerrainApp's port)
+//    --rate <hz>       messages per second (default 100)
+//    --listen          receive and report latency instead of sending
+//  Start the listening side first, it owns the shared memory ring.
+//
+
+#include "cinder/app/AppBasic.h"
+#include "cinder/gl/gl.h"
+#include "cinder/Thread.h"
+#include "cinder/Utilities.h"
+#include "OscSender.h"
+#include "OscListener.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+using namespace ci;
+using namespace ci::app;
+using namespace std;
+
+class OscHeadSenderApp : public AppBasic {
+  public:
+	void	prepareSettings( Settings *settings );
+	void	setup();
+	void	draw();
+	void	shutdown();
+
+  private:
+	void	threadSend();
+	void	threadListen();
+	void	report( vector<double> *latencies, uint32_t dropped );
+
+	string						mSharedMemory;
+	string						mHost;
+	int							mPort;
+	double						mRate;
+	bool						mIsListening;
+
+	std::shared_ptr<std::thread>	mThread;
+	std::atomic<bool>			mIsRunning;
+	std::mutex					mMutex;
+	string						mStatus;		// Guarded by mMutex
+};
+
+void OscHeadSenderApp::prepareSettings( Settings *settings )
+{
+	settings->setWindowSize( 480, 120 );
+}
+
+void OscHeadSenderApp::setup()
+{
+	mHost		= "127.0.0.1";
+	mPort		= 7111;
+	mRate		= 100;
+	mIsListening = false;
+	const vector<string> &args = getArgs();
+	for( size_t i = 1; i < args.size(); i++ ){
+		if( args[i] == "--listen" )
+			mIsListening = true;
+		else if( i + 1 == args.size() )
+			break;
+		else if( args[i] == "--shm" )
+			mSharedMemory = args[++i];
+		else if( args[i] == "--host" )
+			mHost = args[++i];
+		else if( args[i] == "--port" )
+			mPort = fromString<int>( args[++i] );
+		else if( args[i] == "--rate" )
+			mRate = std::max( fromString<double>( args[++i] ), 1.0 );
+	}
+
+	mStatus = "starting";
+	mIsRunning = true;
+	if( mIsListening )
+		mThread = std::shared_ptr<std::thread>( new std::thread( &OscHeadSenderApp::threadListen, this ) );
+	else
+		mThread = std::shared_ptr<std::thread>( new std::thread( &OscHeadSenderApp::threadSend, this ) );
+}
+
+void OscHeadSenderApp::threadSend()
+{
+	osc::Sender sender;
+	try {
+		if( ! mSharedMemory.empty() )
+			sender.setupSharedMemory( mSharedMemory );
+		else
+			sender.setup( mHost, mPort );
+	}
+	catch( std::exception &exc ){
+		std::lock_guard<std::mutex> lock( mMutex );
+		mStatus = exc.what();
+		return;
+	}
+
+	// A slow loop about 2m in front of the sensor, at head height
+	osc::Message message;
+	std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+	std::chrono::microseconds period( (int64_t)( 1000000.0 / mRate ) );
+	uint32_t sent = 0;
+	double start = osc::getNetworkTime();
+	while( mIsRunning ){
+		double t = osc::getNetworkTime() - start;
+		message.clear();
+		message.setAddress( "/head" );
+		message.addFloatArg( 0.6f * (float)sin( t * 0.5 ) );
+		message.addFloatArg( 0.1f * (float)sin( t * 1.3 ) );
+		message.addFloatArg( 2.0f + 0.4f * (float)cos( t * 0.5 ) );
+		sender.sendMessage( message );
+		sent++;
+
+		if( sent % (uint32_t)mRate == 0 ){
+			std::lock_guard<std::mutex> lock( mMutex );
+			mStatus = "sent " + toString( sent ) + " to " + ( mSharedMemory.empty() ? mHost + ":" + toString( mPort ) : "shm " + mSharedMemory );
+		}
+
+		next += period;
+		std::this_thread::sleep_until( next );
+	}
+}
+
+void OscHeadSenderApp::threadListen()
+{
+	osc::Listener listener;
+	try {
+		if( ! mSharedMemory.empty() )
+			listener.setupSharedMemory( mSharedMemory );
+		else
+			listener.setup( mPort );
+	}
+	catch( std::exception &exc ){
+		std::lock_guard<std::mutex> lock( mMutex );
+		mStatus = exc.what();
+		return;
+	}
+
+	// Polls like the benchmark's consumer, so the frame rate doesn't add to the latency.
+	// Shared memory records are stamped by the writer, so that's write to pop. UDP only
+	// has the kernel's arrival stamp, which leaves the sending side out.
+	osc::Message message;
+	vector<double> latencies;
+	latencies.reserve( 200000 );
+	double nextReport = osc::getNetworkTime() + 1.0;
+	while( mIsRunning ){
+		if( listener.getNextMessage( &message ) ){
+			latencies.push_back( message.getReceiveAge() * 1000000.0 );
+			continue;
+		}
+		if( osc::getNetworkTime() > nextReport ){
+			report( &latencies, listener.getNumDroppedPackets() + listener.getNumDroppedMessages() );
+			nextReport += 1.0;
+		}
+		std::this_thread::yield();
+	}
+	listener.shutdown();
+}
+
+void OscHeadSenderApp::report( vector<double> *latencies, uint32_t dropped )
+{
+	string status = "waiting for messages";
+	if( ! latencies->empty() ){
+		std::sort( latencies->begin(), latencies->end() );
+		size_t count = latencies->size();
+		status = toString( count ) + " in the last second, p50 " + toString( (int)(*latencies)[count / 2] )
+			+ "us p99 " + toString( (int)(*latencies)[std::min( count - 1, count * 99 / 100 )] )
+			+ "us max " + toString( (int)latencies->back() ) + "us, " + toString( dropped ) + " dropped";
+		console() << "OscHeadSender: " << status << std::endl;
+	}
+	latencies->clear();
+
+	std::lock_guard<std::mutex> lock( mMutex );
+	mStatus = status;
+}
+
+void OscHeadSenderApp::draw()
+{
+	gl::clear( Color::black() );
+
+	std::lock_guard<std::mutex> lock( mMutex );
+	gl::drawString( mIsListening ? "listening" : "sending /head at " + toString( mRate ) + "/s", Vec2f( 10, 10 ) );
+	gl::drawString( mStatus, Vec2f( 10, 30 ) );
+}
+
+void OscHeadSenderApp::shutdown()
+{
+	mIsRunning = false;
+	if( mThread )
+		mThread->join();
+}
+
+CINDER_APP_BASIC( OscHeadSenderApp, RendererGl )
@@ -27,6 +27,9 @@
 
 #pragma once
 
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
 #include <string>
 
 namespace cinder { namespace osc { 
@@ -43,70 +46,106 @@ typedef enum _ArgType
 	TYPE_INDEXOUTOFBOUNDS
 } ArgType;
 
+	/// A single argument stored by value: a type tag and the value. Strings that fit in
+	/// SHORT_STRING_CAPACITY characters are kept inline, so the usual int, float and short
+	/// string arguments never touch the heap.
 	class Arg
 	{
 	public:
-		virtual ~Arg() {};
+		static const size_t SHORT_STRING_CAPACITY = 23;
 		
-		virtual ArgType getType() const { return TYPE_NONE; }
-		virtual std::string getTypeName() const { return "none"; }
+		Arg() : type( TYPE_NONE ), intValue( 0 ), length( 0 ) { shortString[0] = 0; }
+		
+		/// return the type of this argument
+		ArgType getType() const { return type; }
+		std::string getTypeName() const;
+		
+		int32_t getInt32() const { return intValue; }
+		float getFloat() const { return floatValue; }
+		/// return a string argument's characters, valid until the argument changes
+		const char* getCString() const { return length <= SHORT_STRING_CAPACITY ? shortString : longString.c_str(); }
+		size_t getLength() const { return length; }
+		
+		void setInt32( int32_t _value ) { type = TYPE_INT32; intValue = _value; }
+		void setFloat( float _value ) { type = TYPE_FLOAT; floatValue = _value; }
+		void setString( const char *_value, size_t _length );
+		
+		void swap( Arg &other );
 		
 	private:
+		ArgType type;
+		union {
+			int32_t intValue;
+			float floatValue;
+		};
+		size_t length;
+		char shortString[SHORT_STRING_CAPACITY + 1];
+		std::string longString;		// Only used past SHORT_STRING_CAPACITY
 	};
 	
+	/// The typed argument classes messages used to hold. Kept so code that builds them still
+	/// compiles; they add nothing to Arg, so they can be passed and stored as one.
 	class ArgInt32 : public Arg
 	{
 	public:
-		ArgInt32( int32_t _value ) { value = _value; }
-		
-		/// return the type of this argument
-		ArgType getType() const { return TYPE_INT32; }
-		std::string getTypeName() const { return "int32"; }
-		
-		/// return value
-		int32_t get() const { return value; }
-		/// set value
-		void set( int32_t _value ) { value = _value; }
+		ArgInt32( int32_t _value ) { setInt32( _value ); }
 		
-	private:
-		int32_t value;
+		int32_t get() const { return getInt32(); }
+		void set( int32_t _value ) { setInt32( _value ); }
 	};
 	
 	class ArgFloat : public Arg
 	{
 	public:
-		ArgFloat( float _value ) { value = _value; }
-		
-		/// return the type of this argument
-		ArgType getType() const { return TYPE_FLOAT; }
-		std::string getTypeName() const { return "float"; }
-		
-		/// return value
-		float get() const { return value; }
-		/// set value
-		void set( float _value ) { value = _value; }
+		ArgFloat( float _value ) { setFloat( _value ); }
 		
-	private:
-		float value;
+		float get() const { return getFloat(); }
+		void set( float _value ) { setFloat( _value ); }
 	};
 	
 	class ArgString : public Arg
 	{
 	public:
-		ArgString( std::string _value ) { value = _value; }
-		
-		/// return the type of this argument
-		ArgType getType() const { return TYPE_STRING; }
-		std::string getTypeName() const { return "string"; }
+		ArgString( const std::string &_value ) { set( _value ); }
 		
-		/// return value
-		std::string get() const { return value; }
-		/// set value
-		void set( const char* _value ) { value = _value; }
-		
-	private:
-		std::string value;
+		std::string get() const { return std::string( getCString(), getLength() ); }
+		void set( const std::string &_value ) { setString( _value.c_str(), _value.size() ); }
+		void set( const char *_value ) { setString( _value, strlen( _value ) ); }
 	};
+	
+	inline std::string Arg::getTypeName() const
+	{
+		switch( type ){
+			case TYPE_INT32:	return "int32";
+			case TYPE_FLOAT:	return "float";
+			case TYPE_STRING:	return "string";
+			default:			return "none";
+		}
+	}
+	
+	inline void Arg::setString( const char *_value, size_t _length )
+	{
+		type = TYPE_STRING;
+		length = _length;
+		if( length <= SHORT_STRING_CAPACITY ){
+			memcpy( shortString, _value, length );
+			shortString[length] = 0;
+		} else {
+			longString.assign( _value, length );
+		}
+	}
+	
+	inline void Arg::swap( Arg &other )
+	{
+		std::swap( type, other.type );
+		std::swap( intValue, other.intValue );
+		std::swap( length, other.length );
+		char tmp[SHORT_STRING_CAPACITY + 1];
+		memcpy( tmp, shortString, sizeof( tmp ) );
+		memcpy( shortString, other.shortString, sizeof( tmp ) );
+		memcpy( other.shortString, tmp, sizeof( tmp ) );
+		longString.swap( other.longString );
+	}
 
 } // namespace osc
-} // namespace cinder
\ No newline at end of file
+} // namespace cinder
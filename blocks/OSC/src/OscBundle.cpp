@@ -29,7 +29,7 @@
 
 namespace cinder { namespace osc {
 
-Bundle::Bundle(){
+Bundle::Bundle() : num_messages(0), num_bundles(0) {
 
 }
 
@@ -38,12 +38,16 @@ Bundle::~Bundle(){
 }
 
 Bundle& Bundle::copy(const Bundle& other){
-	for (size_t i = 0; i < other.bundles.size(); i++) {
-		bundles.push_back(other.bundles[i]);
+	if (&other == this)
+		return *this;
+	
+	clear();
+	for (int i = 0; i < other.num_bundles; i++) {
+		addBundle(other.bundles[i]);
 	}
 	
-	for (size_t i = 0; i < other.messages.size(); i++) {
-		messages.push_back(other.messages[i]);
+	for (int i = 0; i < other.num_messages; i++) {
+		addMessage(other.messages[i]);
 	}
 	
 	return *this;
@@ -51,12 +55,19 @@ Bundle& Bundle::copy(const Bundle& other){
 }
 
 void Bundle::addBundle(const Bundle& bundle){
-	bundles.push_back(bundle);
+	if (num_bundles < (int)bundles.size())
+		bundles[num_bundles] = bundle;
+	else
+		bundles.push_back(bundle);
+	num_bundles++;
 }
 
 void Bundle::addMessage(const Message& message){
-
-	messages.push_back(message);
+	if (num_messages < (int)messages.size())
+		messages[num_messages] = message;
+	else
+		messages.push_back(message);
+	num_messages++;
 }
 
 } // namespace osc
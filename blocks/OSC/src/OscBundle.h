@@ -31,29 +31,33 @@
 
 namespace cinder { namespace osc {
 
+/// Cleared elements are kept and assigned over, so a bundle rebuilt every frame with the
+/// same shape stops allocating after the first.
 class Bundle {
   public:
 	Bundle();
 	~Bundle();
-	Bundle(const Bundle& other){copy(other);}
+	Bundle(const Bundle& other) : num_messages(0), num_bundles(0) {copy(other);}
 
 	Bundle& operator= (const Bundle& other){return copy(other);}
 	Bundle& copy(const Bundle& other);
 
-	void clear(){messages.clear();bundles.clear();}
+	void clear(){num_messages = 0; num_bundles = 0;}
 	
 	void addBundle(const Bundle& element);
 	void addMessage(const Message& message);
 	
-	int getBundleCount() const {return bundles.size();}
-	int getMessageCount() const {return messages.size();}
+	int getBundleCount() const {return num_bundles;}
+	int getMessageCount() const {return num_messages;}
 	
 	const Bundle& getBundleAt(int index) const { return bundles[index]; }
 	const Message& getMessageAt(int index) const {return messages[index];}
 	
   private:
-	std::vector<Message> messages;
-	std::vector<Bundle> bundles;
+	std::vector<Message> messages;		// Only the first num_messages are in the bundle
+	std::vector<Bundle> bundles;		// Same with num_bundles
+	int num_messages;
+	int num_bundles;
 };	
 
 } }// namespace cinder::osc
\ No newline at end of file
@@ -0,0 +1,269 @@
+/*
+ Copyright (c) 2010, Hector Sanchez-Pajares
+ Aer Studio http://www.aerstudio.com
+ All rights reserved.
+ 
+ 
+ This is a block for OSC Integration for the Cinder framework (http://libcinder.org)
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "OscDispatcher.h"
+#include <string.h>
+
+namespace cinder { namespace osc {
+
+// FNV-1a, the same hash for registration and lookup
+static uint32_t hashPart( const char *name, size_t length )
+{
+	uint32_t hash = 2166136261u;
+	for( size_t i = 0; i < length; i++ )
+		hash = ( hash ^ (uint8_t)name[i] ) * 16777619u;
+	return hash;
+}
+
+static bool isPattern( const char *part, size_t length )
+{
+	for( size_t i = 0; i < length; i++ ){
+		switch( part[i] ){
+			case '?': case '*': case '[': case ']': case '{': case '}':
+				return true;
+		}
+	}
+	return false;
+}
+
+// Matches one address part against a pattern part, per the OSC 1.0 spec
+static bool matchPattern( const char *pattern, const char *patternEnd, const char *name, const char *nameEnd )
+{
+	while( pattern < patternEnd ){
+		switch( *pattern ){
+			case '?':
+				if( name == nameEnd )
+					return false;
+				pattern++;
+				name++;
+				break;
+				
+			case '*':
+				// Collapse runs, then try every split of the rest of the name
+				while( pattern < patternEnd && *pattern == '*' )
+					pattern++;
+				if( pattern == patternEnd )
+					return true;
+				for( const char *n = name; n <= nameEnd; n++ ){
+					if( matchPattern( pattern, patternEnd, n, nameEnd ) )
+						return true;
+				}
+				return false;
+				
+			case '[': {
+				if( name == nameEnd )
+					return false;
+				const char *p = pattern + 1;
+				bool negate = p < patternEnd && *p == '!';
+				if( negate )
+					p++;
+				bool found = false;
+				while( p < patternEnd && *p != ']' ){
+					if( p + 2 < patternEnd && p[1] == '-' && p[2] != ']' ){
+						if( *name >= p[0] && *name <= p[2] )
+							found = true;
+						p += 3;
+					} else {
+						if( *name == *p )
+							found = true;
+						p++;
+					}
+				}
+				if( p == patternEnd || found == negate )
+					return false;
+				pattern = p + 1;
+				name++;
+				break;
+			}
+				
+			case '{': {
+				const char *close = (const char*)memchr( pattern, '}', patternEnd - pattern );
+				if( ! close )
+					return false;
+				// Try each alternative followed by whatever comes after the braces
+				const char *option = pattern + 1;
+				while( option <= close ){
+					const char *optionEnd = option;
+					while( optionEnd < close && *optionEnd != ',' )
+						optionEnd++;
+					size_t length = optionEnd - option;
+					if( (size_t)( nameEnd - name ) >= length && memcmp( option, name, length ) == 0 &&
+					    matchPattern( close + 1, patternEnd, name + length, nameEnd ) )
+						return true;
+					option = optionEnd + 1;
+				}
+				return false;
+			}
+				
+			default:
+				if( name == nameEnd || *name != *pattern )
+					return false;
+				pattern++;
+				name++;
+				break;
+		}
+	}
+	return name == nameEnd;
+}
+
+Dispatcher::Dispatcher()
+	: mNumAddresses( 0 ), mNumRejected( 0 )
+{
+	mNodes.push_back( Node() );
+}
+
+void Dispatcher::add( const std::string &address, const std::string &typeTags, const MessageHandler &handler )
+{
+	// Registered addresses are literal, patterns only come in with messages
+	if( address.empty() || address[0] != '/' || isPattern( address.c_str(), address.size() ) )
+		throw OscExcInvalidAddress();
+	for( size_t i = 0; i < typeTags.size(); i++ ){
+		if( typeTags[i] != 'i' && typeTags[i] != 'f' && typeTags[i] != 's' )
+			throw OscExcInvalidArgumentType();
+	}
+	
+	int node = 0;
+	const char *part = address.c_str() + 1;
+	const char *end = address.c_str() + address.size();
+	while( part <= end ){
+		const char *partEnd = (const char*)memchr( part, '/', end - part );
+		if( ! partEnd )
+			partEnd = end;
+		int child = findChild( mNodes[node], part, partEnd - part );
+		node = child >= 0 ? child : addChild( node, part, partEnd - part );
+		part = partEnd + 1;
+	}
+	
+	if( mNodes[node].mHandlers.empty() )
+		mNumAddresses++;
+	Handler h;
+	h.mTypeTags	= typeTags;
+	h.mCallback	= handler;
+	mNodes[node].mHandlers.push_back( h );
+}
+
+int Dispatcher::findChild( const Node &node, const char *name, size_t length ) const
+{
+	if( node.mTable.empty() )
+		return -1;
+	uint32_t mask = (uint32_t)node.mTable.size() - 1;
+	for( uint32_t slot = hashPart( name, length ) & mask; node.mTable[slot] >= 0; slot = ( slot + 1 ) & mask ){
+		const std::string &childName = mNodes[node.mTable[slot]].mName;
+		if( childName.size() == length && memcmp( childName.data(), name, length ) == 0 )
+			return node.mTable[slot];
+	}
+	return -1;
+}
+
+int Dispatcher::addChild( int parent, const char *name, size_t length )
+{
+	int child = (int)mNodes.size();
+	mNodes.push_back( Node() );
+	mNodes[child].mName.assign( name, length );
+	mNodes[parent].mChildren.push_back( child );
+	rebuildTable( mNodes[parent] );
+	return child;
+}
+
+void Dispatcher::rebuildTable( Node &node )
+{
+	// At most half full so probes stay short
+	size_t size = 4;
+	while( size < node.mChildren.size() * 2 )
+		size <<= 1;
+	node.mTable.assign( size, -1 );
+	uint32_t mask = (uint32_t)size - 1;
+	for( size_t i = 0; i < node.mChildren.size(); i++ ){
+		const std::string &name = mNodes[node.mChildren[i]].mName;
+		uint32_t slot = hashPart( name.data(), name.size() ) & mask;
+		while( node.mTable[slot] >= 0 )
+			slot = ( slot + 1 ) & mask;
+		node.mTable[slot] = node.mChildren[i];
+	}
+}
+
+bool Dispatcher::accepts( const Handler &handler, const Message &message ) const
+{
+	const std::string &tags = handler.mTypeTags;
+	if( (int)tags.size() != message.getNumArgs() )
+		return false;
+	for( size_t i = 0; i < tags.size(); i++ ){
+		ArgType type = message.getArgType( (int)i );
+		if( ( tags[i] == 'i' && type != TYPE_INT32 ) || ( tags[i] == 'f' && type != TYPE_FLOAT ) || ( tags[i] == 's' && type != TYPE_STRING ) )
+			return false;
+	}
+	return true;
+}
+
+bool Dispatcher::dispatch( const Message &message )
+{
+	const std::string &address = message.getAddress();
+	if( address.empty() || address[0] != '/' )
+		return false;
+	return dispatch( 0, address.c_str(), message ) > 0;
+}
+
+int Dispatcher::dispatch( int node, const char *address, const Message &message )
+{
+	// END OF THE ADDRESS
+	if( ! *address ){
+		int numCalled = 0;
+		const std::vector<Handler> &handlers = mNodes[node].mHandlers;
+		for( size_t i = 0; i < handlers.size(); i++ ){
+			if( accepts( handlers[i], message ) ){
+				handlers[i].mCallback( message );
+				numCalled++;
+			}
+			else
+				mNumRejected++;
+		}
+		return numCalled;
+	}
+	
+	// address points at the slash before the next part
+	const char *part = address + 1;
+	const char *partEnd = part;
+	while( *partEnd && *partEnd != '/' )
+		partEnd++;
+	
+	// LITERAL PART, one hash lookup
+	if( ! isPattern( part, partEnd - part ) ){
+		int child = findChild( mNodes[node], part, partEnd - part );
+		return child >= 0 ? dispatch( child, partEnd, message ) : 0;
+	}
+	
+	// PATTERN, tried against every child
+	int numCalled = 0;
+	for( size_t i = 0; i < mNodes[node].mChildren.size(); i++ ){
+		int child = mNodes[node].mChildren[i];
+		const std::string &name = mNodes[child].mName;
+		if( matchPattern( part, partEnd, name.data(), name.data() + name.size() ) )
+			numCalled += dispatch( child, partEnd, message );
+	}
+	return numCalled;
+}
+
+} } // namespace cinder::osc
@@ -0,0 +1,149 @@
+/*
+ Copyright (c) 2010, Hector Sanchez-Pajares
+ Aer Studio http://www.aerstudio.com
+ All rights reserved.
+ 
+ 
+ This is a block for OSC Integration for the Cinder framework (http://libcinder.org)
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "cinder/Cinder.h"
+#include "cinder/Function.h"
+
+#include "OscMessage.h"
+#include "OscArg.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace cinder { namespace osc {
+
+	class OscExcInvalidAddress : public OscExc {
+	};
+	
+	//! How a handler's argument type maps to an OSC type tag and is read out of a Message
+	template<typename T> struct ArgTraits;
+	template<> struct ArgTraits<int32_t> {
+		static char getTag() { return 'i'; }
+		static int32_t get( const Message &message, int index ) { return message.getArgAsInt32( index ); }
+	};
+	template<> struct ArgTraits<float> {
+		static char getTag() { return 'f'; }
+		static float get( const Message &message, int index ) { return message.getArgAsFloat( index ); }
+	};
+	template<> struct ArgTraits<std::string> {
+		static char getTag() { return 's'; }
+		static std::string get( const Message &message, int index ) { return message.getArgAsString( index ); }
+	};
+	template<> struct ArgTraits<const char*> {
+		static char getTag() { return 's'; }
+		static const char* get( const Message &message, int index ) { return message.getArgAsCString( index ); }
+	};
+	
+	/// Routes messages to handlers by address. Registered addresses are compiled into a trie with a
+	/// hash table at every level, so a literal address costs one lookup per part however many are
+	/// registered. Incoming addresses may be OSC 1.0 patterns: ?, *, [a-z], [!abc] and {foo,bar}.
+	/// Each handler declares the type tags it expects; messages with other arguments are counted
+	/// and skipped, so handlers read their arguments without checking them.
+	class Dispatcher {
+	  public:
+		typedef std::function<void (const Message&)> MessageHandler;
+		
+		Dispatcher();
+		
+		//! Calls \a handler for messages to \a address whose arguments match \a typeTags exactly, e.g. "ffi" or "" for none.
+		void add( const std::string &address, const std::string &typeTags, const MessageHandler &handler );
+		
+		void add( const std::string &address, const std::function<void ()> &handler );
+		template<typename A>
+		void add( const std::string &address, const std::function<void (A)> &handler );
+		template<typename A, typename B>
+		void add( const std::string &address, const std::function<void (A, B)> &handler );
+		template<typename A, typename B, typename C>
+		void add( const std::string &address, const std::function<void (A, B, C)> &handler );
+		template<typename T, typename A>
+		void add( const std::string &address, T *obj, void (T::*cb)(A) ) { add<A>( address, std::bind( cb, obj, std::placeholders::_1 ) ); }
+		
+		//! Calls every handler whose address matches \a message's. Returns whether any did.
+		bool dispatch( const Message &message );
+		
+		size_t		getNumAddresses() const { return mNumAddresses; }
+		//! Returns how many messages matched an address but not its handler's type tags.
+		uint32_t	getNumRejectedMessages() const { return mNumRejected; }
+		
+	  private:
+		struct Handler {
+			std::string		mTypeTags;
+			MessageHandler	mCallback;
+		};
+		
+		struct Node {
+			std::string				mName;			// Address part, without slashes
+			std::vector<int>		mChildren;		// Indices into mNodes
+			std::vector<int>		mTable;			// Open addressing over mChildren by name hash, -1 when empty
+			std::vector<Handler>	mHandlers;
+		};
+		
+		int		findChild( const Node &node, const char *name, size_t length ) const;
+		int		addChild( int parent, const char *name, size_t length );
+		void	rebuildTable( Node &node );
+		int		dispatch( int node, const char *address, const Message &message );
+		bool	accepts( const Handler &handler, const Message &message ) const;
+		
+		std::vector<Node>		mNodes;			// mNodes[0] is the root
+		size_t					mNumAddresses;
+		std::atomic<uint32_t>	mNumRejected;		// Read from other threads
+	};
+	
+	inline void Dispatcher::add( const std::string &address, const std::function<void ()> &handler )
+	{
+		add( address, "", [=]( const Message& ) { handler(); } );
+	}
+	
+	template<typename A>
+	void Dispatcher::add( const std::string &address, const std::function<void (A)> &handler )
+	{
+		std::string tags( 1, ArgTraits<A>::getTag() );
+		add( address, tags, [=]( const Message &m ) { handler( ArgTraits<A>::get( m, 0 ) ); } );
+	}
+	
+	template<typename A, typename B>
+	void Dispatcher::add( const std::string &address, const std::function<void (A, B)> &handler )
+	{
+		std::string tags;
+		tags += ArgTraits<A>::getTag();
+		tags += ArgTraits<B>::getTag();
+		add( address, tags, [=]( const Message &m ) { handler( ArgTraits<A>::get( m, 0 ), ArgTraits<B>::get( m, 1 ) ); } );
+	}
+	
+	template<typename A, typename B, typename C>
+	void Dispatcher::add( const std::string &address, const std::function<void (A, B, C)> &handler )
+	{
+		std::string tags;
+		tags += ArgTraits<A>::getTag();
+		tags += ArgTraits<B>::getTag();
+		tags += ArgTraits<C>::getTag();
+		add( address, tags, [=]( const Message &m ) { handler( ArgTraits<A>::get( m, 0 ), ArgTraits<B>::get( m, 1 ), ArgTraits<C>::get( m, 2 ) ); } );
+	}
+
+} } // namespace cinder::osc
@@ -31,24 +31,355 @@
 #include "osc/OscPacketListener.h"
 #include "osc/OscReceivedElements.h"
 #include "ip/UdpSocket.h"
+#include "ip/SharedMemoryRing.h"
+#include "ip/TimerListener.h"
 
 #include <iostream>
 #include <assert.h>
-#include <deque>
+#include <math.h>
+#include <atomic>
+#include <vector>
 #include <map>
+#include <functional>
+#include <algorithm>
 using namespace std;
 
 namespace cinder { namespace osc {
+
+// Fixed capacity single producer, single consumer queue between the socket thread and
+// the app. Slots are allocated once and refilled in place, so neither side locks or waits.
+// Arguments past a message's inline ones and long strings keep their storage in the slot,
+// so nothing is allocated once every slot has held a message of the largest shape.
+class MessageRing {
+  public:
+	MessageRing() : mMask( 0 ), mHead( 0 ), mTail( 0 ), mDropped( 0 ) {}
+	
+	void		allocate( size_t capacity );
+	
+	// Producer. Returns the slot to fill, or NULL and counts a drop if the ring is full.
+	Message*	beginPush();
+	void		endPush();
+	
+	// Consumer. Swaps the oldest message into *message, handing the caller's storage to the slot.
+	bool		pop( Message *message );
+	bool		isEmpty() const { return mHead.load( memory_order_acquire ) == mTail.load( memory_order_relaxed ); }
+	uint32_t	getNumDropped() const { return mDropped.load( memory_order_relaxed ); }
+	
+  private:
+	vector<Message>		mSlots;
+	uint32_t			mMask;
+	atomic<uint32_t>	mHead;		// Next slot to fill, only advanced by the producer
+	atomic<uint32_t>	mTail;		// Next slot to read, only advanced by the consumer
+	atomic<uint32_t>	mDropped;
+};
+
+void MessageRing::allocate( size_t capacity )
+{
+	size_t size = 1;
+	while( size < capacity )
+		size <<= 1;
+	mSlots.clear();
+	mSlots.resize( size );
+	mMask = (uint32_t)size - 1;
+	mHead = 0;
+	mTail = 0;
+	mDropped = 0;
+}
+
+Message* MessageRing::beginPush()
+{
+	uint32_t head = mHead.load( memory_order_relaxed );
+	if( head - mTail.load( memory_order_acquire ) > mMask ){
+		mDropped.fetch_add( 1, memory_order_relaxed );
+		return NULL;
+	}
+	Message *slot = &mSlots[head & mMask];
+	slot->clear();
+	return slot;
+}
+
+void MessageRing::endPush()
+{
+	mHead.store( mHead.load( memory_order_relaxed ) + 1, memory_order_release );
+}
+
+bool MessageRing::pop( Message *message )
+{
+	uint32_t tail = mTail.load( memory_order_relaxed );
+	if( tail == mHead.load( memory_order_acquire ) )
+		return false;
+	message->swap( mSlots[tail & mMask] );
+	mTail.store( tail + 1, memory_order_release );
+	return true;
+}
+
+// Messages waiting for their time, ordered by a min-heap. Slots are reused, so
+// once the pool has grown to the busiest moment nothing is copied or allocated.
+class MessageSchedule {
+  public:
+	// Takes *message's contents, leaving it with a spare slot's storage
+	void		add( double time, Message *message );
+	// Swaps the earliest message due by now into *message
+	bool		pop( double now, Message *message );
+	bool		isDue( double now ) const { return ! mHeap.empty() && mHeap.front().first <= now; }
+	size_t		size() const { return mHeap.size(); }
+	
+  private:
+	typedef pair<double, int> Entry;	// Time, slot
+	
+	vector<Message>		mSlots;
+	vector<int>			mFreeSlots;
+	vector<Entry>		mHeap;
+};
+
+void MessageSchedule::add( double time, Message *message )
+{
+	if( mFreeSlots.empty() ){
+		mFreeSlots.push_back( (int)mSlots.size() );
+		mSlots.push_back( Message() );
+	}
+	int slot = mFreeSlots.back();
+	mFreeSlots.pop_back();
+	mSlots[slot].swap( *message );
+	mHeap.push_back( Entry( time, slot ) );
+	push_heap( mHeap.begin(), mHeap.end(), greater<Entry>() );
+}
+
+bool MessageSchedule::pop( double now, Message *message )
+{
+	if( ! isDue( now ) )
+		return false;
+	pop_heap( mHeap.begin(), mHeap.end(), greater<Entry>() );
+	int slot = mHeap.back().second;
+	mHeap.pop_back();
+	message->swap( mSlots[slot] );
+	mFreeSlots.push_back( slot );
+	return true;
+}
+
+// Smallest value added over roughly the last window seconds. Kept as the minimum of each of a
+// few slices of the window, so old values age out a slice at a time and a new floor is followed
+// within one window instead of creeping towards it.
+class WindowedMinimum {
+  public:
+	WindowedMinimum( double window ) : mSlice( window / NUM_SLICES ), mNewest( 0 ), mCount( 0 ) {}
+	
+	void		add( double time, double value );
+	// The minimum over the slices that started within the window before now. The newest one always counts.
+	double		get( double now ) const;
+	bool		isEmpty() const { return mCount == 0; }
+	// False once nothing has been added for a whole window
+	bool		isCurrent( double now ) const { return mCount > 0 && mStarts[mNewest] >= now - mSlice * NUM_SLICES; }
+	void		clear() { mCount = 0; }
+	
+  private:
+	static const int NUM_SLICES = 8;
+	
+	double		mSlice;
+	double		mStarts[NUM_SLICES];
+	double		mMinimums[NUM_SLICES];
+	int			mNewest;
+	int			mCount;
+};
+
+void WindowedMinimum::add( double time, double value )
+{
+	if( mCount == 0 || time >= mStarts[mNewest] + mSlice ){
+		mNewest = ( mNewest + 1 ) % NUM_SLICES;
+		mStarts[mNewest] = time;
+		mMinimums[mNewest] = value;
+		mCount = min( mCount + 1, (int)NUM_SLICES );
+	}
+	else if( value < mMinimums[mNewest] )
+		mMinimums[mNewest] = value;
+}
+
+double WindowedMinimum::get( double now ) const
+{
+	double result = mMinimums[mNewest];
+	double oldest = now - mSlice * NUM_SLICES;
+	for( int i = 1; i < mCount; i++ ){
+		int slice = ( mNewest + NUM_SLICES - i ) % NUM_SLICES;
+		if( mStarts[slice] < oldest )
+			break;
+		result = min( result, mMinimums[slice] );
+	}
+	return result;
+}
+
+// Latest value for one address, as a triple buffer. The producer fills its back buffer and
+// publishes it by swapping it with the middle one; the consumer swaps the middle one out as
+// its front buffer when it's marked fresh. Neither side ever sees a buffer being written.
+//
+// With a jitter delay every message goes through a ring instead and is held on the app thread
+// until its send time plus the smallest transit time seen lately plus the delay, so updates come
+// out as evenly spaced as they were sent. Send times are the bundle time tags when there are
+// any, otherwise they're estimated by fitting the arrivals to a steady rate. A pause in the
+// stream starts the estimate over, and delivery times never go backwards.
+class Mailbox {
+  public:
+	Mailbox( const string &address, double jitterDelay );
+	
+	const string&	getAddress() const { return mAddress; }
+	
+	// Sees every message on the producer's thread, before it's published
+	void			setHandler( const Dispatcher::MessageHandler &handler ) { mHandler = handler; }
+	const Dispatcher::MessageHandler&	getHandler() const { return mHandler; }
+	
+	// Producer. beginPublish() returns NULL when a jitter buffer is full.
+	Message*		beginPublish();
+	void			publish();
+	
+	// Consumer
+	bool			read( Message *message );
+	uint32_t		getNumOverwritten() const { return mOverwritten.load( memory_order_relaxed ) + mRing.getNumDropped(); }
+	
+  private:
+	static const uint32_t FRESH = 4;
+	static const size_t JITTER_CAPACITY = 64;
+	static const double TRANSIT_WINDOW;		// Seconds the transit floor is taken over
+	static const double MIN_GAP;			// Shortest pause that counts as the stream stopping
+	
+	double			estimateSendTime( const Message &message );
+	
+	string				mAddress;
+	Dispatcher::MessageHandler	mHandler;
+	Message				mBuffers[3];
+	atomic<uint32_t>	mState;			// Index of the middle buffer, plus FRESH once it holds an unread message
+	int					mBack;			// Producer's buffer
+	int					mFront;			// Consumer's buffer
+	atomic<uint32_t>	mOverwritten;
+	
+	// Jitter buffer, consumer side apart from the ring
+	double				mJitterDelay;
+	MessageRing			mRing;
+	MessageSchedule		mPending;
+	Message				mIncoming;
+	WindowedMinimum		mTransit;
+	double				mPeriod;		// Estimated time between sends, 0 until two arrivals in a row
+	double				mLastArrival, mLastSend, mLastPlay;
+	bool				mHasHistory;
+};
+
+const double Mailbox::TRANSIT_WINDOW	= 5.0;
+const double Mailbox::MIN_GAP			= 0.1;
+
+Mailbox::Mailbox( const string &address, double jitterDelay )
+	: mAddress( address ), mState( 1 ), mBack( 0 ), mFront( 2 ), mOverwritten( 0 ),
+	mJitterDelay( jitterDelay ), mTransit( TRANSIT_WINDOW ), mPeriod( 0 ), mLastArrival( 0 ), mLastSend( 0 ), mLastPlay( 0 ), mHasHistory( false )
+{
+	if( mJitterDelay > 0 )
+		mRing.allocate( JITTER_CAPACITY );
+}
+
+Message* Mailbox::beginPublish()
+{
+	if( mJitterDelay > 0 )
+		return mRing.beginPush();
+	return &mBuffers[mBack];
+}
+
+void Mailbox::publish()
+{
+	if( mJitterDelay > 0 ){
+		mRing.endPush();
+		return;
+	}
+	uint32_t prev = mState.exchange( mBack | FRESH, memory_order_acq_rel );
+	mBack = prev & 3;
+	if( prev & FRESH )
+		mOverwritten.fetch_add( 1, memory_order_relaxed );
+}
+
+double Mailbox::estimateSendTime( const Message &message )
+{
+	double arrival = message.getReceiveTime();
 	
-class OscListener : public ::osc::OscPacketListener {	
+	// After a pause the sender may have restarted or the route changed, so nothing learned
+	// before it is kept. The pause itself never goes into the period.
+	if( mHasHistory && arrival - mLastArrival > max( mPeriod * 4, MIN_GAP ) ){
+		mHasHistory	= false;
+		mPeriod		= 0;
+		mTransit.clear();
+	}
+	
+	// Follow the arrival rate slowly, and pull the schedule towards the arrivals just as
+	// slowly so clock drift is tracked but jitter isn't. A burst far off the schedule
+	// restarts it from the arrival.
+	double send = arrival;
+	if( message.getTimeTag() != 0 )
+		send = message.getTimeTag();
+	else if( mHasHistory ){
+		double interval = arrival - mLastArrival;
+		mPeriod = ( mPeriod > 0 ) ? mPeriod + ( interval - mPeriod ) * 0.05 : interval;
+		double expected = mLastSend + mPeriod;
+		if( fabs( arrival - expected ) < max( mPeriod * 4, MIN_GAP ) )
+			send = expected + ( arrival - expected ) * 0.1;
+	}
+	mLastArrival	= arrival;
+	mLastSend		= send;
+	mHasHistory		= true;
+	return send;
+}
+
+bool Mailbox::read( Message *message )
+{
+	if( mJitterDelay <= 0 ){
+		if( ! ( mState.load( memory_order_acquire ) & FRESH ) )
+			return false;
+		uint32_t prev = mState.exchange( mFront, memory_order_acq_rel );
+		mFront = prev & 3;
+		message->swap( mBuffers[mFront] );
+		return true;
+	}
+	
+	// BUFFER WHAT ARRIVED
+	while( mRing.pop( &mIncoming ) ){
+		double send = estimateSendTime( mIncoming );
+		double arrival = mIncoming.getReceiveTime();
+		// The fastest recent transit is the network's floor. With time tags it also takes
+		// up the difference between the sender's clock and ours.
+		mTransit.add( arrival, arrival - send );
+		
+		// A lower floor would pull the schedule back past what's already been handed out
+		double playTime = max( send + mTransit.get( arrival ) + mJitterDelay, mLastPlay );
+		mLastPlay = playTime;
+		mIncoming.setDeliveryTime( playTime );
+		mPending.add( playTime, &mIncoming );
+	}
+	
+	// RELEASE THE NEWEST ONE DUE
+	double now = getNetworkTime();
+	bool found = false;
+	while( mPending.pop( now, message ) ){
+		if( found )
+			mOverwritten.fetch_add( 1, memory_order_relaxed );
+		found = true;
+	}
+	return found;
+}
+	
+class OscListener : public ::osc::OscPacketListener, public TimerListener {	
   public:
 	OscListener();
 	~OscListener();
 	
-	void setup(int listen_port);
+	void setup( int listen_port, size_t queueCapacity, int receiveBufferSize );
+	void setupSharedMemory( const string &name, size_t queueCapacity );
 	
 	bool hasWaitingMessages() const;
 	bool getNextMessage( Message * );
+	uint32_t getNumDroppedMessages() const { return mMessages.getNumDropped() + mScheduled.getNumDropped() + mNumCallbacksUnscheduled; }
+	size_t getNumScheduledMessages() const { return mSchedule.size(); }
+	uint32_t getNumDroppedPackets() const;
+	
+	int registerMailbox( const string &address, double jitterDelay );
+	void setMailboxHandler( int id, const Dispatcher::MessageHandler &handler );
+	bool getLatestMessage( int id, Message *message ) { return mMailboxes[id]->read( message ); }
+	uint32_t getNumOverwrittenMessages( int id ) const { return mMailboxes[id]->getNumOverwritten(); }
+	
+	void setDispatcher( const std::shared_ptr<Dispatcher> &dispatcher );
+	void setMaxClockSkew( double seconds );
 
 	CallbackId	registerMessageReceived( std::function<void (const osc::Message*)> callback );
 	void		unregisterMessageReceived( CallbackId id );
@@ -56,40 +387,109 @@ class OscListener : public ::osc::OscPacketListener {
 	void shutdown();
 	
   protected:
+	virtual void ProcessBundle( const ::osc::ReceivedBundle &b, const IpEndpointName& remoteEndpoint );
 	virtual void ProcessMessage( const ::osc::ReceivedMessage &m, const IpEndpointName& remoteEndpoint );
+	virtual void TimerExpired();
 	
   private:
+	static const int SCHEDULE_TICK_MS = 5;	// How late a scheduled message for the callbacks can be
+	
+	void collectScheduled() const;
+	void releaseScheduled();
+	void deliver( Message *message );
+
 	void threadSocket();
+	void threadSharedMemory();
+	void fillMessage( Message *message, const ::osc::ReceivedMessage &m, const IpEndpointName& remoteEndpoint );
+	
+	Mailbox* findMailbox( const char *address );
+	WindowedMinimum* findSenderClock( const IpEndpointName &endpoint );
+	
+	MessageRing mMessages;
+	Message mCallbackMessage;		// Only touched by the socket thread
+	double mBundleTime;				// Time tag of the bundle being processed, 0 if none
+	double mBundleDueTime;			// The same on our clock
 	
-	deque<Message*> mMessages;
+	// How far each sender's time tags are behind our clock, arrival less time tag at its smallest lately. Socket thread only.
+	struct SenderClock {
+		unsigned long	mAddress;
+		int				mPort;
+		WindowedMinimum	mOffset;
+	};
+	vector<SenderClock> mSenderClocks;
+	double mMaxClockSkew;			// Beyond this the sender's clock is corrected for, 0 never
+	
+	// Messages time tagged for later go through their own ring to the app thread, and wait there
+	mutable MessageRing mScheduled;
+	mutable MessageSchedule mSchedule;
+	mutable Message mScheduledMessage;
+	// Unless there are callbacks, then they wait on the socket thread for the timer
+	MessageSchedule mCallbackSchedule;
+	size_t mQueueCapacity;
+	atomic<uint32_t> mNumCallbacksUnscheduled;	// Dropped because mCallbackSchedule was full
+	vector<std::shared_ptr<Mailbox> > mMailboxes;		// Fixed once the socket is running
+	std::shared_ptr<Dispatcher> mDispatcher;			// Same
 	
 	UdpListeningReceiveSocket* mListen_socket;
+	SharedMemoryRing* mSharedRing;		// Instead of the socket, packets are parsed where the writer left them
+	atomic<bool> mSharedRunning;
 	
-	mutable std::mutex mMutex;
+	mutable std::mutex mMutex;		// Guards the callbacks, the queue doesn't need it
 	std::shared_ptr<std::thread> mThread;
 	
 	CallbackMgr<void (const Message*)>	mMessageReceivedCbs;
+	atomic<bool> mHasCallbacks;
 	bool mSocketHasShutdown;
 };
 
 OscListener::OscListener()
 {
 	mListen_socket = NULL;
+	mSharedRing = NULL;
+	mSharedRunning = false;
+	mHasCallbacks = false;
+	mBundleTime = 0;
+	mBundleDueTime = 0;
+	mMaxClockSkew = 1.0;
+	mQueueCapacity = 0;
+	mNumCallbacksUnscheduled = 0;
 }
 
-void OscListener::setup(int listen_port)
+void OscListener::setup( int listen_port, size_t queueCapacity, int receiveBufferSize )
 {
-	if (mListen_socket) {
+	if (mListen_socket || mSharedRing) {
 		shutdown();
 	}
 	
 	mSocketHasShutdown = false;
+	mMessages.allocate( queueCapacity );
+	mScheduled.allocate( queueCapacity );
+	mQueueCapacity = queueCapacity;
 	
 	mListen_socket = new UdpListeningReceiveSocket(IpEndpointName(IpEndpointName::ANY_ADDRESS, listen_port), this);
+	if( receiveBufferSize > 0 )
+		mListen_socket->SetReceiveBufferSize( receiveBufferSize );
+	mListen_socket->AttachPeriodicTimerListener( SCHEDULE_TICK_MS, this );
 
 	mThread = std::shared_ptr<std::thread>( new std::thread( &OscListener::threadSocket, this ) );
 }
 
+void OscListener::setupSharedMemory( const string &name, size_t queueCapacity )
+{
+	if (mListen_socket || mSharedRing) {
+		shutdown();
+	}
+	
+	mMessages.allocate( queueCapacity );
+	mScheduled.allocate( queueCapacity );
+	mQueueCapacity = queueCapacity;
+	
+	// The ring gets as many records as the queue has slots, so a burst the queue takes fits in it too
+	mSharedRing = new SharedMemoryRing( name.c_str(), (int)queueCapacity, true );
+	mSharedRunning = true;
+	mThread = std::shared_ptr<std::thread>( new std::thread( &OscListener::threadSharedMemory, this ) );
+}
+
 void OscListener::shutdown() {
 	if (mListen_socket) {
 		mListen_socket->AsynchronousBreak();
@@ -103,6 +503,14 @@ void OscListener::shutdown() {
 		delete mListen_socket;
 		mListen_socket = NULL;
 	}
+	if (mSharedRing) {
+		mSharedRunning = false;
+		mSharedRing->Notify();
+		mThread->join();
+		
+		delete mSharedRing;
+		mSharedRing = NULL;
+	}
 }
 
 OscListener::~OscListener() {
@@ -116,14 +524,227 @@ void OscListener::threadSocket() {
 	
 }
 
+void OscListener::threadSharedMemory() {
+	// Same host, so there's no address to report
+	IpEndpointName localEndpoint( 127, 0, 0, 1, IpEndpointName::ANY_PORT );
+	
+	while( mSharedRunning ) {
+		int size;
+		double writeTime;
+		const char *data = mSharedRing->BeginRead( &size, &writeTime );
+		if( ! data ) {
+			// Timed out now and then to notice shutdown even if the wake up is missed,
+			// and every tick while messages are waiting for their time
+			releaseScheduled();
+			mSharedRing->Wait( mCallbackSchedule.size() > 0 ? SCHEDULE_TICK_MS : 100 );
+			continue;
+		}
+		
+		// Parsed in place, only the arguments are copied out into the queue's slots
+		try {
+			ProcessPacket( data, size, localEndpoint, writeTime );
+		}
+		catch( ::osc::Exception & ) {
+			// A malformed packet from the other process shouldn't take the thread down
+		}
+		mSharedRing->EndRead();
+		releaseScheduled();
+	}
+}
+
+uint32_t OscListener::getNumDroppedPackets() const
+{
+	if( mListen_socket )
+		return (uint32_t)mListen_socket->DroppedPacketCount();
+	if( mSharedRing )
+		return (uint32_t)mSharedRing->DroppedPacketCount();
+	return 0;
+}
+
+int OscListener::registerMailbox( const string &address, double jitterDelay )
+{
+	assert( ! mListen_socket && ! mSharedRing && "mailboxes have to be registered before setup()" );
+	mMailboxes.push_back( std::shared_ptr<Mailbox>( new Mailbox( address, jitterDelay ) ) );
+	return (int)mMailboxes.size() - 1;
+}
+
+void OscListener::setMailboxHandler( int id, const Dispatcher::MessageHandler &handler )
+{
+	assert( ! mListen_socket && ! mSharedRing && "mailbox handlers have to be set before setup()" );
+	mMailboxes[id]->setHandler( handler );
+}
+
+void OscListener::setDispatcher( const std::shared_ptr<Dispatcher> &dispatcher )
+{
+	assert( ! mListen_socket && ! mSharedRing && "the dispatcher has to be set before setup()" );
+	mDispatcher = dispatcher;
+}
+
+void OscListener::setMaxClockSkew( double seconds )
+{
+	assert( ! mListen_socket && ! mSharedRing && "the clock skew has to be set before setup()" );
+	mMaxClockSkew = seconds;
+}
+
+Mailbox* OscListener::findMailbox( const char *address )
+{
+	// A handful of entries, a linear scan beats hashing the address
+	for( size_t i = 0; i < mMailboxes.size(); i++ ){
+		if( mMailboxes[i]->getAddress() == address )
+			return mMailboxes[i].get();
+	}
+	return NULL;
+}
+
+WindowedMinimum* OscListener::findSenderClock( const IpEndpointName &endpoint )
+{
+	for( size_t i = 0; i < mSenderClocks.size(); i++ ){
+		if( mSenderClocks[i].mAddress == endpoint.address && mSenderClocks[i].mPort == endpoint.port )
+			return &mSenderClocks[i].mOffset;
+	}
+	return NULL;
+}
+
+void OscListener::ProcessBundle( const ::osc::ReceivedBundle &b, const IpEndpointName& remoteEndpoint ) {
+	// NTP time, seconds since 1900 in 32.32 fixed point. 1 means immediately.
+	static const double NTP_TO_UNIX = 2208988800.0;
+	static const double CLOCK_WINDOW = 10.0;
+	static const double LEAD_TOLERANCE = 0.02;
+	double outerTime = mBundleTime;
+	double outerDueTime = mBundleDueTime;
+	::osc::uint64 timeTag = b.TimeTag();
+	mBundleTime = ( timeTag == 1 ) ? 0 : (double)( timeTag >> 32 ) - NTP_TO_UNIX + (double)( timeTag & 0xFFFFFFFF ) / 4294967296.0;
+	mBundleDueTime = 0;
+	if( mBundleTime > 0 ){
+		double arrival = ( ReceiveTime() > 0 ) ? ReceiveTime() : getNetworkTime();
+		WindowedMinimum *clock = findSenderClock( remoteEndpoint );
+		if( ! clock ){
+			SenderClock sender = { remoteEndpoint.address, remoteEndpoint.port, WindowedMinimum( CLOCK_WINDOW ) };
+			mSenderClocks.push_back( sender );
+			clock = &mSenderClocks.back().mOffset;
+		}
+		// The sender's offset is followed all along, but only used once it's too big to be a lead or
+		// transit. A bundle well ahead of the sender's usual offset was meant for later, so it's left
+		// out of it. One that's lost for a whole window starts it over.
+		double offset = arrival - mBundleTime;
+		if( ! clock->isCurrent( arrival ) )
+			clock->clear();
+		if( clock->isEmpty() || offset > clock->get( arrival ) - LEAD_TOLERANCE )
+			clock->add( arrival, offset );
+		double skew = clock->get( arrival );
+		mBundleDueTime = mBundleTime;
+		if( mMaxClockSkew > 0 && fabs( skew ) > mMaxClockSkew )
+			mBundleDueTime += skew;
+	}
+	
+	for( ::osc::ReceivedBundle::const_iterator i = b.ElementsBegin(); i != b.ElementsEnd(); ++i ){
+		if( i->IsBundle() )
+			ProcessBundle( ::osc::ReceivedBundle( *i ), remoteEndpoint );
+		else
+			ProcessMessage( ::osc::ReceivedMessage( *i ), remoteEndpoint );
+	}
+	mBundleTime = outerTime;
+	mBundleDueTime = outerDueTime;
+}
+
 void OscListener::ProcessMessage( const ::osc::ReceivedMessage &m, const IpEndpointName& remoteEndpoint ) {
-	Message* message = new Message();
+	// Mailboxes want the newest value as soon as it lands, a jitter buffer uses the time tag itself
+	Mailbox *mailbox = findMailbox( m.AddressPattern() );
+	if( mailbox ){
+		// The handler reads the buffer about to be published, so it costs no extra parse
+		Message *message = mailbox->beginPublish();
+		if( message ){
+			fillMessage( message, m, remoteEndpoint );
+			if( mailbox->getHandler() )
+				mailbox->getHandler()( *message );
+			mailbox->publish();
+		}
+		else if( mailbox->getHandler() ){
+			fillMessage( &mCallbackMessage, m, remoteEndpoint );
+			mailbox->getHandler()( mCallbackMessage );
+		}
+		return;
+	}
+	
+	// Anything due later waits for its time. With callbacks the socket thread's timer releases it
+	// to them, otherwise it waits on the app thread for getNextMessage().
+	if( mBundleTime > 0 && mBundleDueTime > ReceiveTime() ){
+		if( mHasCallbacks ){
+			if( mCallbackSchedule.size() >= mQueueCapacity ){
+				mNumCallbacksUnscheduled.fetch_add( 1, memory_order_relaxed );
+				return;
+			}
+			fillMessage( &mCallbackMessage, m, remoteEndpoint );
+			mCallbackMessage.setDeliveryTime( mBundleDueTime );
+			mCallbackSchedule.add( mBundleDueTime, &mCallbackMessage );
+			return;
+		}
+		Message *message = mScheduled.beginPush();
+		if( message ){
+			fillMessage( message, m, remoteEndpoint );
+			message->setDeliveryTime( mBundleDueTime );
+			mScheduled.endPush();
+		}
+		return;
+	}
+	
+	if( mDispatcher || mHasCallbacks ){
+		fillMessage( &mCallbackMessage, m, remoteEndpoint );
+		deliver( &mCallbackMessage );
+		return;
+	}
 	
+	// Nothing looks at it on this thread, so it's parsed straight into the queue's slot
+	Message* message = mMessages.beginPush();
+	if( ! message )
+		return;
+	fillMessage( message, m, remoteEndpoint );
+	mMessages.endPush();
+}
+
+// The dispatcher gets first refusal, then the callbacks, then the queue. Socket thread only.
+void OscListener::deliver( Message *message )
+{
+	if( mDispatcher && mDispatcher->dispatch( *message ) )
+		return;
+	
+	if( mHasCallbacks ){
+		lock_guard<mutex> lock( mMutex );
+		mMessageReceivedCbs.call( message );
+		return;
+	}
+	
+	Message* slot = mMessages.beginPush();
+	if( ! slot )
+		return;
+	slot->swap( *message );	// Already filled, hand it over instead of parsing again
+	mMessages.endPush();
+}
+
+void OscListener::TimerExpired()
+{
+	releaseScheduled();
+}
+
+void OscListener::releaseScheduled()
+{
+	if( mCallbackSchedule.size() == 0 )
+		return;
+	double now = getNetworkTime();
+	while( mCallbackSchedule.pop( now, &mCallbackMessage ) )
+		deliver( &mCallbackMessage );
+}
+
+void OscListener::fillMessage( Message *message, const ::osc::ReceivedMessage &m, const IpEndpointName& remoteEndpoint ) {
+	message->clear();
 	message->setAddress(m.AddressPattern());
 	
 	char endpoint_host[IpEndpointName::ADDRESS_STRING_LENGTH];
 	remoteEndpoint.AddressAsString(endpoint_host);
 	message->setRemoteEndpoint(endpoint_host, remoteEndpoint.port);
+	message->setReceiveTime(ReceiveTime());
+	message->setTimeTag(mBundleTime);
+	message->setDeliveryTime(ReceiveTime());
 	
 	for (::osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin(); arg != m.ArgumentsEnd(); ++arg){
 		if (arg->IsInt32())
@@ -136,49 +757,46 @@ void OscListener::ProcessMessage( const ::osc::ReceivedMessage &m, const IpEndpo
 			assert(false && "message argument type unknown");
 		}
 	}
-	
-	lock_guard<mutex> lock(mMutex);
-	
-	if( mMessageReceivedCbs.empty() ){
-		mMessages.push_back( message );
-	}else{
-		mMessageReceivedCbs.call( message );
-		delete message;
-	}
+}
+
+void OscListener::collectScheduled() const
+{
+	while( mScheduled.pop( &mScheduledMessage ) )
+		mSchedule.add( mScheduledMessage.getDeliveryTime(), &mScheduledMessage );
 }
 
 bool OscListener::hasWaitingMessages() const
 {
-	std::lock_guard<mutex> lock( mMutex );
-	return ! mMessages.empty();
+	collectScheduled();
+	return ! mMessages.isEmpty() || mSchedule.isDue( getNetworkTime() );
 }
 
 bool OscListener::getNextMessage( Message* message )
 {
-	lock_guard<mutex> lock( mMutex );
-	
-	if( mMessages.empty() )
-		return false;
-	
-	Message* src_message = mMessages.front();
-	message->copy( *src_message );
-	
-	delete src_message;	
-	mMessages.pop_front();
-	
-	return true;
+	// Scheduled messages come out once they're due, on this thread. The dispatcher
+	// gets first refusal as it would have on the socket thread.
+	collectScheduled();
+	double now = getNetworkTime();
+	while( mSchedule.pop( now, message ) ){
+		if( ! mDispatcher || ! mDispatcher->dispatch( *message ) )
+			return true;
+	}
+	return mMessages.pop( message );
 }
 
 CallbackId OscListener::registerMessageReceived( std::function<void (const osc::Message*)> callback )
 {
 	lock_guard<mutex> lock( mMutex );
-	return mMessageReceivedCbs.registerCb( callback );
+	CallbackId id = mMessageReceivedCbs.registerCb( callback );
+	mHasCallbacks = true;
+	return id;
 }
 
 void OscListener::unregisterMessageReceived( CallbackId id )
 {
 	lock_guard<mutex> lock(mMutex);
-	return mMessageReceivedCbs.unregisterCb( id );
+	mMessageReceivedCbs.unregisterCb( id );
+	mHasCallbacks = ! mMessageReceivedCbs.empty();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -187,8 +805,12 @@ Listener::Listener() {
 	oscListener = std::shared_ptr<OscListener>( new OscListener );
 }
 
-void Listener::setup(int listen_port){
-	oscListener->setup(listen_port);
+void Listener::setup( int listen_port, size_t queueCapacity, int receiveBufferSize ){
+	oscListener->setup( listen_port, queueCapacity, receiveBufferSize );
+}
+
+void Listener::setupSharedMemory( const std::string &name, size_t queueCapacity ){
+	oscListener->setupSharedMemory( name, queueCapacity );
 }
 
 void Listener::shutdown(){
@@ -203,6 +825,42 @@ bool Listener::getNextMessage(Message* message) {
 	return oscListener->getNextMessage(message);
 }
 
+uint32_t Listener::getNumDroppedMessages() const {
+	return oscListener->getNumDroppedMessages();
+}
+
+uint32_t Listener::getNumDroppedPackets() const {
+	return oscListener->getNumDroppedPackets();
+}
+
+size_t Listener::getNumScheduledMessages() const {
+	return oscListener->getNumScheduledMessages();
+}
+
+int Listener::registerMailbox( const std::string &address, double jitterDelay ) {
+	return oscListener->registerMailbox( address, jitterDelay );
+}
+
+void Listener::setMailboxHandler( int id, const std::function<void (const Message&)> &handler ) {
+	oscListener->setMailboxHandler( id, handler );
+}
+
+bool Listener::getLatestMessage( int id, Message *message ) {
+	return oscListener->getLatestMessage( id, message );
+}
+
+uint32_t Listener::getNumOverwrittenMessages( int id ) const {
+	return oscListener->getNumOverwrittenMessages( id );
+}
+
+void Listener::setDispatcher( const std::shared_ptr<Dispatcher> &dispatcher ) {
+	oscListener->setDispatcher( dispatcher );
+}
+
+void Listener::setMaxClockSkew( double seconds ) {
+	oscListener->setMaxClockSkew( seconds );
+}
+
 CallbackId Listener::registerMessageReceived( std::function<void (const osc::Message*)> callback )
 {
 	return oscListener->registerMessageReceived( callback );
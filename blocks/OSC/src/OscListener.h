@@ -31,6 +31,7 @@
 
 #include "OscMessage.h"
 #include "OscArg.h"
+#include "OscDispatcher.h"
 
 
 namespace cinder { namespace osc {
@@ -39,7 +40,13 @@ class Listener {
   public:
 	Listener();
 	
-	void setup(int listen_port);
+	//! Starts listening on \a listen_port. Messages are queued in a ring of \a queueCapacity preallocated slots (rounded up to a power of two).
+	//! A \a receiveBufferSize in bytes enlarges the socket's kernel buffer to ride out bursts, 0 keeps the system default.
+	void setup( int listen_port, size_t queueCapacity = 1024, int receiveBufferSize = 0 );
+	//! Listens on the shared memory ring called \a name instead of a socket, for a tracker on the same host writing with Sender::setupSharedMemory().
+	//! Packets are parsed where the sender wrote them and everything downstream works as with setup(). The ring holds \a queueCapacity packets.
+	//! Throws std::runtime_error if the shared memory can't be created.
+	void setupSharedMemory( const std::string &name, size_t queueCapacity = 1024 );
 	void shutdown();
 	
 	// Callback methods
@@ -51,10 +58,44 @@ class Listener {
 	//! Unregisters an asynchronous callback previously registered with registerMessageReceived()
 	void		unregisterMessageReceived( CallbackId id );
 
-	//! Returns whether the are messages waiting to be processed via getNextMessage(). Always \c false if callbacks have been registered using registerMessageReceived().
+	//! Returns whether the are messages waiting to be processed via getNextMessage(). Always \c false while callbacks are registered using registerMessageReceived(), except for time tagged messages that were already waiting when the first one was.
 	bool hasWaitingMessages() const;
-	//! Gets the next message to be processed and puts it in \a resultMessage. Returns whether there was a message to process or not. Always \c false if callbacks have been registered using registerMessageReceived().
+	//! Gets the next message to be processed and puts it in \a resultMessage. Returns whether there was a message to process or not. Always \c false while callbacks are registered using registerMessageReceived(), except for time tagged messages that were already waiting when the first one was.
 	bool getNextMessage( Message *resultMessage );
+	//! Returns how many messages were dropped because the queue was full. The socket thread never waits for the app to catch up.
+	uint32_t getNumDroppedMessages() const;
+	//! Returns how many packets the kernel dropped because the socket buffer overflowed. Only counted on Linux.
+	//! With shared memory, how many packets the sender dropped because the ring was full.
+	uint32_t getNumDroppedPackets() const;
+	
+	// Scheduling
+	// Messages in bundles time tagged for the future are held until their time on our clock. A dispatcher
+	// gets them first. With callbacks registered they wait on the socket thread and go to the callbacks
+	// from there, up to a few ms late, otherwise getNextMessage() hands them out on the app thread.
+	// Time tags are taken at face value unless a sender's clock is clearly off: when the gap between its
+	// tags and their arrival stays over the setMaxClockSkew() bound either way, its recent fastest bundle
+	// is taken to have been due on arrival and the rest keep their spacing from it. A bundle tagged
+	// further ahead than the sender's others still waits the difference, but a lead the sender puts on
+	// all of them is lost along with the skew.
+	//! Returns how many time tagged messages are waiting for getNextMessage(). Only counts those it or hasWaitingMessages() has seen.
+	size_t getNumScheduledMessages() const;
+	//! Sets how far a sender's time tags may be from our clock, ahead or behind, before its clock is corrected for. Defaults to 1 second, 0 always takes the tags as they are. Call before setup().
+	void setMaxClockSkew( double seconds );
+	
+	// Mailboxes
+	//! Keeps only the newest message sent to \a address instead of queueing every one, for state like positions where stale values are useless. Messages to a mailbox skip the queue and the callbacks. Call before setup(). Returns the id to read it with.
+	//! A \a jitterDelay in seconds holds each message back by that much past its expected arrival, so that getLatestMessage() releases them as evenly spaced as they were sent. Messages' delivery times are set to their slot.
+	int			registerMailbox( const std::string &address, double jitterDelay = 0 );
+	//! Also calls \a handler with every message sent to mailbox \a id as it arrives, on the socket thread and before any jitter delay, for consumers like filters that need each sample and not just the newest. Call before setup().
+	void		setMailboxHandler( int id, const std::function<void (const Message&)> &handler );
+	//! Puts the newest message sent to mailbox \a id in \a resultMessage if one arrived since the last call. Lock free, never waits on the socket thread.
+	bool		getLatestMessage( int id, Message *resultMessage );
+	//! Returns how many messages to mailbox \a id were replaced before they were read, or dropped because its jitter buffer was full.
+	uint32_t	getNumOverwrittenMessages( int id ) const;
+	
+	// Dispatch
+	//! Routes messages through \a dispatcher on the socket thread. Messages it handles skip the queue and the callbacks, the rest carry on as usual. Call before setup().
+	void		setDispatcher( const std::shared_ptr<Dispatcher> &dispatcher );
 	
   private:
 	std::shared_ptr<class OscListener>   oscListener;
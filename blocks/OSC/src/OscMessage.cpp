@@ -25,112 +25,207 @@
  */
 
 #include "OscMessage.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
 
 namespace cinder { namespace osc {
 
+// Every address seen so far, shared by all messages. Lookups are lock free; the first time an
+// address shows up it's copied once and published with a compare and swap. Entries are never
+// removed, so once the table fills up new addresses are just stored in the message itself.
+static const size_t INTERN_CAPACITY		= 1024;	// Must be a power of two
+static const size_t INTERN_MAX_PROBES	= 16;
+static std::atomic<const std::string*> sInterned[INTERN_CAPACITY];
+
+static const std::string* internAddress( const char *address, size_t length )
+{
+	// FNV-1a
+	uint32_t hash = 2166136261u;
+	for( size_t i = 0; i < length; i++ )
+		hash = ( hash ^ (uint8_t)address[i] ) * 16777619u;
+	
+	for( size_t probe = 0; probe < INTERN_MAX_PROBES; probe++ ){
+		std::atomic<const std::string*> &slot = sInterned[( hash + probe ) & ( INTERN_CAPACITY - 1 )];
+		const std::string *entry = slot.load( std::memory_order_acquire );
+		if( ! entry ){
+			const std::string *created = new std::string( address, length );
+			if( slot.compare_exchange_strong( entry, created, std::memory_order_acq_rel ) )
+				return created;
+			// Another thread took the slot first, entry is now theirs
+			delete created;
+		}
+		if( entry->size() == length && memcmp( entry->data(), address, length ) == 0 )
+			return entry;
+	}
+	return NULL;
+}
+
 Message::~Message(){
-	clear();
 }
 
 void Message::clear(){
-	for (unsigned int i=0; i < args.size(); ++i){
-		delete args[i];
-	}
-	args.clear();
-	address = "";
+	num_args = 0;
+	extra_args.clear();
+	interned_address = NULL;
+	address.clear();
+	receive_time = 0;
+	time_tag = 0;
+	delivery_time = 0;
+}
+
+double getNetworkTime(){
+	// Same clock as the sockets' timestamps
+	std::chrono::duration<double> now = std::chrono::system_clock::now().time_since_epoch();
+	return now.count();
+}
+
+double Message::getReceiveAge() const{
+	if( receive_time == 0 )
+		return 0;
+	// Never negative if the clock steps back
+	return std::max( getNetworkTime() - receive_time, 0.0 );
+}
+
+double Message::getDeliveryAge() const{
+	if( delivery_time == 0 )
+		return 0;
+	return std::max( getNetworkTime() - delivery_time, 0.0 );
+}
+
+void Message::setAddress( const char *_address, size_t length ){
+	interned_address = internAddress( _address, length );
+	if( interned_address )
+		address.clear();
+	else
+		address.assign( _address, length );
 }
 
 int Message::getNumArgs() const{
-	return (int)args.size();
+	return num_args;
 }
 
-ArgType Message::getArgType(int index) const{
-	if (index >= (int)args.size()){
+const Arg& Message::getArg( int index ) const{
+	if( index < 0 || index >= num_args )
 		throw OscExcOutOfBounds();
-	}else {
-		return args[index]->getType();
-	}
+	return index < INLINE_ARGS ? args[index] : extra_args[index - INLINE_ARGS];
+}
+
+Arg& Message::addArg(){
+	int index = num_args++;
+	if( index < INLINE_ARGS )
+		return args[index];
+	extra_args.push_back( Arg() );
+	return extra_args.back();
+}
+
+ArgType Message::getArgType(int index) const{
+	return getArg( index ).getType();
 }
 
 std::string Message::getArgTypeName(int index) const{
-	if (index >= (int)args.size()){
-		throw OscExcOutOfBounds();
-	}else {
-		return args[index]->getTypeName();
-	}
+	return getArg( index ).getTypeName();
 }
 
 int32_t Message::getArgAsInt32(int index, bool typeConvert) const{
-	if (getArgType(index) != TYPE_INT32){
-		if( typeConvert && (getArgType(index) == TYPE_FLOAT) )
-			return (int32_t)((ArgFloat*)args[index])->get();
+	const Arg &arg = getArg( index );
+	if (arg.getType() != TYPE_INT32){
+		if( typeConvert && (arg.getType() == TYPE_FLOAT) )
+			return (int32_t)arg.getFloat();
 		else
 			throw OscExcInvalidArgumentType();
 	}else 
-		return ((ArgInt32*)args[index])->get();
+		return arg.getInt32();
 }
 
 float Message::getArgAsFloat(int index, bool typeConvert) const{
-	if (getArgType(index) != TYPE_FLOAT){
-		if( typeConvert && (getArgType(index) == TYPE_INT32) )
-			return (float)((ArgInt32*)args[index])->get();
+	const Arg &arg = getArg( index );
+	if (arg.getType() != TYPE_FLOAT){
+		if( typeConvert && (arg.getType() == TYPE_INT32) )
+			return (float)arg.getInt32();
 		else
 			throw OscExcInvalidArgumentType();
 	}else
-        return ((ArgFloat*)args[index])->get();
+        return arg.getFloat();
 }
 
 std::string Message::getArgAsString( int index, bool typeConvert ) const{
-    if (getArgType(index) != TYPE_STRING ){
-	    if (typeConvert && (getArgType(index) == TYPE_FLOAT) ){
+	const Arg &arg = getArg( index );
+    if (arg.getType() != TYPE_STRING ){
+	    if (typeConvert && (arg.getType() == TYPE_FLOAT) ){
             char buf[1024];
-            sprintf(buf,"%f",((ArgFloat*)args[index])->get() );
+            sprintf(buf,"%f",arg.getFloat() );
             return std::string( buf );
         }
-	    else if (typeConvert && (getArgType(index) == TYPE_INT32)){
+	    else if (typeConvert && (arg.getType() == TYPE_INT32)){
             char buf[1024];
-            sprintf(buf,"%i",((ArgInt32*)args[index])->get() );
+            sprintf(buf,"%i",arg.getInt32() );
             return std::string( buf );
         }
         else
             throw OscExcInvalidArgumentType();
 	}
 	else
-        return ((ArgString*)args[index])->get();
+        return std::string( arg.getCString(), arg.getLength() );
+}
+
+const char* Message::getArgAsCString( int index ) const{
+	const Arg &arg = getArg( index );
+	if( arg.getType() != TYPE_STRING )
+		throw OscExcInvalidArgumentType();
+	return arg.getCString();
 }
 
 void Message::addIntArg( int32_t argument ){
-	args.push_back( new ArgInt32( argument ) );
+	addArg().setInt32( argument );
 }
 
 void Message::addFloatArg( float argument ){
-	args.push_back( new ArgFloat( argument ) );
+	addArg().setFloat( argument );
 }
 
-void Message::addStringArg( std::string argument ){
-	args.push_back( new ArgString( argument ) );
+void Message::addStringArg( const std::string &argument ){
+	addArg().setString( argument.c_str(), argument.size() );
+}
+
+void Message::addStringArg( const char *argument ){
+	addArg().setString( argument, strlen( argument ) );
+}
+
+void Message::swap( Message& other ){
+	std::swap( interned_address, other.interned_address );
+	address.swap( other.address );
+	int inlineCount = std::min( std::max( num_args, other.num_args ), (int)INLINE_ARGS );
+	for( int i = 0; i < inlineCount; i++ )
+		args[i].swap( other.args[i] );
+	extra_args.swap( other.extra_args );
+	remote_host.swap( other.remote_host );
+	std::swap( remote_port, other.remote_port );
+	std::swap( receive_time, other.receive_time );
+	std::swap( time_tag, other.time_tag );
+	std::swap( delivery_time, other.delivery_time );
+	std::swap( num_args, other.num_args );
 }
 	
 Message& Message::copy( const Message& other ){
+	if( &other == this )
+		return *this;
 
+	interned_address = other.interned_address;
 	address = other.address;
 	
 	remote_host = other.remote_host;
 	remote_port = other.remote_port;
+	receive_time = other.receive_time;
+	time_tag = other.time_tag;
+	delivery_time = other.delivery_time;
 	
-	for ( int i=0; i<(int)other.args.size(); ++i ){
-		ArgType argType = other.getArgType( i );
-		if ( argType == TYPE_INT32 )
-			args.push_back( new ArgInt32( other.getArgAsInt32( i ) ) );
-		else if ( argType == TYPE_FLOAT )
-			args.push_back( new ArgFloat( other.getArgAsFloat( i ) ) );
-		else if ( argType == TYPE_STRING )
-			args.push_back( new ArgString( other.getArgAsString( i ) ) );
-		else
-		{
-			throw OscExcInvalidArgumentType();
-		}
-	}
+	// Assigning into the existing args reuses their storage
+	num_args = other.num_args;
+	for( int i = 0; i < std::min( num_args, (int)INLINE_ARGS ); ++i )
+		args[i] = other.args[i];
+	extra_args = other.extra_args;
 	
 	return *this;
 }
@@ -35,21 +35,46 @@
 
 namespace cinder { namespace osc {
 	
+	/// Messages are plain values. The first INLINE_ARGS arguments live inside the message and
+	/// addresses are interned, so building, copying and reading a typical message doesn't allocate.
 	class Message {
 	public:
-		Message() {}
+		static const int INLINE_ARGS = 8;
+		
+		Message() : interned_address( NULL ), remote_port( 0 ), receive_time( 0 ), time_tag( 0 ), delivery_time( 0 ), num_args( 0 ) {}
 		~Message();
-		Message( const Message& other ){ copy ( other ); }
+		Message( const Message& other ) : interned_address( NULL ), remote_port( 0 ), receive_time( 0 ), time_tag( 0 ), delivery_time( 0 ), num_args( 0 ) { copy ( other ); }
 		Message& operator= ( const Message& other ) { return copy( other ); }
 
+		//! Replaces this message's contents with \a other's
 		Message& copy( const Message& other );
+		//! Exchanges contents with \a other without copying or allocating
+		void swap( Message& other );
 		void clear();
 		
-		std::string getAddress() const { return address; }
-		std::string getRemoteIp() const { return remote_host; }
+		const std::string& getAddress() const { return interned_address ? *interned_address : address; }
+		const std::string& getRemoteIp() const { return remote_host; }
 		int getRemotePort() const { return remote_port; }
-		void setAddress( std::string _address ) { address = _address; };
-		void setRemoteEndpoint( std::string host, int port ) { remote_host = host; remote_port = port; }
+		void setAddress( const std::string &_address ) { setAddress( _address.c_str(), _address.size() ); }
+		void setAddress( const char *_address ) { setAddress( _address, strlen( _address ) ); }
+		void setAddress( const char *_address, size_t length );
+		void setRemoteEndpoint( const std::string &host, int port ) { remote_host.assign( host ); remote_port = port; }
+		void setRemoteEndpoint( const char *host, int port ) { remote_host.assign( host ); remote_port = port; }
+		
+		//! Returns when the packet carrying this message arrived, in seconds since 1970, or 0 for messages that weren't received.
+		//! Kernel timestamped where the socket supports it, otherwise read on the socket thread.
+		double getReceiveTime() const { return receive_time; }
+		void setReceiveTime( double seconds ) { receive_time = seconds; }
+		//! Returns how many seconds ago the message arrived, 0 if it wasn't received. Subtract from the app's clock to timestamp samples.
+		double getReceiveAge() const;
+		//! Returns the time tag of the bundle the message came in, in seconds since 1970, or 0 if it came on its own or was tagged "immediately".
+		double getTimeTag() const { return time_tag; }
+		void setTimeTag( double seconds ) { time_tag = seconds; }
+		//! Returns when the listener released the message: its time tag mapped onto our clock if it was scheduled, its slot in a jitter buffer, otherwise its receive time.
+		double getDeliveryTime() const { return delivery_time; }
+		void setDeliveryTime( double seconds ) { delivery_time = seconds; }
+		//! Returns how many seconds ago the message was due, 0 if it wasn't received.
+		double getDeliveryAge() const;
 		
 		int getNumArgs() const;
 		ArgType getArgType( int index ) const;
@@ -58,19 +83,34 @@ namespace cinder { namespace osc {
 		int32_t getArgAsInt32( int index, bool typeConvert = false ) const;
 		float getArgAsFloat( int index, bool typeConvert = false ) const;
 		std::string getArgAsString( int index, bool typeConvert = false ) const;
+		//! Borrows a string argument's characters, valid until the message changes
+		const char* getArgAsCString( int index ) const;
 		
 		void addIntArg( int32_t argument );
 		void addFloatArg( float argument );
-		void addStringArg( std::string argument );
+		void addStringArg( const std::string &argument );
+		void addStringArg( const char *argument );
 		
 	protected:
+		const Arg& getArg( int index ) const;
+		Arg& addArg();
+		
+		const std::string *interned_address;	// Shared copy of the address, or NULL if it's in address
 		std::string address;
-		std::vector<Arg*> args;
+		Arg args[INLINE_ARGS];
+		std::vector<Arg> extra_args;			// Past INLINE_ARGS
 		
 		std::string remote_host;
-		int remote_port;	
+		int remote_port;
+		double receive_time;
+		double time_tag;
+		double delivery_time;
+		int num_args;
 	};
 	
+	//! Returns the current time on the clock receive times and time tags are converted to, in seconds since 1970.
+	double getNetworkTime();
+	
 	class OscExc : public Exception {
 	};
 	class OscExcInvalidArgumentType : public OscExc {
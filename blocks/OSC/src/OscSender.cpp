@@ -30,55 +30,148 @@
 #include "osc/OscOutboundPacketStream.h"
 #include "osc/OscTypes.h"
 #include "ip/UdpSocket.h"
+#include "ip/SharedMemoryRing.h"
+
+#include "cinder/Thread.h"
 
 #include <assert.h>
+#include <atomic>
+#include <vector>
 namespace cinder { namespace osc {
 	
+	// An encode buffer reused from frame to frame. The stream writes straight into it.
+	struct Packet {
+		Packet( size_t capacity ) : buffer( capacity ), stream( &buffer[0], (unsigned long)capacity ), numMessages( 0 ) {}
+		
+		std::vector<char>				buffer;
+		::osc::OutboundPacketStream		stream;
+		int								numMessages;
+	};
+	
 	class OscSender  {
 	public:
 		OscSender();
 		~OscSender();
 		
-		void setup( std::string hostname, int port, bool multicast );
+		void setup( std::string hostname, int port, bool multicast, bool sendOnThread );
+		void setupSharedMemory( const std::string &name );
 		
 		void sendMessage( const Message &message );
 		void sendBundle( const Bundle &bundle );
 		
+		void queueMessage( const Message &message );
+		void flush();
+		void setMaxPacketSize( size_t bytes ) { maxPacketSize = bytes; }
+		
+		uint32_t getNumPacketsSent() const { return numPacketsSent; }
+		uint32_t getNumMessagesSent() const { return numMessagesSent; }
+		
 		void shutdown();
 	private:
 		
 		void appendBundle( const Bundle &bundle, ::osc::OutboundPacketStream &p );
 		void appendMessage( const Message &message, ::osc::OutboundPacketStream &p );
+		static size_t getEncodedSize( const Message &message );
+		void writeSharedMessage( const Message &message );
+		void writeSharedBundle( const Bundle &bundle );
+		
+		Packet* acquirePacket( size_t capacity );
+		void sendPackets( const std::vector<Packet*> &sendPackets );
+		void releasePackets( const std::vector<Packet*> &sendPackets );
+		void threadSend();
 		
 		UdpTransmitSocket* socket;
+		SharedMemoryRing* sharedRing;					// Instead of the socket, messages are encoded straight into its records
+		size_t maxPacketSize;
 		
+		std::vector<std::shared_ptr<Packet> > pool;		// Owns every packet, only grows
+		std::vector<Packet*> freePackets;				// Guarded by mutex
+		std::vector<Packet*> queuedPackets;				// Being filled by the app
+		Packet* currentPacket;
+		std::vector<const char*> sendData;				// Scratch for SendMultiple, reused
+		std::vector<int> sendSizes;
+		
+		// Background sending
+		std::shared_ptr<std::thread> thread;
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::vector<Packet*> pendingPackets;			// Handed to the thread, guarded by mutex
+		bool threadRunning;
+		
+		std::atomic<uint32_t> numPacketsSent;
+		std::atomic<uint32_t> numMessagesSent;
 	};
 	
 	
 
 OscSender::OscSender(){
 	socket = NULL;
+	sharedRing = NULL;
+	maxPacketSize = 1472;	// 1500 byte MTU less the IP and UDP headers
+	currentPacket = NULL;
+	threadRunning = false;
+	numPacketsSent = 0;
+	numMessagesSent = 0;
 }
 
 OscSender::~OscSender(){
-	if (socket)
+	if (socket || sharedRing)
 		shutdown();
 }
 
-void OscSender::setup( std::string hostname, int port, bool multicast )
+void OscSender::setup( std::string hostname, int port, bool multicast, bool sendOnThread )
 {
-	if( socket )
+	if( socket || sharedRing )
 		shutdown();
 	socket = new UdpTransmitSocket( IpEndpointName(hostname.c_str(), port), multicast );
+	
+	if( sendOnThread ){
+		threadRunning = true;
+		thread = std::shared_ptr<std::thread>( new std::thread( &OscSender::threadSend, this ) );
+	}
+}
+
+void OscSender::setupSharedMemory( const std::string &name )
+{
+	if( socket || sharedRing )
+		shutdown();
+	sharedRing = new SharedMemoryRing( name.c_str(), 0, false );
 }
 
 void OscSender::shutdown(){
+	if( thread ){
+		{
+			std::lock_guard<std::mutex> lock( mutex );
+			threadRunning = false;
+		}
+		condition.notify_one();
+		thread->join();
+		thread.reset();
+	}
+	
+	// Anything queued but not flushed is dropped
+	if( currentPacket )
+		queuedPackets.push_back( currentPacket );
+	currentPacket = NULL;
+	releasePackets( queuedPackets );
+	queuedPackets.clear();
+	
 	if (socket)
 		delete socket;
 	socket = NULL;
+	
+	if( sharedRing )
+		delete sharedRing;
+	sharedRing = NULL;
 }
 
 void OscSender::sendBundle( const Bundle &bundle ){
+	if( sharedRing ){
+		writeSharedBundle( bundle );
+		sharedRing->Notify();
+		return;
+	}
+	
 	static const int OUTPUT_BUFFER_SIZE = 32768;
 	char buffer[OUTPUT_BUFFER_SIZE];
 	
@@ -87,10 +180,18 @@ void OscSender::sendBundle( const Bundle &bundle ){
 	appendBundle( bundle, p );
 	
 	socket->Send(p.Data(), p.Size());
+	numPacketsSent++;
+	numMessagesSent += bundle.getMessageCount();
 }
 
 void OscSender::sendMessage( const Message &message )
 {
+	if( sharedRing ){
+		writeSharedMessage( message );
+		sharedRing->Notify();
+		return;
+	}
+	
 	static const int OUTPUT_BUFFER_SIZE = 16384;
 	char buffer[OUTPUT_BUFFER_SIZE];
 	::osc::OutboundPacketStream p(buffer, OUTPUT_BUFFER_SIZE);
@@ -100,6 +201,166 @@ void OscSender::sendMessage( const Message &message )
 	p << ::osc::EndBundle;
 	
 	socket->Send(p.Data(), p.Size());
+	numPacketsSent++;
+	numMessagesSent++;
+}
+
+void OscSender::queueMessage( const Message &message )
+{
+	// Each message gets a record of its own, the reader only wakes up on flush()
+	if( sharedRing ){
+		writeSharedMessage( message );
+		return;
+	}
+	
+	// Bundle header, then a size slot and the message itself
+	static const size_t BUNDLE_HEADER_SIZE = 16;
+	size_t messageSize = 4 + getEncodedSize( message );
+	
+	if( currentPacket && currentPacket->stream.Size() + messageSize > maxPacketSize ){
+		queuedPackets.push_back( currentPacket );
+		currentPacket = NULL;
+	}
+	if( ! currentPacket ){
+		currentPacket = acquirePacket( std::max( maxPacketSize, BUNDLE_HEADER_SIZE + messageSize ) );
+		currentPacket->stream << ::osc::BeginBundleImmediate;
+	}
+	
+	appendMessage( message, currentPacket->stream );
+	currentPacket->numMessages++;
+}
+
+void OscSender::flush()
+{
+	if( sharedRing ){
+		sharedRing->Notify();
+		return;
+	}
+	
+	if( currentPacket ){
+		queuedPackets.push_back( currentPacket );
+		currentPacket = NULL;
+	}
+	if( queuedPackets.empty() )
+		return;
+	
+	for( size_t i = 0; i < queuedPackets.size(); i++ )
+		queuedPackets[i]->stream << ::osc::EndBundle;
+	
+	if( thread ){
+		{
+			std::lock_guard<std::mutex> lock( mutex );
+			pendingPackets.insert( pendingPackets.end(), queuedPackets.begin(), queuedPackets.end() );
+		}
+		condition.notify_one();
+	}
+	else {
+		sendPackets( queuedPackets );
+		releasePackets( queuedPackets );
+	}
+	queuedPackets.clear();
+}
+
+Packet* OscSender::acquirePacket( size_t capacity )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	
+	// Anything big enough will do, the usual case is the first one
+	for( size_t i = freePackets.size(); i-- > 0; ){
+		Packet *packet = freePackets[i];
+		if( packet->buffer.size() >= capacity ){
+			freePackets.erase( freePackets.begin() + i );
+			packet->stream.Clear();
+			packet->numMessages = 0;
+			return packet;
+		}
+	}
+	
+	// The pool grows to the busiest frame so far, then stops allocating
+	pool.push_back( std::shared_ptr<Packet>( new Packet( capacity ) ) );
+	return pool.back().get();
+}
+
+void OscSender::releasePackets( const std::vector<Packet*> &packets )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	freePackets.insert( freePackets.end(), packets.begin(), packets.end() );
+}
+
+void OscSender::sendPackets( const std::vector<Packet*> &packets )
+{
+	sendData.resize( packets.size() );
+	sendSizes.resize( packets.size() );
+	uint32_t numMessages = 0;
+	for( size_t i = 0; i < packets.size(); i++ ){
+		sendData[i] = packets[i]->stream.Data();
+		sendSizes[i] = (int)packets[i]->stream.Size();
+		numMessages += packets[i]->numMessages;
+	}
+	
+	socket->SendMultiple( &sendData[0], &sendSizes[0], (int)packets.size() );
+	numPacketsSent += (uint32_t)packets.size();
+	numMessagesSent += numMessages;
+}
+
+void OscSender::threadSend()
+{
+	std::vector<Packet*> packets;
+	while( true ){
+		{
+			std::unique_lock<std::mutex> lock( mutex );
+			while( threadRunning && pendingPackets.empty() )
+				condition.wait( lock );
+			if( pendingPackets.empty() )
+				return;
+			packets.swap( pendingPackets );
+		}
+		
+		sendPackets( packets );
+		releasePackets( packets );
+		packets.clear();
+	}
+}
+
+void OscSender::writeSharedMessage( const Message &message )
+{
+	// Nowhere to put it if the reader has fallen behind, the ring counts the drop
+	char *record = sharedRing->BeginWrite();
+	if( ! record )
+		return;
+	
+	::osc::OutboundPacketStream p( record, SharedMemoryRing::MAX_PACKET_SIZE );
+	appendMessage( message, p );
+	sharedRing->EndWrite( (int)p.Size() );
+	numPacketsSent++;
+	numMessagesSent++;
+}
+
+void OscSender::writeSharedBundle( const Bundle &bundle )
+{
+	char *record = sharedRing->BeginWrite();
+	if( ! record )
+		return;
+	
+	::osc::OutboundPacketStream p( record, SharedMemoryRing::MAX_PACKET_SIZE );
+	appendBundle( bundle, p );
+	sharedRing->EndWrite( (int)p.Size() );
+	numPacketsSent++;
+	numMessagesSent += bundle.getMessageCount();
+}
+
+size_t OscSender::getEncodedSize( const Message &message )
+{
+	// Everything is padded to four bytes, strings keep at least one null
+	size_t size = ( message.getAddress().size() + 4 ) & ~3;
+	size += ( message.getNumArgs() + 2 + 3 ) & ~3;		// Comma, tags and a null
+	for( int i = 0; i < message.getNumArgs(); i++ ){
+		if( message.getArgType( i ) == TYPE_STRING )
+			size += ( strlen( message.getArgAsCString( i ) ) + 4 ) & ~3;
+		else
+			size += 4;
+	}
+	return size;
 }
 
 void OscSender::appendBundle( const Bundle &bundle, ::osc::OutboundPacketStream& p )
@@ -123,7 +384,7 @@ void OscSender::appendMessage( const Message& message, ::osc::OutboundPacketStre
 		}else if (message.getArgType(i) == TYPE_FLOAT){
 			p << message.getArgAsFloat(i);
 		}else if (message.getArgType(i) == TYPE_STRING){
-			p << message.getArgAsString(i).c_str();
+			p << message.getArgAsCString(i);
 		}else {
 			throw OscExcInvalidArgumentType();
 		}
@@ -137,9 +398,14 @@ Sender::Sender()
 	oscSender = std::shared_ptr<OscSender>( new OscSender );
 }
 
-void Sender::setup( std::string hostname, int port, bool multicast )
+void Sender::setup( std::string hostname, int port, bool multicast, bool sendOnThread )
 {
-	oscSender->setup( hostname, port, multicast );
+	oscSender->setup( hostname, port, multicast, sendOnThread );
+}
+
+void Sender::setupSharedMemory( const std::string &name )
+{
+	oscSender->setupSharedMemory( name );
 }
 
 void Sender::sendMessage( const Message& message )
@@ -151,6 +417,31 @@ void Sender::sendBundle( const Bundle& bundle )
 {
 	oscSender->sendBundle( bundle );
 }
+
+void Sender::queueMessage( const Message& message )
+{
+	oscSender->queueMessage( message );
+}
+
+void Sender::flush()
+{
+	oscSender->flush();
+}
+
+void Sender::setMaxPacketSize( size_t bytes )
+{
+	oscSender->setMaxPacketSize( bytes );
+}
+
+uint32_t Sender::getNumPacketsSent() const
+{
+	return oscSender->getNumPacketsSent();
+}
+
+uint32_t Sender::getNumMessagesSent() const
+{
+	return oscSender->getNumMessagesSent();
+}
 	
 }// namespace cinder
 }// namespace osc
\ No newline at end of file
@@ -37,11 +37,28 @@ class Sender  {
   public:
 	Sender();
 	
-	void setup( std::string hostname, int port, bool multicast = false );
+	//! With \a sendOnThread, flush() hands packets to a background thread instead of sending them itself.
+	void setup( std::string hostname, int port, bool multicast = false, bool sendOnThread = false );
+	//! Writes to the shared memory ring called \a name, which a Listener on the same host made with Listener::setupSharedMemory(), instead of a socket.
+	//! Each message or bundle is encoded straight into a record of its own and must fit in SharedMemoryRing::MAX_PACKET_SIZE bytes. Messages are dropped while the ring is full.
+	//! Throws std::runtime_error if the listener isn't running yet.
+	void setupSharedMemory( const std::string &name );
 	
+	//! Sends \a message right away, in a packet of its own.
 	void sendMessage( const Message& message );
 	void sendBundle( const Bundle& bundle );
 	
+	// Batching
+	//! Encodes \a message into the current packet without copying it, starting a new packet when it would grow past the max packet size. Nothing goes out until flush().
+	void queueMessage( const Message& message );
+	//! Sends every queued packet in one go, typically once a frame.
+	void flush();
+	//! Largest packet queueMessage() builds. Defaults to 1472 bytes, what fits an Ethernet frame. A larger message still gets a packet of its own.
+	void setMaxPacketSize( size_t bytes );
+	
+	uint32_t getNumPacketsSent() const;
+	uint32_t getNumMessagesSent() const;
+	
   private:
 	 std::shared_ptr<class OscSender>   oscSender;
 };
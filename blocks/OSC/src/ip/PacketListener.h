@@ -38,6 +38,14 @@ public:
     virtual ~PacketListener() {}
     virtual void ProcessPacket( const char *data, int size, 
 			const IpEndpointName& remoteEndpoint ) = 0;
+
+	// receiveTime is when the datagram arrived, in seconds since 1970.
+	// it comes from the kernel where sockets support it (SO_TIMESTAMPNS
+	// on Linux), otherwise it's the time the socket read the datagram.
+	// listeners that don't need it get the call above.
+    virtual void ProcessPacket( const char *data, int size, 
+			const IpEndpointName& remoteEndpoint, double receiveTime )
+		{ (void)receiveTime; ProcessPacket( data, size, remoteEndpoint ); }
 };
 
 #endif /* INCLUDED_PACKETLISTENER_H */
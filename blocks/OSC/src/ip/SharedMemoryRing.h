@@ -0,0 +1,78 @@
+/*
+	oscpack -- Open Sound Control packet manipulation library
+	http://www.audiomulch.com/~rossb/oscpack
+
+	Copyright (c) 2004-2005 Ross Bencina <rossb@audiomulch.com>
+
+	Permission is hereby granted, free of charge, to any person obtaining
+	a copy of this software and associated documentation files
+	(the "Software"), to deal in the Software without restriction,
+	including without limitation the rights to use, copy, modify, merge,
+	publish, distribute, sublicense, and/or sell copies of the Software,
+	and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be
+	included in all copies or substantial portions of the Software.
+
+	Any person wishing to distribute modifications to the Software is
+	requested to send the modifications to the original developer so that
+	they can be incorporated into the canonical version.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+	MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+	ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+	CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+	WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#ifndef INCLUDED_SHAREDMEMORYRING_H
+#define INCLUDED_SHAREDMEMORYRING_H
+
+
+// A single producer, single consumer ring of fixed size records in named
+// shared memory, for passing packets between two processes on the same host
+// without going through the network stack. Packets are written into and read
+// out of the mapping in place.
+//
+// The reader creates the region and the writer attaches to it. A restarted
+// reader with the same capacity takes over the old region, skipping what's
+// left in it, so an attached writer carries on. With a different capacity
+// the region is replaced and writers have to attach again. On Windows the
+// capacity can't change while a writer holds the region. Construction throws std::runtime_error if the
+// region can't be created or, for a writer, doesn't exist yet.
+
+class SharedMemoryRing{
+    class Implementation;
+    Implementation *impl_;
+
+public:
+    enum { RECORD_SIZE = 1024 };
+    enum { MAX_PACKET_SIZE = RECORD_SIZE - 16 }; // less the record header
+
+    // capacity is in records and rounded up to a power of two, the writer's is ignored
+    SharedMemoryRing( const char *name, int capacity, bool create );
+    ~SharedMemoryRing();
+
+    // writer. BeginWrite returns room for MAX_PACKET_SIZE bytes, or 0 when
+    // the ring is full and the packet has to be dropped. EndWrite publishes
+    // the first size bytes stamped with the current time, Notify wakes the
+    // reader if it's waiting. Call it once after a batch of writes.
+    char *BeginWrite();
+    void EndWrite( int size );
+    void Notify();
+
+    // reader. BeginRead returns the oldest packet, or 0 when the ring is
+    // empty. It stays valid until EndRead.
+    const char *BeginRead( int *size, double *writeTime );
+    void EndRead();
+    // blocks until a packet is written, Notify is called or timeoutMs passes
+    void Wait( int timeoutMs );
+
+    // packets the writer dropped because the ring was full
+    unsigned long DroppedPacketCount() const;
+};
+
+
+#endif /* INCLUDED_SHAREDMEMORYRING_H */
@@ -101,12 +101,26 @@ public:
 	void Send( const char *data, int size );
     void SendTo( const IpEndpointName& remoteEndpoint, const char *data, int size );
 
+	// Send count datagrams to the connected endpoint, with as few
+	// system calls as the platform allows (sendmmsg on Linux).
+	void SendMultiple( const char * const *data, const int *sizes, int count );
+
 
 	// Bind a local endpoint to receive incoming data. Endpoint
 	// can be 'any' for the system to choose an endpoint
 	void Bind( const IpEndpointName& localEndpoint );
 	bool IsBound() const;
 
+	// Size of the kernel buffer holding datagrams until they are
+	// read. Bursts that overflow it are dropped by the kernel. The
+	// kernel may round or clamp the requested size.
+	void SetReceiveBufferSize( int bytes );
+	int ReceiveBufferSize() const;
+
+	// number of datagrams the kernel dropped because the receive
+	// buffer was full. only counted on Linux, always 0 elsewhere.
+	unsigned long DroppedPacketCount() const;
+
 	int ReceiveFrom( IpEndpointName& remoteEndpoint, char *data, int size );
 };
 
@@ -152,6 +166,11 @@ public:
 	void RunUntilSigInt() { mux_.RunUntilSigInt(); }
     void Break() { mux_.Break(); }
     void AsynchronousBreak() { mux_.AsynchronousBreak(); }
+
+	// timers run on the thread that calls Run(), between packets.
+	// attach before Run(), the multiplexer doesn't lock its lists.
+	void AttachPeriodicTimerListener( int periodMilliseconds, TimerListener *listener )
+		{ mux_.AttachPeriodicTimerListener( periodMilliseconds, listener ); }
 };
 
 
@@ -0,0 +1,350 @@
+/*
+	oscpack -- Open Sound Control packet manipulation library
+	http://www.audiomulch.com/~rossb/oscpack
+
+	Copyright (c) 2004-2005 Ross Bencina <rossb@audiomulch.com>
+
+	Permission is hereby granted, free of charge, to any person obtaining
+	a copy of this software and associated documentation files
+	(the "Software"), to deal in the Software without restriction,
+	including without limitation the rights to use, copy, modify, merge,
+	publish, distribute, sublicense, and/or sell copies of the Software,
+	and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be
+	included in all copies or substantial portions of the Software.
+
+	Any person wishing to distribute modifications to the Software is
+	requested to send the modifications to the original developer so that
+	they can be incorporated into the canonical version.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+	MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+	ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+	CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+	WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include "ip/SharedMemoryRing.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <limits.h>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include <atomic>
+#include <string>
+#include <stdexcept>
+#include <assert.h>
+
+
+namespace{
+
+const unsigned int RING_MAGIC = 0x4F534352; // 'OSCR'
+
+// the layout both processes agree on. the indices are free running and each
+// sits on its own cache line so the writer and reader don't contend.
+struct RingHeader{
+    std::atomic<unsigned int> magic; // set last, once the rest is initialised
+    unsigned int recordSize;
+    unsigned int capacity;
+    char pad0[52];
+
+    std::atomic<unsigned int> head; // next record to write, only the writer changes it
+    char pad1[60];
+
+    std::atomic<unsigned int> tail; // next record to read, only the reader changes it
+    char pad2[60];
+
+    std::atomic<unsigned int> sequence; // bumped by Notify, the futex word
+    std::atomic<unsigned int> waiting; // set while the reader sleeps
+    std::atomic<unsigned int> dropped;
+    char pad3[52];
+};
+
+struct RingRecord{
+    unsigned int size;
+    unsigned int reserved;
+    double writeTime;
+    char data[ SharedMemoryRing::MAX_PACKET_SIZE ];
+};
+
+double GetCurrentTimeSeconds()
+{
+    struct timeval t;
+    gettimeofday( &t, 0 );
+    return (double)t.tv_sec + (double)t.tv_usec * 1e-6;
+}
+
+} // namespace
+
+
+class SharedMemoryRing::Implementation{
+    std::string name_;
+    int fd_;
+    void *mapping_;
+    size_t mappingSize_;
+
+    RingHeader *header_;
+    RingRecord *records_;
+    unsigned int mask_;
+
+    void Map( size_t size )
+    {
+        mapping_ = mmap( 0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0 );
+        if( mapping_ == MAP_FAILED ){
+            mapping_ = 0;
+            throw std::runtime_error( "unable to map shared memory\n" );
+        }
+        mappingSize_ = size;
+        header_ = (RingHeader*)mapping_;
+        records_ = (RingRecord*)( header_ + 1 );
+    }
+
+    void Unmap()
+    {
+        if( mapping_ )
+            munmap( mapping_, mappingSize_ );
+        mapping_ = 0;
+    }
+
+    // attaches to a region left by an earlier reader if it has the same
+    // layout, so that a writer which is still attached keeps working
+    bool Reattach( unsigned int capacity )
+    {
+        struct stat info;
+        if( fstat( fd_, &info ) != 0 || (size_t)info.st_size != sizeof(RingHeader) + capacity * sizeof(RingRecord) )
+            return false;
+
+        Map( (size_t)info.st_size );
+        if( header_->magic.load( std::memory_order_acquire ) == RING_MAGIC
+                && header_->recordSize == sizeof(RingRecord) && header_->capacity == capacity ){
+            // whatever the last reader left behind is stale
+            header_->tail.store( header_->head.load( std::memory_order_acquire ), std::memory_order_release );
+            return true;
+        }
+
+        Unmap();
+        return false;
+    }
+
+    void Create( unsigned int capacity )
+    {
+        fd_ = shm_open( name_.c_str(), O_RDWR | O_CREAT, 0660 );
+        if( fd_ == -1 )
+            throw std::runtime_error( "unable to create shared memory\n" );
+        if( Reattach( capacity ) )
+            return;
+
+        // a different layout, start over with a fresh region
+        close( fd_ );
+        shm_unlink( name_.c_str() );
+        fd_ = shm_open( name_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0660 );
+        size_t size = sizeof(RingHeader) + capacity * sizeof(RingRecord);
+        if( fd_ == -1 || ftruncate( fd_, (off_t)size ) != 0 )
+            throw std::runtime_error( "unable to create shared memory\n" );
+
+        Map( size );
+        header_->recordSize = sizeof(RingRecord);
+        header_->capacity = capacity;
+        header_->head.store( 0 );
+        header_->tail.store( 0 );
+        header_->sequence.store( 0 );
+        header_->waiting.store( 0 );
+        header_->dropped.store( 0 );
+        header_->magic.store( RING_MAGIC, std::memory_order_release );
+    }
+
+    void Open()
+    {
+        fd_ = shm_open( name_.c_str(), O_RDWR, 0 );
+        if( fd_ == -1 )
+            throw std::runtime_error( "shared memory not found, is the reader running?\n" );
+
+        struct stat info;
+        if( fstat( fd_, &info ) != 0 || (size_t)info.st_size < sizeof(RingHeader) )
+            throw std::runtime_error( "shared memory not initialised\n" );
+
+        Map( (size_t)info.st_size );
+        if( header_->magic.load( std::memory_order_acquire ) != RING_MAGIC
+                || header_->recordSize != sizeof(RingRecord)
+                || sizeof(RingHeader) + header_->capacity * sizeof(RingRecord) > mappingSize_ )
+            throw std::runtime_error( "shared memory has an unexpected layout\n" );
+    }
+
+public:
+    Implementation( const char *name, int capacity, bool create )
+        : fd_( -1 )
+        , mapping_( 0 )
+        , mappingSize_( 0 )
+        , header_( 0 )
+        , records_( 0 )
+    {
+        assert( sizeof(RingHeader) == 256 && sizeof(RingRecord) == RECORD_SIZE );
+
+        // shm_open wants a single leading slash
+        name_ = std::string( "/" ) + name;
+
+        try{
+            if( create ){
+                unsigned int rounded = 1;
+                while( rounded < (unsigned int)capacity )
+                    rounded <<= 1;
+                Create( rounded );
+            }else{
+                Open();
+            }
+        }catch( ... ){
+            Unmap();
+            if( fd_ != -1 )
+                close( fd_ );
+            throw;
+        }
+
+        mask_ = header_->capacity - 1;
+    }
+
+    ~Implementation()
+    {
+        // the region stays behind so a writer can outlive a restarting reader
+        Unmap();
+        close( fd_ );
+    }
+
+    char *BeginWrite()
+    {
+        unsigned int head = header_->head.load( std::memory_order_relaxed );
+        if( head - header_->tail.load( std::memory_order_acquire ) > mask_ ){
+            header_->dropped.fetch_add( 1, std::memory_order_relaxed );
+            return 0;
+        }
+        return records_[ head & mask_ ].data;
+    }
+
+    void EndWrite( int size )
+    {
+        assert( size >= 0 && size <= MAX_PACKET_SIZE );
+        unsigned int head = header_->head.load( std::memory_order_relaxed );
+        RingRecord &record = records_[ head & mask_ ];
+        record.size = (unsigned int)size;
+        record.writeTime = GetCurrentTimeSeconds();
+        header_->head.store( head + 1, std::memory_order_release );
+    }
+
+    void Notify()
+    {
+        // pairs with Wait, either the reader sees the new head or we see it waiting
+        header_->sequence.fetch_add( 1, std::memory_order_seq_cst );
+        if( header_->waiting.load( std::memory_order_seq_cst ) ){
+#if defined(__linux__)
+            // not FUTEX_PRIVATE_FLAG, the word is shared between processes
+            syscall( SYS_futex, &header_->sequence, FUTEX_WAKE, INT_MAX, 0, 0, 0 );
+#endif
+        }
+    }
+
+    const char *BeginRead( int *size, double *writeTime )
+    {
+        unsigned int tail = header_->tail.load( std::memory_order_relaxed );
+        if( tail == header_->head.load( std::memory_order_acquire ) )
+            return 0;
+
+        const RingRecord &record = records_[ tail & mask_ ];
+        // the other process could have written anything, keep the parser inside the record
+        *size = record.size <= MAX_PACKET_SIZE ? (int)record.size : MAX_PACKET_SIZE;
+        *writeTime = record.writeTime;
+        return record.data;
+    }
+
+    void EndRead()
+    {
+        header_->tail.fetch_add( 1, std::memory_order_release );
+    }
+
+    void Wait( int timeoutMs )
+    {
+        unsigned int sequence = header_->sequence.load( std::memory_order_seq_cst );
+        header_->waiting.store( 1, std::memory_order_seq_cst );
+
+        if( header_->tail.load( std::memory_order_relaxed ) == header_->head.load( std::memory_order_seq_cst ) ){
+#if defined(__linux__)
+            // returns straight away if Notify bumped the sequence in the meantime
+            struct timespec timeout;
+            timeout.tv_sec = timeoutMs / 1000;
+            timeout.tv_nsec = (long)( timeoutMs % 1000 ) * 1000000;
+            syscall( SYS_futex, &header_->sequence, FUTEX_WAIT, sequence, &timeout, 0, 0 );
+#else
+            // no portable cross process wait without a lock, poll instead
+            double end = GetCurrentTimeSeconds() + timeoutMs * .001;
+            while( header_->sequence.load( std::memory_order_seq_cst ) == sequence
+                    && header_->tail.load( std::memory_order_relaxed ) == header_->head.load( std::memory_order_acquire )
+                    && GetCurrentTimeSeconds() < end )
+                usleep( 100 );
+#endif
+        }
+
+        header_->waiting.store( 0, std::memory_order_relaxed );
+    }
+
+    unsigned long DroppedPacketCount() const
+    {
+        return header_->dropped.load( std::memory_order_relaxed );
+    }
+};
+
+
+SharedMemoryRing::SharedMemoryRing( const char *name, int capacity, bool create )
+{
+    impl_ = new Implementation( name, capacity, create );
+}
+
+SharedMemoryRing::~SharedMemoryRing()
+{
+    delete impl_;
+}
+
+char *SharedMemoryRing::BeginWrite()
+{
+    return impl_->BeginWrite();
+}
+
+void SharedMemoryRing::EndWrite( int size )
+{
+    impl_->EndWrite( size );
+}
+
+void SharedMemoryRing::Notify()
+{
+    impl_->Notify();
+}
+
+const char *SharedMemoryRing::BeginRead( int *size, double *writeTime )
+{
+    return impl_->BeginRead( size, writeTime );
+}
+
+void SharedMemoryRing::EndRead()
+{
+    impl_->EndRead();
+}
+
+void SharedMemoryRing::Wait( int timeoutMs )
+{
+    impl_->Wait( timeoutMs );
+}
+
+unsigned long SharedMemoryRing::DroppedPacketCount() const
+{
+    return impl_->DroppedPacketCount();
+}
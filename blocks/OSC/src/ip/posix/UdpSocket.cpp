@@ -48,6 +48,10 @@
 #include <sys/time.h>
 #include <netinet/in.h> // for sockaddr_in
 
+#if defined(__linux__)
+#include <sys/epoll.h>
+#endif
+
 #include "ip/PacketListener.h"
 #include "ip/TimerListener.h"
 
@@ -93,6 +97,7 @@ class UdpSocket::Implementation{
 	bool isConnected_;
 
 	int socket_;
+	volatile unsigned long droppedPackets_;
 	struct sockaddr_in connectedAddr_;
 	struct sockaddr_in sendToAddr_;
 
@@ -102,6 +107,7 @@ public:
 		: isBound_( false )
 		, isConnected_( false )
 		, socket_( -1 )
+		, droppedPackets_( 0 )
 	{
 		if( (socket_ = socket( AF_INET, SOCK_DGRAM, 0 )) == -1 ){
             throw std::runtime_error("unable to create udp socket\n");
@@ -184,6 +190,36 @@ public:
         send( socket_, data, size, 0 );
 	}
 
+	void SendMultiple( const char * const *data, const int *sizes, int count )
+	{
+		assert( isConnected_ );
+
+#if defined(__linux__)
+		const int BATCH_SIZE = 32;
+		struct mmsghdr messages[ BATCH_SIZE ];
+		struct iovec iovecs[ BATCH_SIZE ];
+
+		int first = 0;
+		while( first < count ){
+			int batchCount = std::min( count - first, BATCH_SIZE );
+			for( int i = 0; i < batchCount; ++i ){
+				iovecs[i].iov_base = (void*)data[ first + i ];
+				iovecs[i].iov_len = sizes[ first + i ];
+				memset( &messages[i], 0, sizeof(messages[i]) );
+				messages[i].msg_hdr.msg_iov = &iovecs[i];
+				messages[i].msg_hdr.msg_iovlen = 1;
+			}
+
+			// like Send(), a datagram that fails is skipped rather than retried
+			int sent = sendmmsg( socket_, messages, batchCount, 0 );
+			first += ( sent > 0 ) ? sent : 1;
+		}
+#else
+		for( int i = 0; i < count; ++i )
+			send( socket_, data[i], sizes[i], 0 );
+#endif
+	}
+
     void SendTo( const IpEndpointName& remoteEndpoint, const char *data, int size )
 	{
 		sendToAddr_.sin_addr.s_addr = htonl( remoteEndpoint.address );
@@ -201,11 +237,38 @@ public:
             throw std::runtime_error("unable to bind udp socket\n");
         }
 
+		int enable = 1;
+#if defined(SO_RXQ_OVFL)
+		// have the kernel report its drop count along with each datagram
+		setsockopt( socket_, SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable) );
+#endif
+#if defined(SO_TIMESTAMPNS)
+		// and when each datagram arrived
+		setsockopt( socket_, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable) );
+#endif
+		(void)enable;
+
 		isBound_ = true;
 	}
 
 	bool IsBound() const { return isBound_; }
 
+	void SetReceiveBufferSize( int bytes )
+	{
+		setsockopt( socket_, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(bytes) );
+	}
+
+	int ReceiveBufferSize() const
+	{
+		int bytes = 0;
+		socklen_t length = sizeof(bytes);
+		getsockopt( socket_, SOL_SOCKET, SO_RCVBUF, &bytes, &length );
+		return bytes;
+	}
+
+	unsigned long DroppedPacketCount() const { return droppedPackets_; }
+	void SetDroppedPacketCount( unsigned long count ) { droppedPackets_ = count; }
+
     int ReceiveFrom( IpEndpointName& remoteEndpoint, char *data, int size )
 	{
 		assert( isBound_ );
@@ -257,6 +320,11 @@ void UdpSocket::SendTo( const IpEndpointName& remoteEndpoint, const char *data,
 	impl_->SendTo( remoteEndpoint, data, size );
 }
 
+void UdpSocket::SendMultiple( const char * const *data, const int *sizes, int count )
+{
+	impl_->SendMultiple( data, sizes, count );
+}
+
 void UdpSocket::Bind( const IpEndpointName& localEndpoint )
 {
 	impl_->Bind( localEndpoint );
@@ -272,6 +340,21 @@ int UdpSocket::ReceiveFrom( IpEndpointName& remoteEndpoint, char *data, int size
 	return impl_->ReceiveFrom( remoteEndpoint, data, size );
 }
 
+void UdpSocket::SetReceiveBufferSize( int bytes )
+{
+	impl_->SetReceiveBufferSize( bytes );
+}
+
+int UdpSocket::ReceiveBufferSize() const
+{
+	return impl_->ReceiveBufferSize();
+}
+
+unsigned long UdpSocket::DroppedPacketCount() const
+{
+	return impl_->DroppedPacketCount();
+}
+
 
 struct AttachedTimerListener{
 	AttachedTimerListener( int id, int p, TimerListener *tl )
@@ -284,10 +367,12 @@ struct AttachedTimerListener{
 };
 
 
-static bool CompareScheduledTimerCalls( 
-		const std::pair< double, AttachedTimerListener > & lhs, const std::pair< double, AttachedTimerListener > & rhs )
+typedef std::pair< double, AttachedTimerListener > ScheduledTimerCall; // expiry time ms, listener
+
+// orders the timer heap so the earliest expiry is at the front
+static bool LaterScheduledTimerCall( const ScheduledTimerCall& lhs, const ScheduledTimerCall& rhs )
 {
-	return lhs.first < rhs.first;
+	return lhs.first > rhs.first;
 }
 
 
@@ -302,6 +387,12 @@ extern "C" /*static*/ void InterruptSignalHandler( int );
 
 
 class SocketReceiveMultiplexer::Implementation{
+	// the largest datagram UDP can carry
+	static const int MAX_DATAGRAM_SIZE = 65536;
+	static const int BATCH_SIZE = 16;
+	static const int MAX_BATCHES_PER_WAKEUP = 8;
+	static const int CONTROL_SIZE = 128; // room for the drop count and timestamp messages
+
 	std::vector< std::pair< PacketListener*, UdpSocket* > > socketListeners_;
 	std::vector< AttachedTimerListener > timerListeners_;
 
@@ -317,63 +408,157 @@ class SocketReceiveMultiplexer::Implementation{
 		return ((double)t.tv_sec*1000.) + ((double)t.tv_usec / 1000.);
 	}
 
-public:
-    Implementation()
+	// milliseconds until the next timer is due, or -1 to wait indefinitely
+	double TimeoutMs( const std::vector< ScheduledTimerCall >& timerQueue ) const
 	{
-		if( pipe(breakPipe_) != 0 )
-			throw std::runtime_error( "creation of asynchronous break pipes failed\n" );
+		if( timerQueue.empty() )
+			return -1.;
+		double timeoutMs = timerQueue.front().first - GetCurrentTimeMs();
+		return ( timeoutMs < 0 ) ? 0. : timeoutMs;
 	}
 
-    ~Implementation()
+	void RunExpiredTimers( std::vector< ScheduledTimerCall >& timerQueue )
 	{
-		close( breakPipe_[0] );
-		close( breakPipe_[1] );
-	}
+		double currentTimeMs = GetCurrentTimeMs();
 
-    void AttachSocketListener( UdpSocket *socket, PacketListener *listener )
-	{
-		assert( std::find( socketListeners_.begin(), socketListeners_.end(), std::make_pair(listener, socket) ) == socketListeners_.end() );
-		// we don't check that the same socket has been added multiple times, even though this is an error
-		socketListeners_.push_back( std::make_pair( listener, socket ) );
+		// each timer fires at most once per pass, so a zero period can't starve the sockets
+		size_t count = timerQueue.size();
+		while( count-- > 0 && !timerQueue.empty() && timerQueue.front().first <= currentTimeMs ){
+			std::pop_heap( timerQueue.begin(), timerQueue.end(), LaterScheduledTimerCall );
+			TimerListener *listener = timerQueue.back().second.listener;
+			timerQueue.back().first += timerQueue.back().second.periodMs;
+			std::push_heap( timerQueue.begin(), timerQueue.end(), LaterScheduledTimerCall );
+
+			listener->TimerExpired();
+			if( break_ )
+				break;
+		}
 	}
 
-    void DetachSocketListener( UdpSocket *socket, PacketListener *listener )
+#if defined(__linux__)
+	// Waits on epoll and drains each readable socket with recvmmsg, BATCH_SIZE
+	// datagrams per call, so a burst costs a few syscalls instead of a select()
+	// and a recvfrom() per packet.
+	void RunEpoll( std::vector< ScheduledTimerCall >& timerQueue )
 	{
-		std::vector< std::pair< PacketListener*, UdpSocket* > >::iterator i = 
-				std::find( socketListeners_.begin(), socketListeners_.end(), std::make_pair(listener, socket) );
-		assert( i != socketListeners_.end() );
+		int epollFd = epoll_create( (int)socketListeners_.size() + 1 );
+		if( epollFd < 0 )
+			throw std::runtime_error( "epoll_create failed\n" );
+
+		// the asynchronous break pipe is tagged 0, sockets by their index + 1
+		struct epoll_event event;
+		memset( &event, 0, sizeof(event) );
+		event.events = EPOLLIN;
+		event.data.u32 = 0;
+		epoll_ctl( epollFd, EPOLL_CTL_ADD, breakPipe_[0], &event );
+		for( size_t i = 0; i < socketListeners_.size(); ++i ){
+			event.data.u32 = (uint32_t)i + 1;
+			if( epoll_ctl( epollFd, EPOLL_CTL_ADD, socketListeners_[i].second->impl_->Socket(), &event ) < 0 ){
+				close( epollFd );
+				throw std::runtime_error( "epoll_ctl failed\n" );
+			}
+		}
 
-		socketListeners_.erase( i );
-	}
+		// buffers for one batch, allocated once per Run()
+		std::vector< char > data( BATCH_SIZE * MAX_DATAGRAM_SIZE );
+		std::vector< char > control( BATCH_SIZE * CONTROL_SIZE );
+		struct mmsghdr messages[ BATCH_SIZE ];
+		struct iovec iovecs[ BATCH_SIZE ];
+		struct sockaddr_in fromAddrs[ BATCH_SIZE ];
 
-    void AttachPeriodicTimerListener( int periodMilliseconds, TimerListener *listener )
-	{
-		timerListeners_.push_back( AttachedTimerListener( periodMilliseconds, periodMilliseconds, listener ) );
-	}
+		std::vector< struct epoll_event > events( socketListeners_.size() + 1 );
 
-	void AttachPeriodicTimerListener( int initialDelayMilliseconds, int periodMilliseconds, TimerListener *listener )
-	{
-		timerListeners_.push_back( AttachedTimerListener( initialDelayMilliseconds, periodMilliseconds, listener ) );
-	}
+		while( !break_ ){
+			double timeoutMs = TimeoutMs( timerQueue );
+			int numEvents = epoll_wait( epollFd, &events[0], (int)events.size(),
+					( timeoutMs < 0 ) ? -1 : (int)ceil( timeoutMs ) );
+			if( numEvents < 0 && errno != EINTR ){
+				close( epollFd );
+				throw std::runtime_error( "epoll_wait failed\n" );
+			}
 
-    void DetachPeriodicTimerListener( TimerListener *listener )
-	{
-		std::vector< AttachedTimerListener >::iterator i = timerListeners_.begin();
-		while( i != timerListeners_.end() ){
-			if( i->listener == listener )
+			for( int e = 0; e < numEvents && !break_; ++e ){
+				if( events[e].data.u32 == 0 ){
+					// clear pending data from the asynchronous break pipe
+					char c;
+					read( breakPipe_[0], &c, 1 );
+					continue;
+				}
+
+				PacketListener *listener = socketListeners_[ events[e].data.u32 - 1 ].first;
+				UdpSocket::Implementation *socket = socketListeners_[ events[e].data.u32 - 1 ].second->impl_;
+
+				// drain a few batches, then give timers and other sockets a turn.
+				// epoll is level triggered so anything left wakes us straight away.
+				for( int batch = 0; batch < MAX_BATCHES_PER_WAKEUP && !break_; ++batch ){
+					for( int i = 0; i < BATCH_SIZE; ++i ){
+						iovecs[i].iov_base = &data[ i * MAX_DATAGRAM_SIZE ];
+						iovecs[i].iov_len = MAX_DATAGRAM_SIZE;
+						memset( &messages[i], 0, sizeof(messages[i]) );
+						messages[i].msg_hdr.msg_iov = &iovecs[i];
+						messages[i].msg_hdr.msg_iovlen = 1;
+						messages[i].msg_hdr.msg_name = &fromAddrs[i];
+						messages[i].msg_hdr.msg_namelen = sizeof(fromAddrs[i]);
+						messages[i].msg_hdr.msg_control = &control[ i * CONTROL_SIZE ];
+						messages[i].msg_hdr.msg_controllen = CONTROL_SIZE;
+					}
+
+					int count = recvmmsg( socket->Socket(), messages, BATCH_SIZE, MSG_DONTWAIT, 0 );
+					if( count <= 0 )
+						break;
+					// used for datagrams the kernel didn't timestamp
+					double readTime = GetCurrentTimeMs() * .001;
+
+					for( int i = 0; i < count && !break_; ++i ){
+						double receiveTime = ReadControlMessages( socket, messages[i].msg_hdr );
+						if( receiveTime == 0 )
+							receiveTime = readTime;
+
+						IpEndpointName remoteEndpoint( ntohl( fromAddrs[i].sin_addr.s_addr ), ntohs( fromAddrs[i].sin_port ) );
+						listener->ProcessPacket( (const char*)iovecs[i].iov_base, (int)messages[i].msg_len, remoteEndpoint, receiveTime );
+					}
+
+					if( count < BATCH_SIZE )
+						break;
+				}
+			}
+
+			if( break_ )
 				break;
-			++i;
-		}
 
-		assert( i != timerListeners_.end() );
+			RunExpiredTimers( timerQueue );
+		}
 
-		timerListeners_.erase( i );
+		close( epollFd );
 	}
 
-    void Run()
+	// updates the socket's drop count and returns the kernel's receive
+	// time in seconds since 1970, or 0 if the datagram doesn't carry one
+	double ReadControlMessages( UdpSocket::Implementation *socket, struct msghdr& header )
 	{
-		break_ = false;
+		double receiveTime = 0;
+		for( struct cmsghdr *cmsg = CMSG_FIRSTHDR( &header ); cmsg; cmsg = CMSG_NXTHDR( &header, cmsg ) ){
+#if defined(SO_RXQ_OVFL)
+			if( cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL ){
+				uint32_t dropped;
+				memcpy( &dropped, CMSG_DATA( cmsg ), sizeof(dropped) );
+				socket->SetDroppedPacketCount( dropped );
+			}
+#endif
+#if defined(SO_TIMESTAMPNS)
+			if( cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS ){
+				struct timespec stamp;
+				memcpy( &stamp, CMSG_DATA( cmsg ), sizeof(stamp) );
+				receiveTime = (double)stamp.tv_sec + (double)stamp.tv_nsec * 1e-9;
+			}
+#endif
+		}
+		return receiveTime;
+	}
+#endif
 
+	void RunSelect( std::vector< ScheduledTimerCall >& timerQueue )
+	{
 		// configure the master fd_set for select()
 
 		fd_set masterfds, tempfds;
@@ -394,19 +579,7 @@ public:
 			FD_SET( i->second->impl_->Socket(), &masterfds );
 		}
 
-
-		// configure the timer queue
-		double currentTimeMs = GetCurrentTimeMs();
-
-		// expiry time ms, listener
-		std::vector< std::pair< double, AttachedTimerListener > > timerQueue_;
-		for( std::vector< AttachedTimerListener >::iterator i = timerListeners_.begin();
-				i != timerListeners_.end(); ++i )
-			timerQueue_.push_back( std::make_pair( currentTimeMs + i->initialDelayMs, *i ) );
-		std::sort( timerQueue_.begin(), timerQueue_.end(), CompareScheduledTimerCalls );
-
-		const int MAX_BUFFER_SIZE = 4098;
-		char *data = new char[ MAX_BUFFER_SIZE ];
+		std::vector< char > data( MAX_DATAGRAM_SIZE );
 		IpEndpointName remoteEndpoint;
 
 		struct timeval timeout;
@@ -415,11 +588,8 @@ public:
 			tempfds = masterfds;
 
 			struct timeval *timeoutPtr = 0;
-			if( !timerQueue_.empty() ){
-				double timeoutMs = timerQueue_.front().first - GetCurrentTimeMs();
-				if( timeoutMs < 0 )
-					timeoutMs = 0;
-			
+			double timeoutMs = TimeoutMs( timerQueue );
+			if( timeoutMs >= 0 ){
 				// 1000000 microseconds in a second
 				timeout.tv_sec = (long)(timeoutMs * .001);
 				timeout.tv_usec = (long)((timeoutMs - (timeout.tv_sec * 1000)) * 1000);
@@ -444,33 +614,93 @@ public:
 
 				if( FD_ISSET( i->second->impl_->Socket(), &tempfds ) ){
 
-					int size = i->second->ReceiveFrom( remoteEndpoint, data, MAX_BUFFER_SIZE );
+					int size = i->second->ReceiveFrom( remoteEndpoint, &data[0], MAX_DATAGRAM_SIZE );
 					if( size > 0 ){
-						i->first->ProcessPacket( data, size, remoteEndpoint );
+						i->first->ProcessPacket( &data[0], size, remoteEndpoint, GetCurrentTimeMs() * .001 );
 						if( break_ )
 							break;
 					}
 				}
 			}
 
-			// execute any expired timers
-			currentTimeMs = GetCurrentTimeMs();
-			bool resort = false;
-			for( std::vector< std::pair< double, AttachedTimerListener > >::iterator i = timerQueue_.begin();
-					i != timerQueue_.end() && i->first <= currentTimeMs; ++i ){
+			if( break_ )
+				break;
 
-				i->second.listener->TimerExpired();
-				if( break_ )
-					break;
+			RunExpiredTimers( timerQueue );
+		}
+	}
 
-				i->first += i->second.periodMs;
-				resort = true;
-			}
-			if( resort )
-				std::sort( timerQueue_.begin(), timerQueue_.end(), CompareScheduledTimerCalls );
+public:
+    Implementation()
+	{
+		if( pipe(breakPipe_) != 0 )
+			throw std::runtime_error( "creation of asynchronous break pipes failed\n" );
+	}
+
+    ~Implementation()
+	{
+		close( breakPipe_[0] );
+		close( breakPipe_[1] );
+	}
+
+    void AttachSocketListener( UdpSocket *socket, PacketListener *listener )
+	{
+		assert( std::find( socketListeners_.begin(), socketListeners_.end(), std::make_pair(listener, socket) ) == socketListeners_.end() );
+		// we don't check that the same socket has been added multiple times, even though this is an error
+		socketListeners_.push_back( std::make_pair( listener, socket ) );
+	}
+
+    void DetachSocketListener( UdpSocket *socket, PacketListener *listener )
+	{
+		std::vector< std::pair< PacketListener*, UdpSocket* > >::iterator i = 
+				std::find( socketListeners_.begin(), socketListeners_.end(), std::make_pair(listener, socket) );
+		assert( i != socketListeners_.end() );
+
+		socketListeners_.erase( i );
+	}
+
+    void AttachPeriodicTimerListener( int periodMilliseconds, TimerListener *listener )
+	{
+		timerListeners_.push_back( AttachedTimerListener( periodMilliseconds, periodMilliseconds, listener ) );
+	}
+
+	void AttachPeriodicTimerListener( int initialDelayMilliseconds, int periodMilliseconds, TimerListener *listener )
+	{
+		timerListeners_.push_back( AttachedTimerListener( initialDelayMilliseconds, periodMilliseconds, listener ) );
+	}
+
+    void DetachPeriodicTimerListener( TimerListener *listener )
+	{
+		std::vector< AttachedTimerListener >::iterator i = timerListeners_.begin();
+		while( i != timerListeners_.end() ){
+			if( i->listener == listener )
+				break;
+			++i;
 		}
 
-		delete [] data;
+		assert( i != timerListeners_.end() );
+
+		timerListeners_.erase( i );
+	}
+
+    void Run()
+	{
+		break_ = false;
+
+		// configure the timer queue
+		double currentTimeMs = GetCurrentTimeMs();
+
+		std::vector< ScheduledTimerCall > timerQueue;
+		for( std::vector< AttachedTimerListener >::iterator i = timerListeners_.begin();
+				i != timerListeners_.end(); ++i )
+			timerQueue.push_back( std::make_pair( currentTimeMs + i->initialDelayMs, *i ) );
+		std::make_heap( timerQueue.begin(), timerQueue.end(), LaterScheduledTimerCall );
+
+#if defined(__linux__)
+		RunEpoll( timerQueue );
+#else
+		RunSelect( timerQueue );
+#endif
 	}
 
     void Break()
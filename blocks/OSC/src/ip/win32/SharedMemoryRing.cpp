@@ -0,0 +1,305 @@
+/*
+	oscpack -- Open Sound Control packet manipulation library
+	http://www.audiomulch.com/~rossb/oscpack
+
+	Copyright (c) 2004-2005 Ross Bencina <rossb@audiomulch.com>
+
+	Permission is hereby granted, free of charge, to any person obtaining
+	a copy of this software and associated documentation files
+	(the "Software"), to deal in the Software without restriction,
+	including without limitation the rights to use, copy, modify, merge,
+	publish, distribute, sublicense, and/or sell copies of the Software,
+	and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be
+	included in all copies or substantial portions of the Software.
+
+	Any person wishing to distribute modifications to the Software is
+	requested to send the modifications to the original developer so that
+	they can be incorporated into the canonical version.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+	MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+	ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+	CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+	WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include "ip/SharedMemoryRing.h"
+
+#include <windows.h>
+
+#include <atomic>
+#include <string>
+#include <stdexcept>
+#include <assert.h>
+
+
+namespace{
+
+const unsigned int RING_MAGIC = 0x4F534352; // 'OSCR'
+
+// the layout both processes agree on. the indices are free running and each
+// sits on its own cache line so the writer and reader don't contend.
+struct RingHeader{
+    std::atomic<unsigned int> magic; // set last, once the rest is initialised
+    unsigned int recordSize;
+    unsigned int capacity;
+    char pad0[52];
+
+    std::atomic<unsigned int> head; // next record to write, only the writer changes it
+    char pad1[60];
+
+    std::atomic<unsigned int> tail; // next record to read, only the reader changes it
+    char pad2[60];
+
+    std::atomic<unsigned int> sequence; // bumped by Notify
+    std::atomic<unsigned int> waiting; // set while the reader sleeps
+    std::atomic<unsigned int> dropped;
+    char pad3[52];
+};
+
+struct RingRecord{
+    unsigned int size;
+    unsigned int reserved;
+    double writeTime;
+    char data[ SharedMemoryRing::MAX_PACKET_SIZE ];
+};
+
+double GetCurrentTimeSeconds()
+{
+    FILETIME fileTime;
+    GetSystemTimeAsFileTime( &fileTime );
+    ULARGE_INTEGER ticks; // 100ns since 1601
+    ticks.LowPart = fileTime.dwLowDateTime;
+    ticks.HighPart = fileTime.dwHighDateTime;
+    return (double)( ticks.QuadPart - 116444736000000000ULL ) * 1e-7;
+}
+
+} // namespace
+
+
+class SharedMemoryRing::Implementation{
+    HANDLE mapping_;
+    HANDLE event_; // auto reset, signalled by Notify
+    void *view_;
+
+    RingHeader *header_;
+    RingRecord *records_;
+    unsigned int mask_;
+
+    void Map()
+    {
+        view_ = MapViewOfFile( mapping_, FILE_MAP_ALL_ACCESS, 0, 0, 0 );
+        if( !view_ )
+            throw std::runtime_error( "unable to map shared memory\n" );
+        header_ = (RingHeader*)view_;
+        records_ = (RingRecord*)( header_ + 1 );
+    }
+
+    void Release()
+    {
+        if( view_ )
+            UnmapViewOfFile( view_ );
+        if( mapping_ )
+            CloseHandle( mapping_ );
+        if( event_ )
+            CloseHandle( event_ );
+    }
+
+    void Create( const std::string& name, unsigned int capacity )
+    {
+        DWORD size = (DWORD)( sizeof(RingHeader) + capacity * sizeof(RingRecord) );
+        mapping_ = CreateFileMappingA( INVALID_HANDLE_VALUE, 0, PAGE_READWRITE, 0, size, name.c_str() );
+        if( !mapping_ )
+            throw std::runtime_error( "unable to create shared memory\n" );
+        bool existed = ( GetLastError() == ERROR_ALREADY_EXISTS );
+        Map();
+
+        if( existed ){
+            // a writer is still holding the last reader's region. it can't be
+            // resized, so it has to match, and whatever is in it is stale
+            if( header_->magic.load( std::memory_order_acquire ) != RING_MAGIC
+                    || header_->recordSize != sizeof(RingRecord) || header_->capacity != capacity )
+                throw std::runtime_error( "shared memory in use with a different capacity\n" );
+            header_->tail.store( header_->head.load( std::memory_order_acquire ), std::memory_order_release );
+            return;
+        }
+
+        header_->recordSize = sizeof(RingRecord);
+        header_->capacity = capacity;
+        header_->head.store( 0 );
+        header_->tail.store( 0 );
+        header_->sequence.store( 0 );
+        header_->waiting.store( 0 );
+        header_->dropped.store( 0 );
+        header_->magic.store( RING_MAGIC, std::memory_order_release );
+    }
+
+    void Open( const std::string& name )
+    {
+        mapping_ = OpenFileMappingA( FILE_MAP_ALL_ACCESS, FALSE, name.c_str() );
+        if( !mapping_ )
+            throw std::runtime_error( "shared memory not found, is the reader running?\n" );
+        Map();
+
+        MEMORY_BASIC_INFORMATION info;
+        VirtualQuery( view_, &info, sizeof(info) );
+        if( header_->magic.load( std::memory_order_acquire ) != RING_MAGIC
+                || header_->recordSize != sizeof(RingRecord)
+                || sizeof(RingHeader) + header_->capacity * sizeof(RingRecord) > info.RegionSize )
+            throw std::runtime_error( "shared memory has an unexpected layout\n" );
+    }
+
+public:
+    Implementation( const char *name, int capacity, bool create )
+        : mapping_( 0 )
+        , event_( 0 )
+        , view_( 0 )
+        , header_( 0 )
+        , records_( 0 )
+    {
+        assert( sizeof(RingHeader) == 256 && sizeof(RingRecord) == RECORD_SIZE );
+
+        // session local, so no special privileges are needed
+        std::string mappingName = std::string( "Local\\" ) + name;
+
+        try{
+            if( create ){
+                unsigned int rounded = 1;
+                while( rounded < (unsigned int)capacity )
+                    rounded <<= 1;
+                Create( mappingName, rounded );
+            }else{
+                Open( mappingName );
+            }
+
+            // opens the existing event if the other side made it first
+            event_ = CreateEventA( 0, FALSE, FALSE, ( mappingName + ".event" ).c_str() );
+            if( !event_ )
+                throw std::runtime_error( "unable to create shared memory event\n" );
+        }catch( ... ){
+            Release();
+            throw;
+        }
+
+        mask_ = header_->capacity - 1;
+    }
+
+    ~Implementation()
+    {
+        // the mapping lives on for as long as either side holds it
+        Release();
+    }
+
+    char *BeginWrite()
+    {
+        unsigned int head = header_->head.load( std::memory_order_relaxed );
+        if( head - header_->tail.load( std::memory_order_acquire ) > mask_ ){
+            header_->dropped.fetch_add( 1, std::memory_order_relaxed );
+            return 0;
+        }
+        return records_[ head & mask_ ].data;
+    }
+
+    void EndWrite( int size )
+    {
+        assert( size >= 0 && size <= MAX_PACKET_SIZE );
+        unsigned int head = header_->head.load( std::memory_order_relaxed );
+        RingRecord &record = records_[ head & mask_ ];
+        record.size = (unsigned int)size;
+        record.writeTime = GetCurrentTimeSeconds();
+        header_->head.store( head + 1, std::memory_order_release );
+    }
+
+    void Notify()
+    {
+        // pairs with Wait, either the reader sees the new head or we see it
+        // waiting. skipping SetEvent otherwise saves a kernel call per batch
+        header_->sequence.fetch_add( 1, std::memory_order_seq_cst );
+        if( header_->waiting.load( std::memory_order_seq_cst ) )
+            SetEvent( event_ );
+    }
+
+    const char *BeginRead( int *size, double *writeTime )
+    {
+        unsigned int tail = header_->tail.load( std::memory_order_relaxed );
+        if( tail == header_->head.load( std::memory_order_acquire ) )
+            return 0;
+
+        const RingRecord &record = records_[ tail & mask_ ];
+        // the other process could have written anything, keep the parser inside the record
+        *size = record.size <= MAX_PACKET_SIZE ? (int)record.size : MAX_PACKET_SIZE;
+        *writeTime = record.writeTime;
+        return record.data;
+    }
+
+    void EndRead()
+    {
+        header_->tail.fetch_add( 1, std::memory_order_release );
+    }
+
+    void Wait( int timeoutMs )
+    {
+        header_->waiting.store( 1, std::memory_order_seq_cst );
+
+        // a SetEvent that races with this check stays signalled, so it isn't lost
+        if( header_->tail.load( std::memory_order_relaxed ) == header_->head.load( std::memory_order_seq_cst ) )
+            WaitForSingleObject( event_, (DWORD)timeoutMs );
+
+        header_->waiting.store( 0, std::memory_order_relaxed );
+    }
+
+    unsigned long DroppedPacketCount() const
+    {
+        return header_->dropped.load( std::memory_order_relaxed );
+    }
+};
+
+
+SharedMemoryRing::SharedMemoryRing( const char *name, int capacity, bool create )
+{
+    impl_ = new Implementation( name, capacity, create );
+}
+
+SharedMemoryRing::~SharedMemoryRing()
+{
+    delete impl_;
+}
+
+char *SharedMemoryRing::BeginWrite()
+{
+    return impl_->BeginWrite();
+}
+
+void SharedMemoryRing::EndWrite( int size )
+{
+    impl_->EndWrite( size );
+}
+
+void SharedMemoryRing::Notify()
+{
+    impl_->Notify();
+}
+
+const char *SharedMemoryRing::BeginRead( int *size, double *writeTime )
+{
+    return impl_->BeginRead( size, writeTime );
+}
+
+void SharedMemoryRing::EndRead()
+{
+    impl_->EndRead();
+}
+
+void SharedMemoryRing::Wait( int timeoutMs )
+{
+    impl_->Wait( timeoutMs );
+}
+
+unsigned long SharedMemoryRing::DroppedPacketCount() const
+{
+    return impl_->DroppedPacketCount();
+}
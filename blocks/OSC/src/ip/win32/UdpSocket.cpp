@@ -198,6 +198,19 @@ public:
 
 	bool IsBound() const { return isBound_; }
 
+	void SetReceiveBufferSize( int bytes )
+	{
+		setsockopt( socket_, SOL_SOCKET, SO_RCVBUF, (const char*)&bytes, sizeof(bytes) );
+	}
+
+	int ReceiveBufferSize() const
+	{
+		int bytes = 0;
+		int length = sizeof(bytes);
+		getsockopt( socket_, SOL_SOCKET, SO_RCVBUF, (char*)&bytes, &length );
+		return bytes;
+	}
+
     int ReceiveFrom( IpEndpointName& remoteEndpoint, char *data, int size )
 	{
 		assert( isBound_ );
@@ -249,6 +262,13 @@ void UdpSocket::SendTo( const IpEndpointName& remoteEndpoint, const char *data,
 	impl_->SendTo( remoteEndpoint, data, size );
 }
 
+void UdpSocket::SendMultiple( const char * const *data, const int *sizes, int count )
+{
+	// no batched send in winsock for datagrams
+	for( int i = 0; i < count; ++i )
+		impl_->Send( data[i], sizes[i] );
+}
+
 void UdpSocket::Bind( const IpEndpointName& localEndpoint )
 {
 	impl_->Bind( localEndpoint );
@@ -264,6 +284,21 @@ int UdpSocket::ReceiveFrom( IpEndpointName& remoteEndpoint, char *data, int size
 	return impl_->ReceiveFrom( remoteEndpoint, data, size );
 }
 
+void UdpSocket::SetReceiveBufferSize( int bytes )
+{
+	impl_->SetReceiveBufferSize( bytes );
+}
+
+int UdpSocket::ReceiveBufferSize() const
+{
+	return impl_->ReceiveBufferSize();
+}
+
+unsigned long UdpSocket::DroppedPacketCount() const
+{
+	return 0;
+}
+
 
 struct AttachedTimerListener{
 	AttachedTimerListener( int id, int p, TimerListener *tl )
@@ -307,6 +342,17 @@ class SocketReceiveMultiplexer::Implementation{
 		return timeGetTime(); // FIXME: bad choice if you want to run for more than 40 days
 	}
 
+	// seconds since 1970, the clock PacketListener receive times use
+	static double GetReceiveTime()
+	{
+		FILETIME fileTime;
+		GetSystemTimeAsFileTime( &fileTime );
+		ULARGE_INTEGER ticks; // 100ns since 1601
+		ticks.LowPart = fileTime.dwLowDateTime;
+		ticks.HighPart = fileTime.dwHighDateTime;
+		return (double)( ticks.QuadPart - 116444736000000000ULL ) * 1e-7;
+	}
+
 public:
     Implementation()
 	{
@@ -390,7 +436,8 @@ public:
 			timerQueue_.push_back( std::make_pair( currentTimeMs + i->initialDelayMs, *i ) );
 		std::sort( timerQueue_.begin(), timerQueue_.end(), CompareScheduledTimerCalls );
 
-		const int MAX_BUFFER_SIZE = 4098;
+		// the largest datagram UDP can carry
+		const int MAX_BUFFER_SIZE = 65536;
 		char *data = new char[ MAX_BUFFER_SIZE ];
 		IpEndpointName remoteEndpoint;
 
@@ -414,7 +461,7 @@ public:
 				for( int i = waitResult - WAIT_OBJECT_0; i < (int)socketListeners_.size(); ++i ){
 					int size = socketListeners_[i].second->ReceiveFrom( remoteEndpoint, data, MAX_BUFFER_SIZE );
 					if( size > 0 ){
-						socketListeners_[i].first->ProcessPacket( data, size, remoteEndpoint );
+						socketListeners_[i].first->ProcessPacket( data, size, remoteEndpoint, GetReceiveTime() );
 						if( break_ )
 							break;
 					}
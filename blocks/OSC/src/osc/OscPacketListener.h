@@ -37,7 +37,14 @@
 namespace osc{
 
 class OscPacketListener : public PacketListener{ 
+	double receiveTime_;
+
 protected:
+	// arrival time of the packet being processed, see PacketListener.
+	// 0 when the socket didn't provide one.
+	double ReceiveTime() const { return receiveTime_; }
+
+
     virtual void ProcessBundle( const osc::ReceivedBundle& b, 
 				const IpEndpointName& remoteEndpoint )
     {
@@ -56,8 +63,25 @@ protected:
 				const IpEndpointName& remoteEndpoint ) = 0;
     
 public:
+	OscPacketListener() : receiveTime_( 0 ) {}
+
+	virtual void ProcessPacket( const char *data, int size, 
+			const IpEndpointName& remoteEndpoint, double receiveTime )
+    {
+        receiveTime_ = receiveTime;
+        ProcessReceivedPacket( data, size, remoteEndpoint );
+    }
+
 	virtual void ProcessPacket( const char *data, int size, 
 			const IpEndpointName& remoteEndpoint )
+    {
+        receiveTime_ = 0;
+        ProcessReceivedPacket( data, size, remoteEndpoint );
+    }
+
+private:
+	void ProcessReceivedPacket( const char *data, int size, 
+			const IpEndpointName& remoteEndpoint )
     {
         osc::ReceivedPacket p( data, size );
         if( p.IsBundle() )
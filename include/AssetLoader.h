@@ -0,0 +1,137 @@
+//
+//  AssetLoader.h
+//  KinectTerrain
+//
+//  Loads textures in the background. Images are decoded on a pool of worker
+//  threads and uploaded on the GL thread through a pixel buffer object as they
+//  come back, a couple per frame. Critical assets can be waited on before the
+//  first frame; everything else shows a 1x1 white placeholder until it lands.
+//  Anything that fails to decode, critical or not, keeps a white placeholder.
+//
+//  Textures loaded with compression enabled are stored as DXT by the driver and
+//  the compressed level is written to the cache directory, so later launches
+//  skip decoding and upload the blocks directly. Cube maps are cached the same
+//  way as a single container holding every face and mip level. Texture array
+//  layers are resized to the array's size on the workers, compressed to DXT1 on
+//  upload when asked, and cached like cube maps as one container of every layer.
+//
+
+#pragma once
+
+#include "cinder/gl/gl.h"
+#include "cinder/gl/Texture.h"
+#include "cinder/gl/Vbo.h"
+#include "cinder/Surface.h"
+#include "cinder/DataSource.h"
+#include "cinder/Filesystem.h"
+#include "cinder/Thread.h"
+#include "CubeMap.h"
+#include "TextureArray.h"
+#include <deque>
+#include <vector>
+
+class AssetLoader {
+  public:
+	AssetLoader();
+	~AssetLoader();
+
+	// numThreads of 0 uses one fewer than the number of cores
+	void		setup( const ci::fs::path &cacheDirectory, int numThreads = 0 );
+	// Stops the workers, anything not yet uploaded is dropped
+	void		shutdown();
+
+	// target must outlive the loader. Format's wrap, filter and mipmapping are honored.
+	void		loadTexture( ci::gl::Texture *target, ci::DataSourceRef source, bool isCritical,
+							 bool compress = false, const ci::gl::Texture::Format &format = ci::gl::Texture::Format() );
+	// Faces in CubeMap's constructor order: +x, +y, +z, -x, -y, -z
+	void		loadCubeMap( CubeMap *target, ci::DataSourceRef faces[6], GLsizei faceSize, bool isCritical, const CubeMap::Format &format = CubeMap::Format() );
+	// Layers in array order, each resized to width x height
+	void		loadTextureArray( TextureArray *target, const std::vector<ci::DataSourceRef> &layers, int width, int height, bool isCritical,
+								  bool compress = false );
+
+	// GL thread. Uploads at most maxUploads finished images.
+	void		update( int maxUploads = 2 );
+	// GL thread. Blocks, uploading as images arrive, until every critical asset is in place.
+	void		finishCritical();
+	bool		isFinished(){	return mNumPending == 0;	};
+
+  private:
+	struct Job {
+		int						mTexture;		// Index into mTextures, or -1
+		int						mCube;			// Index into mCubes, or -1
+		int						mArray;			// Index into mArrays, or -1
+		int						mFace;			// Cube face or array layer
+		ci::Vec2i				mSize;			// Array layer size, copied like mCompress
+		bool					mCompress;		// Copied so workers never touch mTextures
+		ci::DataSourceRef		mSource;
+	};
+
+	struct Result {
+		Job						mJob;
+		ci::Surface8u			mSurface;		// Decoded pixels, tightly packed RGB or RGBA
+		std::vector<uint8_t>	mCompressed;	// Cached DXT level 0, when the cache hit
+		GLenum					mCompressedFormat;
+		int						mWidth, mHeight;
+		std::string				mCacheKey;
+	};
+
+	struct PendingTexture {
+		ci::gl::Texture			*mTarget;
+		ci::gl::Texture::Format	mFormat;
+		bool					mIsCritical;
+		bool					mCompress;
+		std::string				mName;			// For ResourceRegistry
+	};
+
+	struct PendingCube {
+		CubeMap					*mTarget;
+		CubeMap::Format			mFormat;
+		std::string				mCacheKey;
+		ci::Surface8u			mFaces[6];
+		GLsizei					mFaceSize;
+		int						mNumFaces;
+		bool					mIsCritical;
+	};
+
+	struct PendingArray {
+		TextureArray				*mTarget;
+		std::string					mCacheKey;
+		std::vector<ci::Surface8u>	mLayers;
+		int							mWidth, mHeight;
+		int							mNumLayers;		// Layers back so far
+		bool						mIsCritical;
+		bool						mCompress;
+	};
+
+	void		workerThread();
+	void		decode( Result &result );
+	bool		readCache( Result &result );
+	void		writeCache( const std::string &key, GLuint texture, int width, int height );
+	void		upload( Result &result );
+	void		uploadCube( Result &result );
+	void		uploadArray( Result &result );
+	void		uploadTexture( Result &result );
+	bool		popResult( Result *result );
+
+	std::vector<PendingTexture>		mTextures;
+	std::vector<PendingCube>		mCubes;
+	std::vector<PendingArray>		mArrays;
+	int								mNumPending;
+	int								mNumCriticalPending;
+
+	std::vector<std::shared_ptr<std::thread> >	mWorkers;
+	std::deque<Job>					mJobs;
+	std::mutex						mJobsMutex;
+	std::condition_variable			mJobsCondition;
+	std::deque<Result>				mResults;
+	std::mutex						mResultsMutex;
+	std::condition_variable			mResultsCondition;
+	bool							mIsRunning;
+
+	ci::fs::path					mCacheDirectory;
+	bool							mIsCacheAvailable;
+	bool							mIsCompressionSupported;
+	bool							mIsPboSupported;
+	ci::gl::Vbo						mPbo;
+	ci::gl::Texture					mPlaceholder;
+};
@@ -0,0 +1,51 @@
+//
+//  Benchmark.h
+//  KinectTerrain
+//
+//  Deterministic benchmark mode. Enabled from the command line:
+//    --benchmark <frames>   run a fixed number of frames and quit
+//    --seed <n>             RNG seed (default 1)
+//    --capture <dir>        write PNG captures of both views into dir
+//    --capture-every <n>    capture interval in frames (default: last frame only)
+//  Head input comes from a scripted trajectory instead of OSC, and simulation
+//  time advances by a fixed step, so two runs produce the same images.
+//
+
+#pragma once
+
+#include "cinder/Vector.h"
+#include "cinder/Filesystem.h"
+#include <string>
+#include <vector>
+
+class Benchmark {
+  public:
+	Benchmark();
+
+	void		parseArgs( const std::vector<std::string> &args );
+	bool		isEnabled(){			return mIsEnabled;		};
+	uint32_t	getSeed(){				return mSeed;			};
+	float		getTimeStep(){			return mTimeStep;		};
+	int			getFrame(){				return mFrame;			};
+	bool		isFinished(){			return mFrame >= mNumFrames; };
+
+	// Scripted head position in room units for the current frame
+	ci::Vec3f	getHeadPosition();
+	bool		shouldCapture();
+	ci::fs::path getCapturePath( int view );
+
+	void		beginFrame();
+	void		endFrame();
+	void		writeResults( const ci::fs::path &path );
+
+	bool				mIsEnabled;
+	int					mNumFrames;
+	int					mFrame;
+	uint32_t			mSeed;
+	float				mTimeStep;
+	ci::fs::path		mCaptureDir;
+	int					mCaptureEvery;
+
+	double				mFrameStart;
+	std::vector<double>	mFrameTimes;		// Milliseconds per frame, GPU work included
+};
@@ -6,22 +6,58 @@
  *  Copyright 2009 The Barbarian Group. All rights reserved.
  *
  */
- 
+
+#pragma once
+
 #include "cinder/Surface.h"
 #include "cinder/gl/gl.h"
 #include "cinder/ImageIo.h"
 #include "cinder/gl/Texture.h"
+#include "cinder/Filesystem.h"
 
+// Immutable cube map with a full mip chain and seamless filtering. Copies share
+// the same GL texture, which is deleted with the last copy.
 class CubeMap
 {
-	unsigned int textureObject;	
 public:
-	//this should be overloaded or generalized to allow different types of texture inputs
+	struct Format {
+		Format() : mMipmap( true ), mPrefilter( false ), mCompress( false ) {}
+		bool	mMipmap;		// Full mip chain, sampled trilinearly
+		bool	mPrefilter;		// Blur each level by a cone that widens with roughness instead of a plain box filter
+		bool	mCompress;		// Store as DXT1 when EXT_texture_compression_s3tc is available
+	};
+
 	CubeMap();
-	CubeMap( GLsizei texWidth, GLsizei texHeight, const ci::Surface8u &pos_x, const ci::Surface8u &pos_y, const ci::Surface8u &pos_z, const ci::Surface8u &neg_x, const ci::Surface8u &neg_y, const ci::Surface8u &neg_z );
+	// Faces are tightly packed RGB and square, texHeight must match texWidth
+	CubeMap( GLsizei texWidth, GLsizei texHeight, const ci::Surface8u &pos_x, const ci::Surface8u &pos_y, const ci::Surface8u &pos_z, const ci::Surface8u &neg_x, const ci::Surface8u &neg_y, const ci::Surface8u &neg_z, const Format &format = Format() );
+
+	// Loads a container written by write(), returns an empty CubeMap if it's missing or unusable
+	static CubeMap	load( const ci::fs::path &path );
+	// Saves every level of every face, already compressed if the texture is
+	bool			write( const ci::fs::path &path );
+
 	void bind();
 	void bindMulti( int loc );
 	void unbind();
 	static void enableFixedMapping();
 	static void disableFixedMapping();
-};
\ No newline at end of file
+
+	GLuint	getId() const {			return mObj ? mObj->mId : 0;		}
+	GLsizei	getSize() const {		return mObj ? mObj->mSize : 0;		}
+	int		getNumLevels() const {	return mObj ? mObj->mNumLevels : 0;	}
+
+private:
+	struct Obj {
+		Obj() : mId( 0 ), mSize( 0 ), mNumLevels( 0 ), mInternalFormat( 0 ) {}
+		~Obj();
+
+		GLuint	mId;
+		GLsizei	mSize;
+		int		mNumLevels;
+		GLenum	mInternalFormat;
+	};
+
+	void	allocate( GLsizei size, int numLevels, GLenum internalFormat );
+
+	std::shared_ptr<Obj>	mObj;
+};
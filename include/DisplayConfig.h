@@ -0,0 +1,54 @@
+//
+//  DisplayConfig.h
+//  KinectTerrain
+//
+//  A set of physical display walls. Each wall is a window onto the room defined by
+//  three world space corners, and is drawn into a normalized viewport of one of the
+//  app's windows with its own off-axis HeadCam.
+//
+//  Configs can be loaded from JSON:
+//  { "walls": [ { "topLeft": [x,y,z], "bottomLeft": [x,y,z], "bottomRight": [x,y,z],
+//                 "viewport": [x1,y1,x2,y2], "window": 0, "defaultEye": [x,y,z] } ] }
+//
+
+#pragma once
+
+#include "cinder/Vector.h"
+#include "cinder/Rect.h"
+#include "cinder/Area.h"
+#include "cinder/Filesystem.h"
+#include "HeadCam.h"
+#include <vector>
+
+struct DisplayWall {
+	ci::Vec3f	getNormal() const;
+	// mViewport in window pixels, origin top left, for copyWindowSurface()
+	ci::Area	getWindowArea( const ci::Vec2i &windowSize ) const;
+	// The same in GL's viewport coordinates, origin bottom left, for gl::setViewport()
+	ci::Area	getViewportArea( const ci::Vec2i &windowSize ) const;
+
+	ci::Vec3f	mTopLeft, mBottomLeft, mBottomRight;
+	ci::Rectf	mViewport;			// Normalized to the window size, origin top left like window coordinates
+	int			mWindow;			// Index of the app window this wall is drawn into
+	ci::Vec3f	mDefaultEye;		// Eye used when the head is behind the wall's plane
+	HeadCam		mCam;
+};
+
+class DisplayConfig {
+  public:
+	DisplayConfig();
+	// The original two screens meeting at 90 degrees on the room's -x,+z corner
+	void			setupDefault( const ci::Vec3f &roomSize, float aspectRatio );
+	bool			load( const ci::fs::path &path, float aspectRatio );
+
+	// Places every wall's eye at the head, or at its default if the head is behind it
+	void			setHeadPosition( const ci::Vec3f &headPos );
+	// Recomputes every wall's off-axis projection
+	void			update( float farClip );
+
+	size_t			getNumWalls(){		return mWalls.size();	};
+	DisplayWall&	getWall( size_t i ){	return mWalls[i];		};
+	int				getNumWindows();
+
+	std::vector<DisplayWall>	mWalls;
+};
@@ -0,0 +1,57 @@
+//
+//  DynamicResolution.h
+//  KinectTerrain
+//
+//  Renders each view into an offscreen target whose resolution follows the
+//  measured GPU time of the stages it scales, then upscales it to the viewport
+//  with a light sharpening pass. Work that doesn't depend on the resolution,
+//  like the reaction diffusion, should be left out of that time. Targets are allocated once at full size and only the
+//  rendered sub-rectangle shrinks, so changing scale never reallocates.
+//
+//  The scale is adjusted at most every mInterval frames, only when the GPU time
+//  is outside a dead band around the budget, and in quantized steps, so it
+//  settles instead of oscillating.
+//
+
+#pragma once
+
+#include "cinder/gl/gl.h"
+#include "cinder/gl/Fbo.h"
+#include "cinder/gl/GlslProg.h"
+#include "cinder/Area.h"
+#include <vector>
+
+class DynamicResolution {
+  public:
+	DynamicResolution();
+
+	void		setup( float targetMs, float minScale = 0.5f, float maxScale = 1.0f );
+	void		setEnabled( bool enabled );
+	bool		isEnabled(){	return mIsEnabled;	};
+
+	// Once per frame with the GPU time of the resolution dependent stages of the last measured frame
+	void		update( float gpuMs );
+	float		getScale(){		return mScale;		};
+	float		getTargetMs(){	return mTargetMs;	};
+
+	// Binds view's target, sized for a viewport of viewportSize, and sets the viewport to the scaled area
+	void		bind( int view, const ci::Vec2i &viewportSize );
+	void		unbind( int view );
+	// Size actually rendered for a viewport at the current scale
+	ci::Vec2i	getRenderSize( const ci::Vec2i &viewportSize );
+	// Draws view's rendered area into the current viewport, sharpening in proportion to the upscale
+	void		drawUpscaled( int view, ci::gl::GlslProg &shader );
+
+  private:
+	std::vector<ci::gl::Fbo>	mTargets;
+	std::vector<ci::Vec2i>		mRenderSizes;
+
+	float		mScale;
+	float		mMinScale, mMaxScale;
+	float		mTargetMs;
+	float		mDeadBand;		// Fraction of the budget the GPU time may drift before we react
+	float		mStep;			// Scale is quantized to this
+	int			mInterval;		// Frames between adjustments, long enough for the profiler average to catch up
+	int			mFramesSinceChange;
+	bool		mIsEnabled;
+};
@@ -0,0 +1,25 @@
+//
+//  GlProc.h
+//  KinectTerrain
+//
+//  Runtime lookup for GL entry points newer than the headers we build against.
+//  Callers still have to check the extension string first.
+//
+
+#pragma once
+
+#include "cinder/gl/gl.h"
+
+#ifndef APIENTRY
+	#define APIENTRY
+#endif
+
+inline void* getGlProcAddress( const char *name )
+{
+#if defined( CINDER_MSW )
+	return (void*)wglGetProcAddress( name );
+#else
+	// The legacy context on OS X doesn't expose anything past 2.1 plus its own extensions
+	return NULL;
+#endif
+}
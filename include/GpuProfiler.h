@@ -0,0 +1,73 @@
+//
+//  GpuProfiler.h
+//  KinectTerrain
+//
+//  Lightweight GPU profiler built on double-buffered GL_TIME_ELAPSED queries.
+//  Each named stage owns two query objects; the one issued last frame is read
+//  back at the start of this frame, so we never stall waiting on the GPU.
+//  Timer queries can't be nested, so stages must not overlap.
+//
+
+#pragma once
+
+#include "cinder/gl/gl.h"
+#include "cinder/Filesystem.h"
+#include <string>
+#include <vector>
+#include <map>
+
+class GpuProfiler {
+  public:
+	struct Stage {
+		std::string			mName;
+		GLuint				mQueries[2];
+		bool				mIssued[2];
+		double				mCpuTimes[2];		// CPU time (seconds) at begin(), used as the trace timestamp
+		std::vector<float>	mSamples;			// Rolling window of GPU times in milliseconds
+		int					mSampleIndex;
+		int					mSampleCount;
+		float				mLastMs;
+	};
+
+	struct TraceEvent {
+		int					mStage;
+		double				mCpuTime;
+		float				mGpuMs;
+	};
+
+	GpuProfiler();
+	~GpuProfiler();
+
+	void		setup( int windowSize = 60, int maxTraceEvents = 20000 );
+	void		setEnabled( bool enabled ){	mIsEnabled = enabled;	};
+	bool		isEnabled(){				return mIsEnabled;		};
+
+	// Call once per frame before any begin()/end(), collects last frame's results
+	void		beginFrame();
+	void		begin( const std::string &name );
+	void		end();
+
+	float		getAverageMs( const std::string &name );
+	float		getTotalAverageMs();
+	// Sum of the averages of every stage whose name starts with prefix, e.g. all views of "walls"
+	float		getAverageMsWithPrefix( const std::string &prefix );
+	const std::vector<Stage>& getStages(){ return mStages; };
+
+	// Dumps the recorded events in the Chrome trace event format (chrome://tracing)
+	void		writeChromeTrace( const ci::fs::path &path );
+
+  private:
+	int			findOrCreateStage( const std::string &name );
+	void		collect( Stage &stage, int buffer, int stageIndex );
+
+	std::vector<Stage>			mStages;
+	std::map<std::string, int>	mStageIndices;
+	std::vector<TraceEvent>		mTrace;
+
+	int			mWindowSize;
+	int			mMaxTraceEvents;
+	int			mFrame;
+	int			mActiveStage;
+	bool		mIsEnabled;
+	bool		mIsSupported;
+};
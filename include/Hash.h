@@ -0,0 +1,33 @@
+//
+//  Hash.h
+//  KinectTerrain
+//
+//  64-bit FNV-1a, used to key the on-disk shader and texture caches. Pass a
+//  previous result as the seed to hash several buffers as one.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+static const uint64_t HASH_SEED = 14695981039346656037ULL;
+
+inline uint64_t hashBytes( const void *data, size_t size, uint64_t seed = HASH_SEED )
+{
+	const unsigned char *bytes = (const unsigned char*)data;
+	uint64_t hash = seed;
+	for( size_t i = 0; i < size; i++ ){
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+inline std::string hashToString( uint64_t hash )
+{
+	char str[32];
+	sprintf( str, "%08x%08x", (uint32_t)( hash >> 32 ), (uint32_t)hash );
+	return std::string( str );
+}
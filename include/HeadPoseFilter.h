@@ -0,0 +1,59 @@
+//
+//  HeadPoseFilter.h
+//  KinectTerrain
+//
+//  Smooths tracked head positions with a one euro filter (Casiez et al. 2012):
+//  a low pass whose cutoff rises with speed, so the head is steady when still
+//  and doesn't lag when moving. Filtered samples are kept with their times so
+//  predict() can extrapolate along the recent velocity to when the frame will
+//  actually be on screen.
+//
+//  Samples arrive on the OSC thread and predictions are made on the main
+//  thread, so everything is behind a mutex.
+//
+
+#pragma once
+
+#include "cinder/Vector.h"
+#include "cinder/Thread.h"
+
+class HeadPoseFilter {
+  public:
+	struct Params {
+		Params() : mMinCutoff( 1.0f ), mBeta( 0.5f ), mDerivativeCutoff( 1.0f ), mLatency( 0.05f ), mMaxPrediction( 0.1f ) {}
+		float	mMinCutoff;			// Hz, smoothing when the head is still
+		float	mBeta;				// Hz per m/s, how quickly the cutoff opens up with speed
+		float	mDerivativeCutoff;	// Hz, smoothing of the speed estimate
+		float	mLatency;			// Seconds from drawing to scanout, callers predict this far ahead
+		float	mMaxPrediction;		// Never extrapolate further than this past the last sample
+	};
+
+	HeadPoseFilter();
+
+	void		setParams( const Params &params );
+	Params		getParams();
+
+	void		addSample( const ci::Vec3f &position, double time );
+	// Filtered position extrapolated to time
+	ci::Vec3f	predict( double time );
+	// Whether a sample has arrived within timeout seconds of time
+	bool		isTracking( double time, double timeout = 1.0 );
+	void		reset();
+
+  private:
+	struct Sample {
+		ci::Vec3f	mPosition;
+		double		mTime;
+	};
+
+	static const int HISTORY_SIZE = 32;
+
+	ci::Vec3f	getVelocity();
+
+	Params		mParams;
+	Sample		mHistory[HISTORY_SIZE];		// Filtered samples, a ring ending at mNewest
+	int			mNewest;
+	int			mNumSamples;
+	ci::Vec3f	mDerivative;				// Filtered derivative from the one euro filter
+	std::mutex	mMutex;
+};
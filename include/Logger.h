@@ -0,0 +1,123 @@
+//
+//  Logger.h
+//  KinectTerrain
+//
+//  Asynchronous logging that is cheap enough to leave on in the render loop.
+//  Each thread writes into its own lock-free single producer ring buffer; a
+//  background thread drains the rings, formats the entries and writes them to
+//  the console. Nothing is formatted on the calling thread: an entry is just a
+//  static format string plus up to four arguments, numbers or strings. String
+//  literals are kept by pointer, std::strings are copied into the entry, up to
+//  Logger::TEXT_SIZE characters between them. Each conversion is formatted on
+//  its own with its argument converted to suit, so %d, %g and %s all work
+//  whatever type was passed.
+//
+//  Levels below LOG_LEVEL are compiled out. The _EVERY variants drop calls made
+//  less than the given number of seconds after the last one from the same site.
+//
+
+#pragma once
+
+#include "cinder/Thread.h"
+#include <atomic>
+#include <string>
+#include <vector>
+
+#define LOG_LEVEL_DEBUG		0
+#define LOG_LEVEL_INFO		1
+#define LOG_LEVEL_WARNING	2
+#define LOG_LEVEL_ERROR		3
+#define LOG_LEVEL_NONE		4
+
+#ifndef LOG_LEVEL
+	#ifdef NDEBUG
+		#define LOG_LEVEL	LOG_LEVEL_INFO
+	#else
+		#define LOG_LEVEL	LOG_LEVEL_DEBUG
+	#endif
+#endif
+
+#define LOG_AT( level, ... )				do{ if( level >= LOG_LEVEL ) Logger::write( level, __VA_ARGS__ ); }while( 0 )
+#define LOG_AT_EVERY( level, secs, ... )	do{ if( level >= LOG_LEVEL ){ static Logger::RateLimit sRateLimit; if( sRateLimit.allow( secs ) ) Logger::write( level, __VA_ARGS__ ); } }while( 0 )
+
+#define LOG_DEBUG( ... )				LOG_AT( LOG_LEVEL_DEBUG, __VA_ARGS__ )
+#define LOG_INFO( ... )					LOG_AT( LOG_LEVEL_INFO, __VA_ARGS__ )
+#define LOG_WARNING( ... )				LOG_AT( LOG_LEVEL_WARNING, __VA_ARGS__ )
+#define LOG_ERROR( ... )				LOG_AT( LOG_LEVEL_ERROR, __VA_ARGS__ )
+#define LOG_DEBUG_EVERY( secs, ... )	LOG_AT_EVERY( LOG_LEVEL_DEBUG, secs, __VA_ARGS__ )
+#define LOG_INFO_EVERY( secs, ... )		LOG_AT_EVERY( LOG_LEVEL_INFO, secs, __VA_ARGS__ )
+
+class Logger {
+  public:
+	static const int MAX_ARGS	= 4;
+	static const int TEXT_SIZE	= 64;
+
+	// One argument slot, tagged with what it holds
+	struct Arg {
+		enum Type { NONE, NUMBER, INTEGER, STRING, TEXT };
+
+		Arg() : mType( NONE ), mInteger( 0 ) {}
+		Arg( double value ) : mType( NUMBER ), mNumber( value ) {}
+		Arg( int value ) : mType( INTEGER ), mInteger( value ) {}
+		Arg( unsigned int value ) : mType( INTEGER ), mInteger( value ) {}
+		Arg( long value ) : mType( INTEGER ), mInteger( value ) {}
+		Arg( unsigned long value ) : mType( INTEGER ), mInteger( (long long)value ) {}
+		Arg( long long value ) : mType( INTEGER ), mInteger( value ) {}
+		Arg( unsigned long long value ) : mType( INTEGER ), mInteger( (long long)value ) {}
+		// Has to outlive the entry, so literals and other static strings
+		Arg( const char *value ) : mType( STRING ), mString( value ) {}
+		// Copied into the entry's text by write()
+		Arg( const std::string &value ) : mType( TEXT ), mString( value.c_str() ) {}
+
+		Type			mType;
+		union {
+			double		mNumber;
+			long long	mInteger;		// Also a TEXT argument's offset into Entry::mText once copied
+			const char	*mString;
+		};
+	};
+
+	struct Entry {
+		double			mTime;
+		const char		*mFormat;
+		Arg				mArgs[MAX_ARGS];
+		char			mText[TEXT_SIZE];	// The TEXT arguments, each null terminated
+		int				mLevel;
+	};
+
+	// Single producer, single consumer ring. The owning thread pushes, the writer thread pops.
+	struct Ring {
+		static const unsigned int CAPACITY = 1024;	// Must be a power of two
+
+		Ring() : mHead( 0 ), mTail( 0 ), mDropped( 0 ) {}
+		bool	push( const Entry &entry );
+		bool	pop( Entry *entry );
+
+		Entry						mEntries[CAPACITY];
+		std::atomic<unsigned int>	mHead;		// Next slot to write, only advanced by the producer
+		std::atomic<unsigned int>	mTail;		// Next slot to read, only advanced by the consumer
+		std::atomic<unsigned int>	mDropped;	// Entries lost because the ring was full
+	};
+
+	struct RateLimit {
+		RateLimit() : mLastTime( -1.0e9 ) {}
+		bool	allow( double intervalSeconds );
+		double	mLastTime;
+	};
+
+	static void		write( int level, const char *format, const Arg &a0 = Arg(), const Arg &a1 = Arg(), const Arg &a2 = Arg(), const Arg &a3 = Arg() );
+	// Flushes everything still queued and stops the writer thread. Anything logged afterwards is never written.
+	static void		shutdown();
+
+  private:
+	static Ring*	getThreadRing();
+	static void		startWriter();
+	static void		writerThread();
+	static bool		drain( std::vector<Ring*> *rings );
+
+	static std::vector<Ring*>			sRings;
+	static std::mutex					sRingsMutex;	// Taken when a thread logs for the first time, and by the writer to copy sRings
+	static std::shared_ptr<std::thread>	sWriter;
+	static bool							sHasShutDown;	// Guarded by sRingsMutex, the writer isn't started again
+	static std::atomic<bool>			sIsRunning;
+};
@@ -14,6 +14,8 @@
 
 class RDiffusion {
   public:
+	static const int DEFAULT_ITERATIONS = 7;
+
 	RDiffusion();
 	RDiffusion( int fboWidth, int fboHeight );
 	void			reset();
@@ -21,7 +23,8 @@ class RDiffusion {
 							const ci::gl::Texture &glowTex, 
 						    const bool &isPressed, 
 						    const ci::Vec2f &mousePos,
-						    float zoom );
+						    float zoom,
+						    int iterations = DEFAULT_ITERATIONS );
 	void			drawIntoHeightsFbo( ci::gl::GlslProg *shader, ci::Vec3f scale );
 	void			drawIntoNormalsFbo( ci::gl::GlslProg *shader );
 	void			draw();
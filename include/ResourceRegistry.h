@@ -0,0 +1,82 @@
+//
+//  ResourceRegistry.h
+//  KinectTerrain
+//
+//  Accounts for what we allocate. Owners register each FBO, texture, VBO,
+//  program and large CPU buffer when they create it, with its format, size and
+//  an estimate of the bytes it takes, along with a weak reference to the
+//  wrapper that owns it. refresh() drops entries whose GL name no longer exists.
+//  One whose wrapper is gone while the GL object is still alive was never
+//  deleted, so it's kept and flagged as a leak. A GL name reused by something
+//  we don't register before refresh() runs can show up as a false leak.
+//
+//  Everything is estimated from the requested format; drivers pad and may keep
+//  extra copies. Safe to call from any thread, but refresh() checks
+//  GL state and belongs on the GL thread.
+//
+
+#pragma once
+
+#include "cinder/gl/gl.h"
+#include "cinder/gl/Texture.h"
+#include "cinder/gl/Fbo.h"
+#include "cinder/gl/Vbo.h"
+#include "cinder/gl/GlslProg.h"
+#include "cinder/Filesystem.h"
+#include "cinder/Thread.h"
+#include <string>
+#include <vector>
+
+class ResourceRegistry {
+  public:
+	enum Kind { TEXTURE, FBO, VBO, PROGRAM, CPU_BUFFER, NUM_KINDS };
+
+	struct Entry {
+		Kind			mKind;
+		uint64_t		mHandle;		// GL name, or the address of a CPU buffer
+		std::string		mOwner;
+		std::string		mName;
+		std::string		mFormat;
+		int				mWidth, mHeight, mDepth;
+		size_t			mBytes;
+		double			mTime;			// Seconds since launch when it was registered
+		bool			mIsLeaked;
+		bool			mHasLifetime;	// Without one only a deleted GL name ends the entry
+		std::weak_ptr<void>	mLifetime;	// Expires with the owning wrapper and all its copies
+	};
+
+	// Replaces any entry with the same kind and handle, GL names get reused
+	static void		add( Kind kind, uint64_t handle, const std::string &owner, const std::string &name,
+						 GLenum format, int width, int height, int depth, size_t bytes,
+						 const std::weak_ptr<void> &lifetime = std::weak_ptr<void>() );
+	static void		addTexture( const ci::gl::Texture &texture, const std::string &owner, const std::string &name );
+	// The framebuffer plus its color texture, with the depth buffer counted in the framebuffer
+	static void		addFbo( ci::gl::Fbo &fbo, const std::string &owner, const std::string &name );
+	// Static and index buffers, sized from the layout
+	static void		addVboMesh( ci::gl::VboMesh &mesh, const std::string &owner, const std::string &name );
+	static void		addCpuBuffer( const void *data, const std::string &owner, const std::string &name, size_t bytes );
+	// Drops entries whose GL object is gone and flags the ones that outlived their owner
+	static void		refresh();
+
+	// Lifetime tokens for Cinder's wrappers, for owners that call add() themselves
+	static std::weak_ptr<void>	getLifetime( const ci::gl::Texture &texture );
+	static std::weak_ptr<void>	getLifetime( const ci::gl::Fbo &fbo );
+	static std::weak_ptr<void>	getLifetime( const ci::gl::VboMesh &mesh );
+	static std::weak_ptr<void>	getLifetime( const ci::gl::GlslProg &prog );
+
+	static size_t				getTotalBytes( Kind kind );
+	static size_t				getGpuBytes();
+	static int					getNumLeaks();
+	static std::vector<Entry>	getEntries();
+	static void					writeJson( const ci::fs::path &path );
+
+	static size_t		getBytesPerPixel( GLenum format );
+	static const char*	getFormatName( GLenum format );
+	static const char*	getKindName( Kind kind );
+
+  private:
+	static bool		isAlive( Kind kind, uint64_t handle );
+
+	static std::vector<Entry>	sEntries;
+	static std::mutex			sMutex;
+};
@@ -26,3 +26,7 @@
 #define GRADIENT_TEX_ID		CINDER_RESOURCE( ../resources/, gradient.png,		160, IMAGE )
 #define SAND_NORMAL_TEX_ID	CINDER_RESOURCE( ../resources/, sandNormal.png,		161, IMAGE )
 #define BACK_WALL_TEX_ID	CINDER_RESOURCE( ../resources/, roomWall0.png,		162, IMAGE )
+#define UPSCALE_FRAG_ID		CINDER_RESOURCE( ../resources/, upscale.frag,		163, GLSL )
+#define SPHERE_IMPOSTOR_VERT_ID	CINDER_RESOURCE( ../resources/, sphereImpostor.vert,	164, GLSL )
+#define WALLS_VERT_ID		CINDER_RESOURCE( ../resources/, walls.vert,			165, GLSL )
+#define WALLS_FRAG_ID		CINDER_RESOURCE( ../resources/, walls.frag,			166, GLSL )
@@ -7,23 +7,25 @@
 
 #pragma once
 #include "cinder/gl/Vbo.h"
+#include "cinder/gl/GlslProg.h"
+#include "TextureArray.h"
+#include <vector>
 
 class Room
 {
   public:
+	// Layers of the walls texture array passed to drawWalls()
+	enum { WALL_BACK, WALL_LEFT, WALL_RIGHT, WALL_CEILING, WALL_FLOOR, WALL_BLANK, NUM_WALL_LAYERS };
+
 	Room();
 	Room( const ci::Vec3f &dims, bool isPowerOn, bool isGravityOn );
 	void		init();
 	void		updateTime();
 	void		update();
 	void		draw();
-	void		drawWalls( float mainPower, 
-						  const ci::gl::Texture &backTex, 
-						  const ci::gl::Texture &leftTex, 
-						  const ci::gl::Texture &rightTex, 
-						  const ci::gl::Texture &ceilingTex,
-						  const ci::gl::Texture &floorTex,
-						  const ci::gl::Texture &blankTex );
+	// Draws every visible wall in one instanced call with walls.vert/frag. The flicker
+	// is seeded per frame, so every view drawn in a frame shows the same walls.
+	void		drawWalls( float mainPower, TextureArray &wallsTex, ci::gl::GlslProg &shader );
 	
 	void		setDims( const ci::Vec3f &dims ){ mDims = dims; };
 	ci::Vec3f	getDims(){ return mDims; };
@@ -33,6 +35,7 @@ class Room
 	float		getFloorLevel();
 	
 	void		adjustTimeMulti( float amt );
+	void		setFixedTimeStep( float dt ){ mFixedTimeStep = dt; };
 	float		getTimePer();
 	float		getTimeDelta();
 	bool		getTick();
@@ -49,6 +52,20 @@ class Room
 	
 	ci::gl::VboMesh mVbo;
 	
+	// WALLS
+	struct WallInstance {
+		ci::Vec4f	mCenter;			// xyz center, w texture array layer
+		ci::Vec3f	mRight;				// Half extents along the wall
+		ci::Vec3f	mUp;
+	};
+	void			addWall( const ci::Vec3f &center, const ci::Vec3f &right, const ci::Vec3f &up, int layer );
+	
+	ci::gl::VboMesh				mWallQuad;
+	ci::gl::Vbo					mWallVbo;
+	std::vector<WallInstance>	mWalls;
+	uint32_t					mFrame;				// Seeds the wall flicker
+	bool						mIsInstancingSupported;
+	
 	// TIME
 	float			mTime;				// Time elapsed in real world seconds
 	float			mTimeElapsed;		// Time elapsed in simulation seconds
@@ -56,6 +73,7 @@ class Room
 	float			mTimeAdjusted;		// Amount of time passed between last frame and current frame
 	float			mTimer;				// A resetting counter for determining if a Tick has occured
 	bool			mTick;				// Tick (aka step) for triggering discrete events
+	float			mFixedTimeStep;		// If non-zero, advance by this many seconds per update instead of wall clock time
 	
 	// DIMENSIONS
 	ci::Vec3f		mDims;				// Hesitant to rename this to 'bounds'. Might make it too easy to
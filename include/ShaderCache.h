@@ -0,0 +1,45 @@
+//
+//  ShaderCache.h
+//  KinectTerrain
+//
+//  Skips GLSL compilation on later launches by saving linked program binaries
+//  (ARB_get_program_binary) to disk. Entries are keyed on a hash of the shader
+//  sources and the GL vendor/renderer/version strings, so a driver update or an
+//  edited shader just misses. A binary the driver rejects is recompiled from
+//  source and rewritten.
+//
+
+#pragma once
+
+#include "cinder/gl/gl.h"
+#include "cinder/gl/GlslProg.h"
+#include "cinder/DataSource.h"
+#include "cinder/Filesystem.h"
+#include <string>
+
+class ShaderCache {
+  public:
+	ShaderCache();
+
+	void				setup( const ci::fs::path &directory );
+	// Same as constructing a GlslProg from the two sources, throws GlslProgCompileExc on failure.
+	// defines ("#define NAME\n" lines) go after each source's #version, or at the top without one.
+	ci::gl::GlslProg	load( ci::DataSourceRef vertexShader, ci::DataSourceRef fragmentShader, const std::string &defines = "" );
+	ci::gl::GlslProg	load( const std::string &vertexSource, const std::string &fragmentSource, const std::string &defines = "" );
+
+	bool				isSupported(){		return mIsSupported;	};
+	int					getNumHits(){		return mNumHits;		};
+	int					getNumMisses(){		return mNumMisses;		};
+
+  private:
+	static std::string	injectDefines( const std::string &source, const std::string &defines );
+	std::string			getKey( const std::string &vertexSource, const std::string &fragmentSource );
+	bool				readBinary( const ci::fs::path &path, GLenum *format, std::string *binary );
+	void				writeBinary( const ci::fs::path &path, GLuint program );
+
+	ci::fs::path		mDirectory;
+	std::string			mDriver;
+	bool				mIsSupported;
+	int					mNumHits;
+	int					mNumMisses;
+};
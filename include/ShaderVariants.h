@@ -0,0 +1,33 @@
+//
+//  ShaderVariants.h
+//  KinectTerrain
+//
+//  Compiles a shader once per power state. The room spends almost all of its
+//  time with the power settled fully off or fully on, where the mix between
+//  the lit and dark looks throws half the fragment work away, so those two
+//  states get permutations built with POWER_OFF or POWER_ON defined that only
+//  compute the look they show. The blended original is kept for transitions.
+//
+
+#pragma once
+
+#include "cinder/gl/GlslProg.h"
+#include "cinder/DataSource.h"
+#include "ShaderCache.h"
+
+class ShaderVariants {
+  public:
+	enum { POWER_OFF, POWER_ON, POWER_BLEND, NUM_VARIANTS };
+
+	// Throws GlslProgCompileExc if any permutation fails. defines are added to every permutation.
+	void				setup( ShaderCache &cache, ci::DataSourceRef vertexShader, ci::DataSourceRef fragmentShader, const std::string &defines = "" );
+
+	// Settled states only count once power is close enough that the blend couldn't be seen
+	static int			getVariant( float power );
+	static const char*	getVariantName( int variant );
+
+	ci::gl::GlslProg&	get( int variant ){		return mVariants[variant];	};
+
+  private:
+	ci::gl::GlslProg	mVariants[NUM_VARIANTS];
+};
@@ -0,0 +1,61 @@
+//
+//  SimulationGovernor.h
+//  KinectTerrain
+//
+//  Picks how much reaction diffusion work to do each frame. It watches only the
+//  GPU time of the simulation's own stages against the simulation's share of
+//  the frame, so it and DynamicResolution each answer for their own stages and
+//  a spike in one doesn't push both down. Level 0 is the full simulation, and
+//  is where it stays whenever the simulation fits its budget, whatever the
+//  room's power.
+//
+//  Lower levels are visible: fewer steps per frame slow the pattern's growth,
+//  and updating the normals every few frames lets the lighting lag the heights
+//  slightly. Both beat dropping frames, so they're only taken after the budget
+//  has been overrun for a while, one step at a time with a minimum hold.
+//
+//  Simulation resolution isn't one of the levels. The reaction diffusion's spots
+//  and stripes are a fixed number of cells across, and rd.frag's neighbour
+//  offsets are a texel of the window, so a coarser grid would make a coarser
+//  pattern rather than a blurrier one. Switching grids would also resample the
+//  state and the accumulated heights in the middle of the pattern, which pops
+//  far more than a slower step does. DynamicResolution scales the render
+//  targets, which the simulation doesn't draw into.
+//
+
+#pragma once
+
+class SimulationGovernor {
+  public:
+	struct Level {
+		int		mIterations;		// RD steps per frame
+		int		mNormalsInterval;	// Frames between normals updates
+	};
+
+	static const int NUM_LEVELS = 4;
+
+	SimulationGovernor();
+
+	void		setup( float budgetMs );
+	// Stays at level 0 when disabled
+	void		setBudgetEnabled( bool enabled ){	mIsBudgetEnabled = enabled;	};
+
+	// Once per frame, before the simulation runs, with the GPU time of the simulation's stages
+	void		update( float simulationMs );
+
+	int			getLevelIndex(){		return mLevel;							};
+	int			getIterations(){		return LEVELS[mLevel].mIterations;		};
+	int			getNormalsInterval(){	return LEVELS[mLevel].mNormalsInterval;	};
+	bool		shouldUpdateNormals(){	return mFrame % getNormalsInterval() == 0;	};
+
+  private:
+	static const Level	LEVELS[NUM_LEVELS];
+
+	float		mBudgetMs;
+	bool		mIsBudgetEnabled;
+	int			mLevel;
+	int			mFramesOver;		// Consecutive frames over budget
+	int			mFramesUnder;		// Consecutive frames comfortably under budget
+	int			mFramesSinceChange;
+	int			mFrame;
+};
@@ -0,0 +1,55 @@
+//
+//  SphereBatch.h
+//  KinectTerrain
+//
+//  Draws any number of spheres from a few cached unit sphere meshes. Each view
+//  picks a level of detail per sphere from its projected size, then draws every
+//  LOD with one instanced call. Per instance data is the sphere's center and
+//  radius, fed to the "instanceSphere" vertex attribute.
+//
+//  Impostors skip the meshes: every sphere is one quad facing the eye, drawn in
+//  a single instanced call, and the fragment shader ray casts the sphere and
+//  writes its depth. Silhouettes are exact at any distance and vertex cost is
+//  four per sphere.
+//
+
+#pragma once
+
+#include "cinder/gl/gl.h"
+#include "cinder/gl/Vbo.h"
+#include "cinder/gl/GlslProg.h"
+#include "cinder/Sphere.h"
+#include "HeadCam.h"
+#include <vector>
+
+class SphereBatch {
+  public:
+	static const int NUM_LODS = 3;
+
+	SphereBatch();
+	void			setup();
+	// Picks LODs for this view and draws all spheres with the currently bound shader
+	void			draw( const std::vector<ci::Sphere> &spheres, const HeadCam &cam, float viewportHeight, ci::gl::GlslProg &shader );
+	// Same, as ray cast quads. shader should be sphereImpostor.vert with sphere.frag built with SPHERE_IMPOSTOR.
+	void			drawImpostors( const std::vector<ci::Sphere> &spheres, ci::gl::GlslProg &shader );
+
+	int				getLod( const ci::Sphere &sphere, const HeadCam &cam, float viewportHeight );
+	int				getNumDrawCalls(){ return mNumDrawCalls; };
+
+  private:
+	ci::gl::VboMesh	createUnitSphere( int segments );
+	ci::gl::VboMesh	createQuad();
+	void			uploadInstances();
+	void			drawInstanced( ci::gl::VboMesh &mesh, const std::vector<ci::Vec4f> &instances, size_t offset, GLint attrib );
+
+	ci::gl::VboMesh				mLods[NUM_LODS];
+	ci::gl::VboMesh				mQuad;
+	int							mSegments[NUM_LODS];
+	float						mMinPixelRadius[NUM_LODS];	// Smallest projected radius that still uses this LOD
+
+	ci::gl::Vbo					mInstanceVbo;
+	std::vector<ci::Vec4f>		mInstances[NUM_LODS];
+	std::vector<ci::Vec4f>		mInstanceData;
+	bool						mIsInstancingSupported;
+	int							mNumDrawCalls;
+};
@@ -0,0 +1,55 @@
+//
+//  TextureArray.h
+//  KinectTerrain
+//
+//  A GL_TEXTURE_2D_ARRAY of same sized RGBA layers, so a set of textures can be
+//  sampled by one shader in one draw and picked per instance by layer index.
+//  Copies share the same GL texture, which is deleted with the last copy.
+//
+
+#pragma once
+
+#include "cinder/gl/gl.h"
+#include "cinder/Surface.h"
+#include "cinder/Filesystem.h"
+#include <vector>
+
+class TextureArray
+{
+  public:
+	TextureArray();
+	// Layers that aren't width x height RGBA are converted and resized first. With compress, stored
+	// as DXT1 when EXT_texture_compression_s3tc is available, which drops alpha.
+	TextureArray( int width, int height, const std::vector<ci::Surface8u> &layers, bool compress = false );
+
+	// Loads a container written by write(), returns an empty TextureArray if it's missing or unusable
+	static TextureArray	load( const ci::fs::path &path );
+	// Saves every layer, already compressed if the texture is
+	bool		write( const ci::fs::path &path );
+
+	static bool	isSupported();
+
+	void		bind( int unit = 0 );
+	void		unbind( int unit = 0 );
+
+	GLuint		getId() const {			return mObj ? mObj->mId : 0;			}
+	int			getWidth() const {		return mObj ? mObj->mWidth : 0;			}
+	int			getHeight() const {		return mObj ? mObj->mHeight : 0;		}
+	int			getNumLayers() const {	return mObj ? mObj->mNumLayers : 0;		}
+
+  private:
+	struct Obj {
+		Obj() : mId( 0 ), mWidth( 0 ), mHeight( 0 ), mNumLayers( 0 ), mInternalFormat( 0 ) {}
+		~Obj();
+
+		GLuint	mId;
+		int		mWidth, mHeight;
+		int		mNumLayers;
+		GLenum	mInternalFormat;
+	};
+
+	// Creates the texture and leaves it bound, its storage is up to the caller
+	void		allocate( int width, int height, int numLayers, GLenum internalFormat );
+
+	std::shared_ptr<Obj>	mObj;
+};
@@ -1,3 +1,4 @@
+// POWER_OFF or POWER_ON is defined for the variants used while power is settled at 0 or 1
 uniform vec3 eyePos;
 uniform float power;
 uniform float lightPower;
@@ -52,12 +53,9 @@ void main()
 //		index			+= invNumLights;
 //	}
 
-	float sBorder		= 1.0 - pow( sin( gl_TexCoord[0].s * 3.14159 ), 0.02 );
-	float tBorder		= 1.0 - pow( sin( gl_TexCoord[0].t * 3.14159 ), 0.02 );
-	float border		= max( sBorder, tBorder ) * 10.0;
-	
 	float radiosity		= 1.0 - length( vVertex.xyz ) * ( 0.0012 + ( 1.0 - lightPower ) * 0.0005 );
 	
+#if !defined( POWER_ON )
 	float ceiling		= 0.0;
 	if( vNormal.y < -0.5 ) ceiling = 1.0;
 	
@@ -66,11 +64,24 @@ void main()
 	ceilingGlow			+= pow( yPer, 200.0 );
 	ceilingGlow			+= pow( max( yPer - 0.7, 0.0 ), 3.0 ) * 4.0;
 	
+	vec3 litRoomColor	= vec3( radiosity + ( ceiling + ceilingGlow * timePer ) * lightPower );
+#endif
+#if !defined( POWER_OFF )
+	float sBorder		= 1.0 - pow( sin( gl_TexCoord[0].s * 3.14159 ), 0.02 );
+	float tBorder		= 1.0 - pow( sin( gl_TexCoord[0].t * 3.14159 ), 0.02 );
+	float border		= max( sBorder, tBorder ) * 10.0;
+	
 	vec3 greenGlow		= vec3( 0.1, 0.4, 0.3 );
 	
-	vec3 litRoomColor	= vec3( radiosity + ( ceiling + ceilingGlow * timePer ) * lightPower );
 	vec3 darkRoomColor	= vec3( radiosity * 0.1 ) + border * greenGlow * ( 1.0 - lightPower );
+#endif
 	
+#if defined( POWER_OFF )
+	gl_FragColor.rgb	= litRoomColor;
+#elif defined( POWER_ON )
+	gl_FragColor.rgb	= darkRoomColor;
+#else
 	gl_FragColor.rgb	= mix( litRoomColor, darkRoomColor, power );
+#endif
 	gl_FragColor.a		= 1.0;
 }
\ No newline at end of file
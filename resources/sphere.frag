@@ -1,3 +1,5 @@
+// POWER_OFF or POWER_ON is defined for the variants used while power is settled at 0 or 1.
+// SPHERE_IMPOSTOR ray casts the sphere from a quad drawn by sphereImpostor.vert.
 uniform sampler2D heightsTex;
 uniform vec3 eyePos;
 uniform float radius;
@@ -10,54 +12,80 @@ uniform float color;
 uniform vec3 sandColor;
 uniform float timePer;
 
-varying vec3 vEyeDir;
 varying vec4 vVertex;
+#if defined( SPHERE_IMPOSTOR )
+uniform mat4 mvpMatrix;
+varying vec4 vCenter;
+#else
+varying vec3 vEyeDir;
 varying vec3 vNormal;
 varying vec3 vFog;
 varying float vHeight;
 varying float vDist;
+#endif
 
 void main()
 {	
+#if defined( SPHERE_IMPOSTOR )
+	vec3 rayDir			= normalize( vVertex.xyz - eyePos );
+	vec3 toCenter		= vCenter.xyz - eyePos;
+	float b				= dot( toCenter, rayDir );
+	float disc			= b * b - dot( toCenter, toCenter ) + vCenter.w * vCenter.w;
+	if( disc < 0.0 ) discard;
+	
+	vec3 position		= eyePos + rayDir * ( b - sqrt( disc ) );
+	vec3 normal			= ( position - vCenter.xyz ) / vCenter.w;
+	vec3 eyeDir			= -rayDir;
+	float dist			= pow( distance( eyePos, position * vec3( 1.5, 1.0, 1.5 ) ) * 0.001425, 3.0 );
+	float fogDist		= clamp( 1.0 - dist, 0.0, 1.0 ) * power;
+	
+	// Depth of the surface, not the quad, so the terrain cuts the sphere correctly
+	vec4 clipPos		= mvpMatrix * vec4( position, 1.0 );
+	gl_FragDepth		= ( clipPos.z / clipPos.w ) * 0.5 + 0.5;
+#else
+	vec3 position		= vVertex.xyz;
+	vec3 normal			= vNormal;
+	vec3 eyeDir			= vEyeDir;
+	float fogDist		= vDist;
+#endif
+	
 	vec3 lightPos		= vec3( 0.0, 500.0, 0.0 );
-	vec3 lightDir		= lightPos - vVertex.xyz;
+	vec3 lightDir		= lightPos - position;
 	vec3 lightDirNorm	= normalize( lightDir );
 	
-	float ppDiff		= max( dot( vNormal, lightDirNorm ), 0.0 );
-	vec3 HV				= normalize( lightDirNorm + vEyeDir );
-	float NdotHV		= max( dot( vNormal, HV ), 0.0 );
-	float ppSpec		= pow( NdotHV, 30.0 );
+	float ppDiff		= max( dot( normal, lightDirNorm ), 0.0 );
 	
-	float ppFres		= pow( 1.0 - ppDiff, 1.5 );
-	float ppEyeDiff		= max( dot( vNormal, vEyeDir ), 0.0 );
+	float ppEyeDiff		= max( dot( normal, eyeDir ), 0.0 );
 	float ppEyeFres		= pow( 1.0 - ppEyeDiff, 2.0 );
 	
-	vec3 c = vec3( 1.0 - ppEyeFres * 0.2 );
-	
-	vec3 reflectDir		= reflect( vEyeDir, vNormal * vec3( 1.0, 1.5, 1.0 ) );
+	vec3 reflectDir		= reflect( eyeDir, normal * vec3( 1.0, 1.5, 1.0 ) );
 	vec3 envColor		= textureCube( cubeMap, reflectDir ).rgb;
 	
-	float envGrey		= envColor.r;
 	float envSpec		= envColor.g;
 	float envDark		= envColor.b;
 	
-	float fakeAo		= pow( vNormal.y * 0.3 + 0.3, 0.4 );
-	float rimLight		= pow( fakeAo, 4.0 ) * ppEyeFres;
+//	float ext			= ( 1.0 - texture2D( heightsTex, gl_TexCoord[0].st * 4.0 ).b ) * 0.01;
 	
-	float bloomShadow	= vNormal.y * 0.5 + 0.5;
-	float reflection	= envGrey * ppEyeDiff * 0.1;
-	float reflectionRim	= envGrey * ppEyeFres * 0.3;
+#if !defined( POWER_ON )
+	float fakeAo		= pow( normal.y * 0.3 + 0.3, 0.4 );
+	float rimLight		= pow( fakeAo, 4.0 ) * ppEyeFres;
+	float bloomShadow	= normal.y * 0.5 + 0.5;
 	float fres			= ppEyeFres * 0.2;
-	float lighting		= ( envSpec - ppEyeFres ) * 0.1;
 	float centerGlow	= ppEyeDiff * 0.4 * bloomShadow;
-	
-//	float ext			= ( 1.0 - texture2D( heightsTex, gl_TexCoord[0].st * 4.0 ).b ) * 0.01;
-	
-	vec3 skyGreen		= vec3( 164.0/255.0, 196.0/255.0, 158.0/255.0 );
-	
 	vec3 litRoomColor	= vec3( fres + rimLight + centerGlow + ppDiff * 0.2 ) + envSpec * 0.3 * ppEyeFres * timePer;
+#endif
+#if !defined( POWER_OFF )
+	float ppFres		= pow( 1.0 - ppDiff, 1.5 );
+	vec3 skyGreen		= vec3( 164.0/255.0, 196.0/255.0, 158.0/255.0 );
 	vec3 darkRoomColor	= vec3( ( ppFres * 0.2 * sandColor ) + ppDiff * skyGreen + envDark * ppEyeFres * 0.4 );
+#endif
 	
-	gl_FragColor.rgb	= mix( litRoomColor, mix( fogColor, darkRoomColor, vDist ), power );
+#if defined( POWER_OFF )
+	gl_FragColor.rgb	= litRoomColor;
+#elif defined( POWER_ON )
+	gl_FragColor.rgb	= mix( fogColor, darkRoomColor, fogDist );
+#else
+	gl_FragColor.rgb	= mix( litRoomColor, mix( fogColor, darkRoomColor, fogDist ), power );
+#endif
 	gl_FragColor.a		= 1.0;
 }
\ No newline at end of file
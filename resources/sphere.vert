@@ -1,7 +1,7 @@
 #version 120
 uniform sampler2D heightsTex;
 uniform sampler2D normalsTex;
-uniform vec2 texCoord;
+uniform vec3 roomDims;
 uniform vec3 eyePos;
 uniform vec3 fogColor;
 uniform mat4 mvpMatrix;
@@ -17,6 +17,8 @@ varying vec3 vFog;
 varying float vHeight;
 varying float vDist;
 
+// xyz is the sphere's center, w its radius
+attribute vec4 instanceSphere;
 
 void main()
 {
@@ -24,6 +26,7 @@ void main()
 	
 	float zoom		= zoomMulti * 0.96 + 0.04;
 	float zoomScale = 2.0 - zoomMulti * 0.85;
+	vec2 texCoord	= ( instanceSphere.xz + roomDims.xz ) / ( roomDims.xz * 2.0 );
 	vec2 zoomCoords = texCoord * zoom + ( 1.0 - zoom ) * 0.5;
 	
 	float s			= 0.025 * zoom;
@@ -34,7 +37,7 @@ void main()
 	vHeight			= ( h0 + h1 + h2 + h3 ) * 0.25;
 
 	vNormal			= normalize( gl_Normal );
-	vVertex			= vec4( gl_Vertex );
+	vVertex			= vec4( instanceSphere.xyz + gl_Vertex.xyz * instanceSphere.w, 1.0 );
 	//	vVertex.y		*= terrainScale.y;
 	vVertex.y		+= vHeight * ( pow( ( zoomScale ) + 1.2, 7.0 ) * 0.0035 );
 	vVertex.y		+= -200.0 + sphereRadius;
@@ -0,0 +1,49 @@
+#version 120
+uniform sampler2D heightsTex;
+uniform vec3 roomDims;
+uniform vec3 eyePos;
+uniform mat4 mvpMatrix;
+uniform float zoomMulti;
+uniform float sphereRadius;
+
+varying vec4 vVertex;
+varying vec4 vCenter;
+
+// xyz is the sphere's center, w its radius
+attribute vec4 instanceSphere;
+
+void main()
+{
+	// Same terrain lift as sphere.vert, applied to the center instead of every vertex
+	float zoom		= zoomMulti * 0.96 + 0.04;
+	float zoomScale = 2.0 - zoomMulti * 0.85;
+	vec2 texCoord	= ( instanceSphere.xz + roomDims.xz ) / ( roomDims.xz * 2.0 );
+	vec2 zoomCoords = texCoord * zoom + ( 1.0 - zoom ) * 0.5;
+	
+	float s			= 0.025 * zoom;
+	float h0 		= texture2D( heightsTex, zoomCoords + vec2( -s, 0.0 ) ).b;
+	float h1		= texture2D( heightsTex, zoomCoords + vec2(  s, 0.0 ) ).b;
+	float h2		= texture2D( heightsTex, zoomCoords + vec2(  0.0, -s ) ).b;
+	float h3		= texture2D( heightsTex, zoomCoords + vec2(  0.0,  s ) ).b;
+	float height	= ( h0 + h1 + h2 + h3 ) * 0.25;
+	
+	vec3 center		= instanceSphere.xyz;
+	center.y		+= height * ( pow( ( zoomScale ) + 1.2, 7.0 ) * 0.0035 );
+	center.y		+= -200.0 + sphereRadius;
+	float radius	= instanceSphere.w;
+	
+	// Quad through the center facing the eye, sized to the silhouette cone so
+	// perspective never clips the edge
+	vec3 toEye		= eyePos - center;
+	float d			= length( toEye );
+	vec3 forward	= toEye / d;
+	vec3 up			= abs( forward.y ) > 0.99 ? vec3( 1.0, 0.0, 0.0 ) : vec3( 0.0, 1.0, 0.0 );
+	vec3 right		= normalize( cross( up, forward ) );
+	up				= cross( forward, right );
+	float halfSize	= radius * d / sqrt( max( d * d - radius * radius, 0.0001 ) ) * 1.02;
+	
+	vVertex			= vec4( center + ( right * gl_Vertex.x + up * gl_Vertex.y ) * halfSize, 1.0 );
+	vCenter			= vec4( center, radius );
+	
+	gl_Position		= mvpMatrix * vVertex;
+}
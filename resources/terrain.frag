@@ -1,4 +1,5 @@
 #version 110
+// POWER_OFF or POWER_ON is defined for the variants used while power is settled at 0 or 1
 uniform vec3 eyePos;
 uniform vec3 lightPos;
 uniform sampler2D sandNormalTex;
@@ -30,16 +31,22 @@ void main()
 	
 	float distToSphere	= distance( vVertex.xyz, vec3( spherePos.x, -200.0, spherePos.z ) ) - sphereRadius * 0.05;
 	float distPer		= pow( clamp( distToSphere * 0.05, 0.0, 1.0 ), 2.0 );
-	vec3 shadow			= texture2D( gradientTex, vec2( distPer, 0.75 ) ).rgb;
-	
 	
+#if !defined( POWER_ON )
 	float aoLight		= 1.0 - length( vVertex.xyz ) * 0.0011;
-	float aoDark		= aoLight * 0.2;
-	
 	vec3 litRoomColor	= mix( vec3( aoLight * ppDiff + aoLight * ppSpec * 0.01 + 0.05 ), vec3( 0.2 ), ( 1.0 - distPer ) );
+#endif
+#if !defined( POWER_OFF )
+	vec3 shadow			= texture2D( gradientTex, vec2( distPer, 0.75 ) ).rgb;
 	vec3 darkRoomColor	= mix( vFinalCol + ppSpec * 0.1, shadow, ( 1.0 - distPer ) );
+#endif
 	
-	
+#if defined( POWER_OFF )
+	gl_FragColor.rgb	= litRoomColor;
+#elif defined( POWER_ON )
+	gl_FragColor.rgb	= darkRoomColor;
+#else
 	gl_FragColor.rgb	= mix( litRoomColor, darkRoomColor, power );
+#endif
 	gl_FragColor.a		= 1.0;
 }
\ No newline at end of file
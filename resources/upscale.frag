@@ -0,0 +1,23 @@
+#version 110
+uniform sampler2D tex;
+uniform vec2 uvScale;
+uniform vec2 texelSize;
+uniform float sharpness;
+
+void main()
+{
+	vec2 uv		= gl_TexCoord[0].st * uvScale;
+	vec3 c		= texture2D( tex, uv ).rgb;
+	vec3 n		= texture2D( tex, uv + vec2( 0.0, texelSize.y ) ).rgb;
+	vec3 s		= texture2D( tex, uv - vec2( 0.0, texelSize.y ) ).rgb;
+	vec3 e		= texture2D( tex, uv + vec2( texelSize.x, 0.0 ) ).rgb;
+	vec3 w		= texture2D( tex, uv - vec2( texelSize.x, 0.0 ) ).rgb;
+	
+	// Unsharp mask, clamped to the neighbourhood so edges don't ring
+	vec3 blur	= ( n + s + e + w ) * 0.25;
+	vec3 lo		= min( c, min( min( n, s ), min( e, w ) ) );
+	vec3 hi		= max( c, max( max( n, s ), max( e, w ) ) );
+	vec3 col	= clamp( c + ( c - blur ) * sharpness * 4.0, lo, hi );
+	
+	gl_FragColor = vec4( col, 1.0 );
+}
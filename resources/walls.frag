@@ -0,0 +1,10 @@
+#version 120
+#extension GL_EXT_texture_array : enable
+uniform sampler2DArray wallsTex;
+
+varying vec3 vTexCoord;
+
+void main()
+{
+	gl_FragColor = texture2DArray( wallsTex, vTexCoord ) * gl_Color;
+}
@@ -0,0 +1,16 @@
+#version 120
+// One instance per wall. gl_Vertex.xy is the quad corner in -1..1.
+attribute vec4 wallCenter;		// xyz center, w texture array layer
+attribute vec3 wallRight;		// Half extents along the wall
+attribute vec3 wallUp;
+
+varying vec3 vTexCoord;
+
+void main()
+{
+	// Same orientation as gl::drawBillboard, top of the image along wallUp
+	vTexCoord		= vec3( gl_Vertex.x * 0.5 + 0.5, 0.5 - gl_Vertex.y * 0.5, wallCenter.w );
+	vec3 position	= wallCenter.xyz + wallRight * gl_Vertex.x + wallUp * gl_Vertex.y;
+	gl_Position		= gl_ModelViewProjectionMatrix * vec4( position, 1.0 );
+	gl_FrontColor	= gl_Color;
+}
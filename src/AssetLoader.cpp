@@ -0,0 +1,522 @@
+//
+//  AssetLoader.cpp
+//  KinectTerrain
+//
+
+#include "AssetLoader.h"
+#include "Logger.h"
+#include "Hash.h"
+#include "ResourceRegistry.h"
+#include "cinder/Utilities.h"
+#include "cinder/ImageIo.h"
+#include "cinder/ip/Resize.h"
+#include <fstream>
+#include <string.h>
+
+using namespace ci;
+
+// Bump when the cache file layout changes so old entries miss instead of failing
+static const uint32_t CACHE_VERSION = 1;
+
+AssetLoader::AssetLoader()
+{
+	mNumPending				= 0;
+	mNumCriticalPending		= 0;
+	mIsRunning				= false;
+	mIsCacheAvailable		= false;
+	mIsCompressionSupported	= false;
+	mIsPboSupported			= false;
+}
+
+AssetLoader::~AssetLoader()
+{
+	shutdown();
+}
+
+void AssetLoader::setup( const fs::path &cacheDirectory, int numThreads )
+{
+	mCacheDirectory			= cacheDirectory;
+	mIsPboSupported			= gl::isExtensionAvailable( "GL_ARB_pixel_buffer_object" );
+	if( mIsPboSupported )
+		mPbo = gl::Vbo( GL_PIXEL_UNPACK_BUFFER_ARB );
+
+	try {
+		fs::create_directories( mCacheDirectory );
+		mIsCacheAvailable = true;
+	} catch( ... ) {
+		mIsCacheAvailable = false;
+	}
+	mIsCompressionSupported	= mIsCacheAvailable && gl::isExtensionAvailable( "GL_EXT_texture_compression_s3tc" );
+
+	Surface8u white( 1, 1, false );
+	white.setPixel( Vec2i( 0, 0 ), Color8u( 255, 255, 255 ) );
+	mPlaceholder = gl::Texture( white );
+
+	if( numThreads <= 0 )
+		numThreads = std::max( (int)std::thread::hardware_concurrency() - 1, 1 );
+
+	mIsRunning = true;
+	for( int i = 0; i < numThreads; i++ )
+		mWorkers.push_back( std::shared_ptr<std::thread>( new std::thread( &AssetLoader::workerThread, this ) ) );
+}
+
+void AssetLoader::shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock( mJobsMutex );
+		mIsRunning = false;
+		mJobs.clear();
+	}
+	mJobsCondition.notify_all();
+
+	for( size_t i = 0; i < mWorkers.size(); i++ )
+		mWorkers[i]->join();
+	mWorkers.clear();
+
+	std::lock_guard<std::mutex> lock( mResultsMutex );
+	mResults.clear();
+}
+
+void AssetLoader::loadTexture( gl::Texture *target, DataSourceRef source, bool isCritical, bool compress, const gl::Texture::Format &format )
+{
+	PendingTexture pending;
+	pending.mTarget		= target;
+	pending.mFormat		= format;
+	pending.mIsCritical	= isCritical;
+	pending.mCompress	= compress && mIsCompressionSupported;
+	pending.mName		= source->getFilePathHint().filename().string();
+	if( pending.mName.empty() )
+		pending.mName	= "texture " + toString( mTextures.size() );
+	mTextures.push_back( pending );
+
+	mNumPending++;
+	if( isCritical )
+		mNumCriticalPending++;
+	else
+		*target = mPlaceholder;
+
+	Job job;
+	job.mTexture	= (int)mTextures.size() - 1;
+	job.mCube		= -1;
+	job.mArray		= -1;
+	job.mFace		= 0;
+	job.mCompress	= pending.mCompress;
+	job.mSource		= source;
+
+	{
+		std::lock_guard<std::mutex> lock( mJobsMutex );
+		// Critical work jumps the queue so the first frame isn't held up by the rest
+		if( isCritical )
+			mJobs.push_front( job );
+		else
+			mJobs.push_back( job );
+	}
+	mJobsCondition.notify_one();
+}
+
+void AssetLoader::loadCubeMap( CubeMap *target, DataSourceRef faces[6], GLsizei faceSize, bool isCritical, const CubeMap::Format &format )
+{
+	// A cached container skips decoding and mip generation entirely. Hashing the
+	//  encoded faces is cheap next to decoding them, so it's done right here.
+	std::string cacheKey;
+	if( mIsCacheAvailable ){
+		uint8_t flags[3] = { format.mMipmap, format.mPrefilter, format.mCompress };
+		uint64_t hash = hashBytes( flags, sizeof( flags ) );
+		for( int i = 0; i < 6; i++ ){
+			Buffer &buffer = faces[i]->getBuffer();
+			hash = hashBytes( buffer.getData(), buffer.getDataSize(), hash );
+		}
+		cacheKey = hashToString( hash );
+
+		CubeMap cached = CubeMap::load( mCacheDirectory / ( cacheKey + ".cube" ) );
+		if( cached.getId() ){
+			*target = cached;
+			return;
+		}
+	}
+
+	PendingCube pending;
+	pending.mTarget		= target;
+	pending.mFormat		= format;
+	pending.mCacheKey	= cacheKey;
+	pending.mFaceSize	= faceSize;
+	pending.mNumFaces	= 0;
+	pending.mIsCritical	= isCritical;
+	mCubes.push_back( pending );
+
+	mNumPending++;
+	if( isCritical )
+		mNumCriticalPending++;
+
+	{
+		std::lock_guard<std::mutex> lock( mJobsMutex );
+		for( int i = 0; i < 6; i++ ){
+			Job job;
+			job.mTexture	= -1;
+			job.mCube		= (int)mCubes.size() - 1;
+			job.mArray		= -1;
+			job.mFace		= i;
+			job.mCompress	= false;
+			job.mSource		= faces[i];
+			if( isCritical )
+				mJobs.push_front( job );
+			else
+				mJobs.push_back( job );
+		}
+	}
+	mJobsCondition.notify_all();
+}
+
+void AssetLoader::loadTextureArray( TextureArray *target, const std::vector<DataSourceRef> &layers, int width, int height, bool isCritical, bool compress )
+{
+	// Cached as one container like cube maps, keyed by the encoded layers and how they're stored
+	std::string cacheKey;
+	if( mIsCacheAvailable ){
+		int32_t flags[3] = { width, height, compress };
+		uint64_t hash = hashBytes( flags, sizeof( flags ) );
+		for( size_t i = 0; i < layers.size(); i++ ){
+			Buffer &buffer = layers[i]->getBuffer();
+			hash = hashBytes( buffer.getData(), buffer.getDataSize(), hash );
+		}
+		cacheKey = hashToString( hash );
+
+		TextureArray cached = TextureArray::load( mCacheDirectory / ( cacheKey + ".tarr" ) );
+		if( cached.getId() ){
+			*target = cached;
+			return;
+		}
+	}
+
+	PendingArray pending;
+	pending.mTarget		= target;
+	pending.mCacheKey	= cacheKey;
+	pending.mLayers.resize( layers.size() );
+	pending.mWidth		= width;
+	pending.mHeight		= height;
+	pending.mNumLayers	= 0;
+	pending.mIsCritical	= isCritical;
+	pending.mCompress	= compress;
+	mArrays.push_back( pending );
+
+	mNumPending++;
+	if( isCritical )
+		mNumCriticalPending++;
+
+	{
+		std::lock_guard<std::mutex> lock( mJobsMutex );
+		for( size_t i = 0; i < layers.size(); i++ ){
+			Job job;
+			job.mTexture	= -1;
+			job.mCube		= -1;
+			job.mArray		= (int)mArrays.size() - 1;
+			job.mFace		= (int)i;
+			job.mSize		= Vec2i( width, height );
+			job.mCompress	= false;
+			job.mSource		= layers[i];
+			if( isCritical )
+				mJobs.push_front( job );
+			else
+				mJobs.push_back( job );
+		}
+	}
+	mJobsCondition.notify_all();
+}
+
+void AssetLoader::workerThread()
+{
+	while( true ){
+		Result result;
+		{
+			std::unique_lock<std::mutex> lock( mJobsMutex );
+			while( mIsRunning && mJobs.empty() )
+				mJobsCondition.wait( lock );
+			if( ! mIsRunning )
+				return;
+			result.mJob = mJobs.front();
+			mJobs.pop_front();
+		}
+
+		result.mCompressedFormat	= 0;
+		result.mWidth				= 0;
+		result.mHeight				= 0;
+		try {
+			if( ! readCache( result ) )
+				decode( result );
+		} catch( std::exception & ) {
+			const Job &job = result.mJob;
+			if( job.mCube >= 0 )
+				LOG_ERROR( "AssetLoader: failed to decode cube map %d face %d", job.mCube, job.mFace );
+			else if( job.mArray >= 0 )
+				LOG_ERROR( "AssetLoader: failed to decode texture array %d layer %d", job.mArray, job.mFace );
+			else
+				LOG_ERROR( "AssetLoader: failed to decode texture %d", job.mTexture );
+		}
+		result.mJob.mSource.reset();
+
+		{
+			std::lock_guard<std::mutex> lock( mResultsMutex );
+			mResults.push_back( result );
+		}
+		mResultsCondition.notify_one();
+	}
+}
+
+bool AssetLoader::readCache( Result &result )
+{
+	// Only textures that asked for compression are cached, cube faces never are
+	if( ! result.mJob.mCompress )
+		return false;
+
+	Buffer &buffer		= result.mJob.mSource->getBuffer();
+	result.mCacheKey	= hashToString( hashBytes( buffer.getData(), buffer.getDataSize() ) );
+
+	fs::path path = mCacheDirectory / ( result.mCacheKey + ".dxt" );
+	std::ifstream file( path.string().c_str(), std::ios::binary );
+	if( ! file )
+		return false;
+
+	uint32_t header[5];		// version, format, width, height, size
+	if( ! file.read( (char*)header, sizeof( header ) ) || header[0] != CACHE_VERSION || header[4] == 0 )
+		return false;
+
+	result.mCompressedFormat	= header[1];
+	result.mWidth				= header[2];
+	result.mHeight				= header[3];
+	result.mCompressed.resize( header[4] );
+	if( ! file.read( (char*)&result.mCompressed[0], header[4] ) ){
+		result.mCompressed.clear();
+		return false;
+	}
+	return true;
+}
+
+void AssetLoader::decode( Result &result )
+{
+	Surface8u decoded( loadImage( result.mJob.mSource ) );
+
+	// CubeMap uploads its faces as GL_RGB, TextureArray its layers as GL_RGBA
+	bool alpha = ( decoded.hasAlpha() && result.mJob.mCube < 0 ) || result.mJob.mArray >= 0;
+	SurfaceChannelOrder order = alpha ? SurfaceChannelOrder::RGBA : SurfaceChannelOrder::RGB;
+	if( decoded.hasAlpha() == alpha && decoded.getChannelOrder().getCode() == order.getCode() ){
+		result.mSurface = decoded;
+	} else {
+		result.mSurface = Surface8u( decoded.getWidth(), decoded.getHeight(), alpha, order );
+		result.mSurface.copyFrom( decoded, decoded.getBounds() );
+	}
+	// Array layers all have to be the same size
+	if( result.mJob.mArray >= 0 && result.mSurface.getSize() != result.mJob.mSize )
+		result.mSurface = ip::resize( result.mSurface, result.mSurface.getBounds(), result.mJob.mSize );
+
+	result.mWidth	= result.mSurface.getWidth();
+	result.mHeight	= result.mSurface.getHeight();
+}
+
+bool AssetLoader::popResult( Result *result )
+{
+	std::lock_guard<std::mutex> lock( mResultsMutex );
+	if( mResults.empty() )
+		return false;
+	*result = mResults.front();
+	mResults.pop_front();
+	return true;
+}
+
+void AssetLoader::update( int maxUploads )
+{
+	Result result;
+	for( int i = 0; i < maxUploads && popResult( &result ); i++ )
+		upload( result );
+}
+
+void AssetLoader::finishCritical()
+{
+	while( mNumCriticalPending > 0 ){
+		Result result;
+		{
+			std::unique_lock<std::mutex> lock( mResultsMutex );
+			while( mResults.empty() )
+				mResultsCondition.wait( lock );
+			result = mResults.front();
+			mResults.pop_front();
+		}
+		upload( result );
+	}
+}
+
+void AssetLoader::upload( Result &result )
+{
+	bool failed = ! result.mSurface && result.mCompressed.empty();
+
+	// TEXTURE
+	if( result.mJob.mTexture >= 0 ){
+		PendingTexture &pending = mTextures[result.mJob.mTexture];
+		// Critical targets are still empty, leaving them that way crashes the first bind
+		if( ! failed )
+			uploadTexture( result );
+		else
+			*pending.mTarget = mPlaceholder;
+		mNumPending--;
+		if( pending.mIsCritical )
+			mNumCriticalPending--;
+		return;
+	}
+
+	if( result.mJob.mCube >= 0 )
+		uploadCube( result );
+	else
+		uploadArray( result );
+}
+
+void AssetLoader::uploadCube( Result &result )
+{
+	// Built once all six faces are in
+	PendingCube &pending = mCubes[result.mJob.mCube];
+	pending.mFaces[result.mJob.mFace] = result.mSurface;
+	if( ++pending.mNumFaces < 6 )
+		return;
+
+	bool isComplete = true;
+	for( int i = 0; i < 6; i++ )
+		isComplete = isComplete && pending.mFaces[i];
+	if( isComplete ){
+		*pending.mTarget = CubeMap( pending.mFaceSize, pending.mFaceSize, pending.mFaces[0], pending.mFaces[1], pending.mFaces[2],
+									pending.mFaces[3], pending.mFaces[4], pending.mFaces[5], pending.mFormat );
+		if( ! pending.mCacheKey.empty() )
+			pending.mTarget->write( mCacheDirectory / ( pending.mCacheKey + ".cube" ) );
+	} else {
+		// A white 1x1 cube, like mPlaceholder, so binding it still works
+		LOG_ERROR( "AssetLoader: cube map %d is missing faces, using a placeholder", result.mJob.mCube );
+		Surface8u white( 1, 1, false );
+		white.setPixel( Vec2i( 0, 0 ), Color8u( 255, 255, 255 ) );
+		*pending.mTarget = CubeMap( 1, 1, white, white, white, white, white, white );
+	}
+	for( int i = 0; i < 6; i++ )
+		pending.mFaces[i] = Surface8u();
+
+	mNumPending--;
+	if( pending.mIsCritical )
+		mNumCriticalPending--;
+}
+
+void AssetLoader::uploadArray( Result &result )
+{
+	// Built once every layer is in, a layer that failed to decode is skipped
+	PendingArray &pending = mArrays[result.mJob.mArray];
+	pending.mLayers[result.mJob.mFace] = result.mSurface;
+	if( ++pending.mNumLayers < (int)pending.mLayers.size() )
+		return;
+
+	// A layer that failed would be cached blank, so only complete arrays are written
+	bool isComplete = true;
+	for( size_t i = 0; i < pending.mLayers.size(); i++ )
+		isComplete = isComplete && pending.mLayers[i];
+	*pending.mTarget = TextureArray( pending.mWidth, pending.mHeight, pending.mLayers, pending.mCompress );
+	if( isComplete && ! pending.mCacheKey.empty() )
+		pending.mTarget->write( mCacheDirectory / ( pending.mCacheKey + ".tarr" ) );
+	pending.mLayers.clear();
+
+	mNumPending--;
+	if( pending.mIsCritical )
+		mNumCriticalPending--;
+}
+
+void AssetLoader::uploadTexture( Result &result )
+{
+	PendingTexture &pending				= mTextures[result.mJob.mTexture];
+	const gl::Texture::Format &format	= pending.mFormat;
+	bool isCompressed					= ! result.mCompressed.empty();
+	bool hasAlpha						= ! isCompressed && result.mSurface.hasAlpha();
+
+	const uint8_t *data;
+	size_t size;
+	if( isCompressed ){
+		data	= &result.mCompressed[0];
+		size	= result.mCompressed.size();
+	} else {
+		data	= result.mSurface.getData();
+		size	= result.mSurface.getRowBytes() * result.mHeight;
+	}
+
+	GLuint texture;
+	glGenTextures( 1, &texture );
+	glBindTexture( GL_TEXTURE_2D, texture );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format.getWrapS() );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format.getWrapT() );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, format.getMinFilter() );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, format.getMagFilter() );
+
+	// Copy into the PBO so the driver can DMA from it instead of blocking on our memory
+	const GLvoid *pixels = data;
+	if( mIsPboSupported ){
+		mPbo.bind();
+		mPbo.bufferData( size, NULL, GL_STREAM_DRAW );
+		uint8_t *dest = mPbo.map( GL_WRITE_ONLY );
+		if( dest ){
+			memcpy( dest, data, size );
+			mPbo.unmap();
+			pixels = 0;
+		} else {
+			mPbo.unbind();
+		}
+	}
+
+	if( isCompressed ){
+		glCompressedTexImage2D( GL_TEXTURE_2D, 0, result.mCompressedFormat, result.mWidth, result.mHeight, 0, (GLsizei)size, pixels );
+	} else {
+		GLint internalFormat = hasAlpha ? GL_RGBA : GL_RGB;
+		if( pending.mCompress )
+			internalFormat = hasAlpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+
+		glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+		glPixelStorei( GL_UNPACK_ROW_LENGTH, result.mSurface.getRowBytes() / result.mSurface.getPixelInc() );
+		glTexImage2D( GL_TEXTURE_2D, 0, internalFormat, result.mWidth, result.mHeight, 0, hasAlpha ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, pixels );
+		glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+		glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+	}
+
+	if( mIsPboSupported )
+		mPbo.unbind();
+
+	if( format.hasMipmapping() )
+		glGenerateMipmapEXT( GL_TEXTURE_2D );
+
+	if( ! isCompressed && pending.mCompress )
+		writeCache( result.mCacheKey, texture, result.mWidth, result.mHeight );
+
+	// What the driver actually stored, compressed on upload or not
+	GLint storedFormat = 0, storedSize = 0, isStoredCompressed = GL_FALSE;
+	glGetTexLevelParameteriv( GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &storedFormat );
+	glGetTexLevelParameteriv( GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED_ARB, &isStoredCompressed );
+	if( isStoredCompressed == GL_TRUE )
+		glGetTexLevelParameteriv( GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED_IMAGE_SIZE_ARB, &storedSize );
+	else
+		storedSize = result.mWidth * result.mHeight * (GLint)ResourceRegistry::getBytesPerPixel( storedFormat );
+	// A full mip chain adds about a third
+	if( format.hasMipmapping() )
+		storedSize += storedSize / 3;
+
+	glBindTexture( GL_TEXTURE_2D, 0 );
+	*pending.mTarget = gl::Texture( GL_TEXTURE_2D, texture, result.mWidth, result.mHeight, false );
+	ResourceRegistry::add( ResourceRegistry::TEXTURE, texture, "AssetLoader", pending.mName, storedFormat, result.mWidth, result.mHeight, 1, storedSize,
+						   ResourceRegistry::getLifetime( *pending.mTarget ) );
+}
+
+void AssetLoader::writeCache( const std::string &key, GLuint texture, int width, int height )
+{
+	// The driver compressed it on upload, read the blocks back. Texture is still bound.
+	GLint isCompressed = GL_FALSE, size = 0, format = 0;
+	glGetTexLevelParameteriv( GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED_ARB, &isCompressed );
+	glGetTexLevelParameteriv( GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED_IMAGE_SIZE_ARB, &size );
+	glGetTexLevelParameteriv( GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format );
+	if( isCompressed != GL_TRUE || size <= 0 || key.empty() )
+		return;
+
+	std::vector<uint8_t> blocks( size );
+	glGetCompressedTexImage( GL_TEXTURE_2D, 0, &blocks[0] );
+
+	fs::path path = mCacheDirectory / ( key + ".dxt" );
+	std::ofstream file( path.string().c_str(), std::ios::binary | std::ios::trunc );
+	uint32_t header[5] = { CACHE_VERSION, (uint32_t)format, (uint32_t)width, (uint32_t)height, (uint32_t)size };
+	file.write( (const char*)header, sizeof( header ) );
+	file.write( (const char*)&blocks[0], size );
+}
@@ -0,0 +1,114 @@
+//
+//  Benchmark.cpp
+//  KinectTerrain
+//
+
+#include "Benchmark.h"
+#include "cinder/app/AppBasic.h"
+#include "cinder/gl/gl.h"
+#include "cinder/Utilities.h"
+#include "cinder/CinderMath.h"
+#include <fstream>
+#include <algorithm>
+#include <stdlib.h>
+
+using namespace ci;
+
+Benchmark::Benchmark()
+{
+	mIsEnabled		= false;
+	mNumFrames		= 0;
+	mFrame			= 0;
+	mSeed			= 1;
+	mTimeStep		= 1.0f / 30.0f;
+	mCaptureEvery	= 0;
+	mFrameStart		= 0.0;
+}
+
+void Benchmark::parseArgs( const std::vector<std::string> &args )
+{
+	for( size_t i = 0; i + 1 < args.size(); i++ ){
+		const std::string &arg	= args[i];
+		const std::string &val	= args[i+1];
+		if( arg == "--benchmark" ){
+			mIsEnabled	= true;
+			mNumFrames	= atoi( val.c_str() );
+		} else if( arg == "--seed" ){
+			mSeed		= (uint32_t)atoi( val.c_str() );
+		} else if( arg == "--capture" ){
+			mCaptureDir	= val;
+		} else if( arg == "--capture-every" ){
+			mCaptureEvery = atoi( val.c_str() );
+		}
+	}
+
+	if( mIsEnabled && ! mCaptureDir.empty() )
+		fs::create_directories( mCaptureDir );
+}
+
+Vec3f Benchmark::getHeadPosition()
+{
+	// Sweep an arc around the corner where the two screens meet, staying in front of both
+	float t		= mFrame / (float)std::max( mNumFrames - 1, 1 );
+	float angle	= t * (float)M_PI * 0.5f;
+	return Vec3f( -700.0f - sin( angle ) * 400.0f,
+				  sin( t * (float)M_PI * 4.0f ) * 60.0f,
+				   700.0f + cos( angle ) * 400.0f );
+}
+
+bool Benchmark::shouldCapture()
+{
+	if( mCaptureDir.empty() )
+		return false;
+	if( mCaptureEvery > 0 )
+		return mFrame % mCaptureEvery == 0;
+	return mFrame == mNumFrames - 1;
+}
+
+fs::path Benchmark::getCapturePath( int view )
+{
+	return mCaptureDir / ( "view" + toString( view ) + "_" + toString( mFrame ) + ".png" );
+}
+
+void Benchmark::beginFrame()
+{
+	mFrameStart = app::getElapsedSeconds();
+}
+
+void Benchmark::endFrame()
+{
+	// Wait for the GPU so the timing covers the whole frame
+	glFinish();
+	mFrameTimes.push_back( ( app::getElapsedSeconds() - mFrameStart ) * 1000.0 );
+	mFrame++;
+}
+
+void Benchmark::writeResults( const fs::path &path )
+{
+	std::vector<double> sorted = mFrameTimes;
+	std::sort( sorted.begin(), sorted.end() );
+
+	double total = 0.0;
+	for( size_t i = 0; i < sorted.size(); i++ )
+		total += sorted[i];
+
+	std::ofstream out( path.string().c_str() );
+	out << "{" << std::endl;
+	out << "  \"seed\": " << mSeed << "," << std::endl;
+	out << "  \"frames\": " << sorted.size() << "," << std::endl;
+	if( ! sorted.empty() ){
+		out << "  \"meanMs\": " << total / sorted.size() << "," << std::endl;
+		out << "  \"p50Ms\": " << sorted[sorted.size() / 2] << "," << std::endl;
+		out << "  \"p99Ms\": " << sorted[std::min( sorted.size() - 1, sorted.size() * 99 / 100 )] << "," << std::endl;
+		out << "  \"maxMs\": " << sorted.back() << "," << std::endl;
+	}
+	out << "  \"frameTimesMs\": [";
+	for( size_t i = 0; i < mFrameTimes.size(); i++ ){
+		out << mFrameTimes[i];
+		if( i + 1 < mFrameTimes.size() )
+			out << ", ";
+	}
+	out << "]" << std::endl << "}" << std::endl;
+
+	app::console() << "Benchmark: wrote " << path << std::endl;
+}
@@ -7,40 +7,295 @@
  *
  */
 
-#ifndef	CUBE_MAP_H
-#define CUBE_MAP_H
 #include "CubeMap.h"
+#include "GlProc.h"
+#include "ResourceRegistry.h"
+#include "cinder/CinderMath.h"
+#include <fstream>
+#include <vector>
+
+#ifndef GL_TEXTURE_CUBE_MAP_SEAMLESS
+	#define GL_TEXTURE_CUBE_MAP_SEAMLESS	0x884F
+#endif
 
 using ci::Surface8u;
-using boost::shared_ptr;
+using ci::Vec3f;
+using std::vector;
+
+typedef void ( APIENTRY *TexStorage2DProc )( GLenum target, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height );
+
+static const uint32_t CONTAINER_MAGIC	= 0x45425543;	// "CUBE"
+static const uint32_t CONTAINER_VERSION	= 1;
+
+// Faces are kept in GL order: +x, -x, +y, -y, +z, -z
+static Vec3f texelToDirection( int face, float s, float t )
+{
+	switch( face ){
+		case 0:		return Vec3f( 1.0f, -t, -s );
+		case 1:		return Vec3f(-1.0f, -t,  s );
+		case 2:		return Vec3f( s,  1.0f,  t );
+		case 3:		return Vec3f( s, -1.0f, -t );
+		case 4:		return Vec3f( s, -t,  1.0f );
+		default:	return Vec3f(-s, -t, -1.0f );
+	}
+}
+
+// Nearest texel of a face set for a direction, using the cube map selection rules from the GL spec
+static const uint8_t* sampleFaces( const vector<Surface8u> &faces, const Vec3f &dir )
+{
+	Vec3f a( fabs( dir.x ), fabs( dir.y ), fabs( dir.z ) );
+	int face;
+	float sc, tc, ma;
+	if( a.x >= a.y && a.x >= a.z ){
+		face = dir.x > 0.0f ? 0 : 1;	sc = dir.x > 0.0f ? -dir.z : dir.z;	tc = -dir.y;	ma = a.x;
+	} else if( a.y >= a.z ){
+		face = dir.y > 0.0f ? 2 : 3;	sc = dir.x;	tc = dir.y > 0.0f ? dir.z : -dir.z;	ma = a.y;
+	} else {
+		face = dir.z > 0.0f ? 4 : 5;	sc = dir.z > 0.0f ? dir.x : -dir.x;	tc = -dir.y;	ma = a.z;
+	}
+
+	const Surface8u &surface = faces[face];
+	int size	= surface.getWidth();
+	int x		= ci::math<int>::clamp( (int)( ( sc / ma + 1.0f ) * 0.5f * size ), 0, size - 1 );
+	int y		= ci::math<int>::clamp( (int)( ( tc / ma + 1.0f ) * 0.5f * size ), 0, size - 1 );
+	return surface.getData() + y * surface.getRowBytes() + x * 3;
+}
+
+// Builds one level from the one above it. With no cone it's a 2x2 box filter within the face,
+// otherwise it averages taps over a cone around each texel's direction, which crosses face edges.
+static vector<Surface8u> downsample( const vector<Surface8u> &src, float coneAngle )
+{
+	int size = std::max( src[0].getWidth() / 2, 1 );
+	vector<Surface8u> dst;
+	for( int face = 0; face < 6; face++ ){
+		Surface8u level( size, size, false, ci::SurfaceChannelOrder::RGB );
+		for( int y = 0; y < size; y++ ){
+			uint8_t *out = level.getData() + y * level.getRowBytes();
+			for( int x = 0; x < size; x++, out += 3 ){
+				int sum[3] = { 0, 0, 0 };
+				int count = 0;
+				if( coneAngle <= 0.0f ){
+					int srcSize = src[face].getWidth();
+					for( int j = 0; j < 2; j++ ){
+						for( int i = 0; i < 2; i++ ){
+							int sx = std::min( x * 2 + i, srcSize - 1 );
+							int sy = std::min( y * 2 + j, srcSize - 1 );
+							const uint8_t *p = src[face].getData() + sy * src[face].getRowBytes() + sx * 3;
+							sum[0] += p[0];	sum[1] += p[1];	sum[2] += p[2];
+							count++;
+						}
+					}
+				} else {
+					// Center tap plus two rings of eight
+					Vec3f n			= texelToDirection( face, ( x + 0.5f ) / size * 2.0f - 1.0f, ( y + 0.5f ) / size * 2.0f - 1.0f ).normalized();
+					Vec3f tangent	= ( fabs( n.y ) < 0.99f ? Vec3f::yAxis() : Vec3f::xAxis() ).cross( n ).normalized();
+					Vec3f bitangent	= n.cross( tangent );
+					for( int ring = 0; ring <= 2; ring++ ){
+						float theta = coneAngle * ring * 0.5f;
+						int taps = ring == 0 ? 1 : 8;
+						for( int k = 0; k < taps; k++ ){
+							float phi = k * (float)M_PI * 2.0f / taps;
+							Vec3f dir = n * cos( theta ) + ( tangent * cos( phi ) + bitangent * sin( phi ) ) * sin( theta );
+							const uint8_t *p = sampleFaces( src, dir );
+							sum[0] += p[0];	sum[1] += p[1];	sum[2] += p[2];
+							count++;
+						}
+					}
+				}
+				out[0] = sum[0] / count;
+				out[1] = sum[1] / count;
+				out[2] = sum[2] / count;
+			}
+		}
+		dst.push_back( level );
+	}
+	return dst;
+}
+
+static void enableSeamless()
+{
+	// Filters across face edges so the coarse levels don't show seams
+	if( ci::gl::isExtensionAvailable( "GL_ARB_seamless_cube_map" ) )
+		glEnable( GL_TEXTURE_CUBE_MAP_SEAMLESS );
+}
+
+CubeMap::Obj::~Obj()
+{
+	if( mId )
+		glDeleteTextures( 1, &mId );
+}
 
 CubeMap::CubeMap(){}
-CubeMap::CubeMap( GLsizei texWidth, GLsizei texHeight, const Surface8u &pos_x, const Surface8u &pos_y, const Surface8u &pos_z, const Surface8u &neg_x, const Surface8u &neg_y, const Surface8u &neg_z )
-{	
+CubeMap::CubeMap( GLsizei texWidth, GLsizei texHeight, const Surface8u &pos_x, const Surface8u &pos_y, const Surface8u &pos_z, const Surface8u &neg_x, const Surface8u &neg_y, const Surface8u &neg_z, const Format &format )
+{
+	int numLevels = 1;
+	if( format.mMipmap ){
+		for( GLsizei s = texWidth; s > 1; s /= 2 )
+			numLevels++;
+	}
+	bool compress = format.mCompress && ci::gl::isExtensionAvailable( "GL_EXT_texture_compression_s3tc" );
+	allocate( texWidth, numLevels, compress ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_RGB8 );
+
+	vector<Surface8u> faces;
+	faces.push_back( pos_x );	faces.push_back( neg_x );
+	faces.push_back( pos_y );	faces.push_back( neg_y );
+	faces.push_back( pos_z );	faces.push_back( neg_z );
+
+	// The mips are built here rather than with glGenerateMipmap, which not every driver supports on DXT
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+	for( int level = 0; level < numLevels; level++ ){
+		if( level > 0 ){
+			float roughness = level / (float)( numLevels - 1 );
+			faces = downsample( faces, format.mPrefilter ? roughness * (float)M_PI * 0.25f : 0.0f );
+		}
+		GLsizei size = faces[0].getWidth();
+		for( int face = 0; face < 6; face++ ){
+			glPixelStorei( GL_UNPACK_ROW_LENGTH, faces[face].getRowBytes() / 3 );
+			glTexSubImage2D( GL_TEXTURE_CUBE_MAP_POSITIVE_X_ARB + face, level, 0, 0, size, size, GL_RGB, GL_UNSIGNED_BYTE, faces[face].getData() );
+		}
+	}
+	glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+	glBindTexture( GL_TEXTURE_CUBE_MAP_ARB, 0 );
+}
+
+void CubeMap::allocate( GLsizei size, int numLevels, GLenum internalFormat )
+{
+	mObj = std::shared_ptr<Obj>( new Obj );
+	mObj->mSize				= size;
+	mObj->mNumLevels		= numLevels;
+	mObj->mInternalFormat	= internalFormat;
+
 	//create a texture object
-	glGenTextures(1, &textureObject);
-	glBindTexture(GL_TEXTURE_CUBE_MAP_ARB, textureObject);
-	//assign the images to positions
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X_ARB, 0, GL_RGBA, texWidth, texHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, pos_x.getData());
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_X_ARB, 0, GL_RGBA, texWidth, texHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, neg_x.getData());
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Y_ARB, 0, GL_RGBA, texWidth, texHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, pos_y.getData());
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Y_ARB, 0, GL_RGBA, texWidth, texHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, neg_y.getData());
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Z_ARB, 0, GL_RGBA, texWidth, texHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, pos_z.getData());
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Z_ARB, 0, GL_RGBA, texWidth, texHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, neg_z.getData());
+	glGenTextures( 1, &mObj->mId );
+	glBindTexture( GL_TEXTURE_CUBE_MAP_ARB, mObj->mId );
+
+	// DXT1 is 8 bytes per 4x4 block, even for the smallest levels
+	size_t bytes = 0;
+	for( int level = 0; level < numLevels; level++ ){
+		size_t levelSize = std::max( size >> level, 1 );
+		if( internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT )
+			bytes += 6 * ( ( levelSize + 3 ) / 4 ) * ( ( levelSize + 3 ) / 4 ) * 8;
+		else
+			bytes += 6 * levelSize * levelSize * ResourceRegistry::getBytesPerPixel( internalFormat );
+	}
+	ResourceRegistry::add( ResourceRegistry::TEXTURE, mObj->mId, "CubeMap", "cube map", internalFormat, size, size, 6, bytes, mObj );
+
+	static TexStorage2DProc sTexStorage2D = ci::gl::isExtensionAvailable( "GL_ARB_texture_storage" ) ? (TexStorage2DProc)getGlProcAddress( "glTexStorage2D" ) : NULL;
+	if( sTexStorage2D ){
+		sTexStorage2D( GL_TEXTURE_CUBE_MAP_ARB, numLevels, internalFormat, size, size );
+	} else {
+		for( int level = 0; level < numLevels; level++ ){
+			GLsizei levelSize = std::max( size >> level, 1 );
+			for( int face = 0; face < 6; face++ )
+				glTexImage2D( GL_TEXTURE_CUBE_MAP_POSITIVE_X_ARB + face, level, internalFormat, levelSize, levelSize, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL );
+		}
+		glTexParameteri( GL_TEXTURE_CUBE_MAP_ARB, GL_TEXTURE_MAX_LEVEL, numLevels - 1 );
+	}
+
 	//set filtering modes for scaling up and down
-	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARB, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARB, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri( GL_TEXTURE_CUBE_MAP_ARB, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_CUBE_MAP_ARB, GL_TEXTURE_MIN_FILTER, numLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_CUBE_MAP_ARB, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_CUBE_MAP_ARB, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_CUBE_MAP_ARB, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE );
+	enableSeamless();
+}
+
+CubeMap CubeMap::load( const ci::fs::path &path )
+{
+	std::ifstream file( path.string().c_str(), std::ios::binary );
+	if( ! file )
+		return CubeMap();
+
+	uint32_t header[5];		// magic, version, size, levels, internal format
+	if( ! file.read( (char*)header, sizeof( header ) ) || header[0] != CONTAINER_MAGIC || header[1] != CONTAINER_VERSION )
+		return CubeMap();
+
+	GLenum internalFormat	= header[4];
+	bool isCompressed		= internalFormat != GL_RGB8;
+	if( isCompressed && ! ci::gl::isExtensionAvailable( "GL_EXT_texture_compression_s3tc" ) )
+		return CubeMap();
+
+	CubeMap cubeMap;
+	cubeMap.allocate( header[2], header[3], internalFormat );
+
+	// A truncated file stops the loops instead of returning, so the state below is always restored
+	bool isValid = true;
+	vector<char> data;
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+	for( uint32_t level = 0; isValid && level < header[3]; level++ ){
+		GLsizei size = std::max( (GLsizei)header[2] >> level, 1 );
+		for( int face = 0; face < 6; face++ ){
+			uint32_t dataSize;
+			isValid = file.read( (char*)&dataSize, sizeof( dataSize ) ) && dataSize > 0;
+			if( isValid ){
+				data.resize( dataSize );
+				isValid = (bool)file.read( &data[0], dataSize );
+			}
+			if( ! isValid )
+				break;
+
+			GLenum target = GL_TEXTURE_CUBE_MAP_POSITIVE_X_ARB + face;
+			if( isCompressed )
+				glCompressedTexSubImage2D( target, level, 0, 0, size, size, internalFormat, dataSize, &data[0] );
+			else
+				glTexSubImage2D( target, level, 0, 0, size, size, GL_RGB, GL_UNSIGNED_BYTE, &data[0] );
+		}
+	}
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+	glBindTexture( GL_TEXTURE_CUBE_MAP_ARB, 0 );
+	return isValid ? cubeMap : CubeMap();
+}
+
+bool CubeMap::write( const ci::fs::path &path )
+{
+	if( ! mObj )
+		return false;
+
+	std::ofstream file( path.string().c_str(), std::ios::binary | std::ios::trunc );
+	if( ! file )
+		return false;
+
+	uint32_t header[5] = { CONTAINER_MAGIC, CONTAINER_VERSION, (uint32_t)mObj->mSize, (uint32_t)mObj->mNumLevels, mObj->mInternalFormat };
+	file.write( (const char*)header, sizeof( header ) );
+
+	bool isCompressed = mObj->mInternalFormat != GL_RGB8;
+	vector<char> data;
+	glBindTexture( GL_TEXTURE_CUBE_MAP_ARB, mObj->mId );
+	glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+	for( int level = 0; level < mObj->mNumLevels; level++ ){
+		GLsizei size = std::max( mObj->mSize >> level, 1 );
+		for( int face = 0; face < 6; face++ ){
+			GLenum target = GL_TEXTURE_CUBE_MAP_POSITIVE_X_ARB + face;
+			GLint dataSize = size * size * 3;
+			if( isCompressed )
+				glGetTexLevelParameteriv( target, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE_ARB, &dataSize );
+			data.resize( dataSize );
+			if( isCompressed )
+				glGetCompressedTexImage( target, level, &data[0] );
+			else
+				glGetTexImage( target, level, GL_RGB, GL_UNSIGNED_BYTE, &data[0] );
+
+			uint32_t size32 = dataSize;
+			file.write( (const char*)&size32, sizeof( size32 ) );
+			file.write( &data[0], dataSize );
+		}
+	}
+	glPixelStorei( GL_PACK_ALIGNMENT, 4 );
+	glBindTexture( GL_TEXTURE_CUBE_MAP_ARB, 0 );
+	return (bool)file;
 }
 
 void CubeMap::bindMulti( int pos )
 {
 	glActiveTexture(GL_TEXTURE0 + pos );
-	glBindTexture(GL_TEXTURE_CUBE_MAP_ARB, textureObject);
+	glBindTexture(GL_TEXTURE_CUBE_MAP_ARB, getId());
 }
 
 void CubeMap::bind()
 {
-	glBindTexture(GL_TEXTURE_CUBE_MAP_ARB, textureObject);
+	glBindTexture(GL_TEXTURE_CUBE_MAP_ARB, getId());
 }
 
 void CubeMap::unbind()
@@ -66,6 +321,3 @@ void CubeMap::disableFixedMapping()
 	glDisable(GL_TEXTURE_GEN_R);
 	glDisable( GL_TEXTURE_CUBE_MAP );
 }
-
-
-#endif
@@ -0,0 +1,139 @@
+//
+//  DisplayConfig.cpp
+//  KinectTerrain
+//
+
+#include "DisplayConfig.h"
+#include "cinder/app/AppBasic.h"
+#include "cinder/Json.h"
+#include <algorithm>
+
+using namespace ci;
+
+Vec3f DisplayWall::getNormal() const
+{
+	// Same orientation HeadCam uses, pointing out of the wall towards the viewer
+	Vec3f vUp		= mTopLeft - mBottomLeft;
+	Vec3f vRight	= mBottomRight - mBottomLeft;
+	return vRight.cross( vUp ).normalized();
+}
+
+Area DisplayWall::getWindowArea( const Vec2i &windowSize ) const
+{
+	return Area( (int)( mViewport.x1 * windowSize.x ), (int)( mViewport.y1 * windowSize.y ),
+				 (int)( mViewport.x2 * windowSize.x ), (int)( mViewport.y2 * windowSize.y ) );
+}
+
+Area DisplayWall::getViewportArea( const Vec2i &windowSize ) const
+{
+	// GL counts up from the bottom of the window
+	Area area = getWindowArea( windowSize );
+	return Area( area.x1, windowSize.y - area.y2, area.x2, windowSize.y - area.y1 );
+}
+
+DisplayConfig::DisplayConfig()
+{
+}
+
+void DisplayConfig::setupDefault( const Vec3f &roomSize, float aspectRatio )
+{
+	float W = roomSize.x / 2;
+	float H = roomSize.y / 2;
+	float D = roomSize.z / 2;
+
+	mWalls.clear();
+
+	// Screen 1, facing +z, drawn on the right half of the window
+	DisplayWall wall0;
+	wall0.mTopLeft		= Vec3f(-W, H, D );
+	wall0.mBottomLeft	= Vec3f(-W,-H, D );
+	wall0.mBottomRight	= Vec3f( W,-H, D );
+	wall0.mViewport		= Rectf( 0.5f, 0.0f, 1.0f, 1.0f );
+	wall0.mWindow		= 0;
+	wall0.mDefaultEye	= Vec3f( 0, 0, 1200 );
+	wall0.mCam			= HeadCam( 1210.0f, aspectRatio );
+	wall0.mCam.mEye		= Vec3f(-1200, 0, 1200 );
+	wall0.mCam.mCenter	= Vec3f::zero();
+	mWalls.push_back( wall0 );
+
+	// Screen 2, facing -x, drawn on the left half of the window
+	DisplayWall wall1;
+	wall1.mTopLeft		= Vec3f(-W, H,-D );
+	wall1.mBottomLeft	= Vec3f(-W,-H,-D );
+	wall1.mBottomRight	= Vec3f(-W,-H, D );
+	wall1.mViewport		= Rectf( 0.0f, 0.0f, 0.5f, 1.0f );
+	wall1.mWindow		= 0;
+	wall1.mDefaultEye	= Vec3f(-1200, 0, 0 );
+	wall1.mCam			= HeadCam( 1200.0f, aspectRatio );
+	wall1.mCam.mEye		= Vec3f(-1210, 0, 0 );
+	wall1.mCam.mCenter	= Vec3f::zero();
+	mWalls.push_back( wall1 );
+}
+
+static Vec3f vec3FromJson( const JsonTree &tree )
+{
+	return Vec3f( tree.getValueAtIndex<float>( 0 ), tree.getValueAtIndex<float>( 1 ), tree.getValueAtIndex<float>( 2 ) );
+}
+
+bool DisplayConfig::load( const fs::path &path, float aspectRatio )
+{
+	std::vector<DisplayWall> walls;
+	try {
+		JsonTree json( loadFile( path ) );
+		const JsonTree &wallsJson = json.getChild( "walls" );
+		for( JsonTree::ConstIter it = wallsJson.begin(); it != wallsJson.end(); ++it ){
+			DisplayWall wall;
+			wall.mTopLeft		= vec3FromJson( it->getChild( "topLeft" ) );
+			wall.mBottomLeft	= vec3FromJson( it->getChild( "bottomLeft" ) );
+			wall.mBottomRight	= vec3FromJson( it->getChild( "bottomRight" ) );
+			const JsonTree &vp	= it->getChild( "viewport" );
+			wall.mViewport		= Rectf( vp.getValueAtIndex<float>( 0 ), vp.getValueAtIndex<float>( 1 ),
+										 vp.getValueAtIndex<float>( 2 ), vp.getValueAtIndex<float>( 3 ) );
+			wall.mWindow		= it->hasChild( "window" ) ? it->getChild( "window" ).getValue<int>() : 0;
+
+			// Without an explicit default, park the eye 1200 units out from the wall's center
+			Vec3f center		= ( wall.mTopLeft + wall.mBottomRight ) * 0.5f;
+			wall.mDefaultEye	= it->hasChild( "defaultEye" ) ? vec3FromJson( it->getChild( "defaultEye" ) ) : center + wall.getNormal() * 1200.0f;
+			wall.mCam			= HeadCam( ( wall.mDefaultEye - center ).length(), aspectRatio );
+			wall.mCam.mEye		= wall.mDefaultEye;
+			wall.mCam.mCenter	= center;
+			walls.push_back( wall );
+		}
+	} catch( ci::Exception &exc ) {
+		app::console() << "DisplayConfig: unable to load " << path << ": " << exc.what() << std::endl;
+		return false;
+	}
+
+	if( walls.empty() )
+		return false;
+
+	mWalls = walls;
+	return true;
+}
+
+void DisplayConfig::setHeadPosition( const Vec3f &headPos )
+{
+	for( size_t i = 0; i < mWalls.size(); i++ ){
+		DisplayWall &wall = mWalls[i];
+		if( ( headPos - wall.mBottomLeft ).dot( wall.getNormal() ) > 0.0f )
+			wall.mCam.setEye( headPos );
+		else
+			wall.mCam.mEye = wall.mDefaultEye;
+	}
+}
+
+void DisplayConfig::update( float farClip )
+{
+	for( size_t i = 0; i < mWalls.size(); i++ ){
+		DisplayWall &wall = mWalls[i];
+		wall.mCam.update( wall.mTopLeft, wall.mBottomLeft, wall.mBottomRight, farClip );
+	}
+}
+
+int DisplayConfig::getNumWindows()
+{
+	int numWindows = 1;
+	for( size_t i = 0; i < mWalls.size(); i++ )
+		numWindows = std::max( numWindows, mWalls[i].mWindow + 1 );
+	return numWindows;
+}
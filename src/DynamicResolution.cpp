@@ -0,0 +1,117 @@
+//
+//  DynamicResolution.cpp
+//  KinectTerrain
+//
+
+#include "DynamicResolution.h"
+#include "Logger.h"
+#include "ResourceRegistry.h"
+#include "cinder/CinderMath.h"
+#include "cinder/Utilities.h"
+
+using namespace ci;
+
+DynamicResolution::DynamicResolution()
+{
+	mScale				= 1.0f;
+	mMinScale			= 0.5f;
+	mMaxScale			= 1.0f;
+	mTargetMs			= 30.0f;
+	mDeadBand			= 0.1f;
+	mStep				= 0.05f;
+	mInterval			= 30;
+	mFramesSinceChange	= 0;
+	mIsEnabled			= false;
+}
+
+void DynamicResolution::setup( float targetMs, float minScale, float maxScale )
+{
+	mTargetMs	= targetMs;
+	mMinScale	= minScale;
+	mMaxScale	= maxScale;
+	mScale		= maxScale;
+	mIsEnabled	= true;
+}
+
+void DynamicResolution::setEnabled( bool enabled )
+{
+	mIsEnabled			= enabled;
+	mScale				= mMaxScale;
+	mFramesSinceChange	= 0;
+}
+
+void DynamicResolution::update( float gpuMs )
+{
+	if( ! mIsEnabled || gpuMs <= 0.0f )
+		return;
+	if( ++mFramesSinceChange < mInterval )
+		return;
+
+	float ratio = mTargetMs / gpuMs;
+	if( fabs( ratio - 1.0f ) < mDeadBand )
+		return;
+
+	// GPU time goes roughly with pixel count, so with the square of the scale.
+	//  Limit each move so one bad frame average can't swing it end to end.
+	float scale = mScale * math<float>::sqrt( ratio );
+	scale = math<float>::clamp( scale, mScale - 0.1f, mScale + 0.1f );
+	scale = math<float>::floor( scale / mStep + 0.5f ) * mStep;
+	scale = math<float>::clamp( scale, mMinScale, mMaxScale );
+	if( fabs( scale - mScale ) < mStep * 0.5f )
+		return;
+
+	LOG_INFO( "DynamicResolution: scale %g -> %g, gpu %g ms, target %g ms", mScale, scale, gpuMs, mTargetMs );
+	mScale				= scale;
+	mFramesSinceChange	= 0;
+}
+
+Vec2i DynamicResolution::getRenderSize( const Vec2i &viewportSize )
+{
+	return Vec2i( std::max( (int)( viewportSize.x * mScale ), 1 ), std::max( (int)( viewportSize.y * mScale ), 1 ) );
+}
+
+void DynamicResolution::bind( int view, const Vec2i &viewportSize )
+{
+	if( (int)mTargets.size() <= view ){
+		mTargets.resize( view + 1 );
+		mRenderSizes.resize( view + 1 );
+	}
+
+	// Full size, only reallocated when the viewport itself changes
+	gl::Fbo &target = mTargets[view];
+	if( ! target || target.getSize() != viewportSize ){
+		target = gl::Fbo( viewportSize.x, viewportSize.y );
+		ResourceRegistry::addFbo( target, "DynamicResolution", "view " + toString( view ) );
+	}
+
+	mRenderSizes[view] = getRenderSize( viewportSize );
+	target.bindFramebuffer();
+	gl::setViewport( Area( Vec2i::zero(), mRenderSizes[view] ) );
+}
+
+void DynamicResolution::unbind( int view )
+{
+	mTargets[view].unbindFramebuffer();
+}
+
+void DynamicResolution::drawUpscaled( int view, gl::GlslProg &shader )
+{
+	gl::Fbo &target		= mTargets[view];
+	Vec2i renderSize	= mRenderSizes[view];
+
+	// Nothing to recover at full scale, up to a moderate unsharp mask at half scale
+	float sharpness = math<float>::clamp( ( 1.0f / mScale - 1.0f ) * 0.5f, 0.0f, 0.5f );
+
+	gl::pushMatrices();
+	gl::setMatricesWindow( Vec2i( 1, 1 ), false );
+	target.bindTexture();
+	shader.bind();
+	shader.uniform( "tex", 0 );
+	shader.uniform( "uvScale", Vec2f( renderSize.x / (float)target.getWidth(), renderSize.y / (float)target.getHeight() ) );
+	shader.uniform( "texelSize", Vec2f( 1.0f / target.getWidth(), 1.0f / target.getHeight() ) );
+	shader.uniform( "sharpness", sharpness );
+	gl::drawSolidRect( Rectf( 0.0f, 0.0f, 1.0f, 1.0f ) );
+	shader.unbind();
+	target.unbindTexture();
+	gl::popMatrices();
+}
@@ -0,0 +1,194 @@
+//
+//  GpuProfiler.cpp
+//  KinectTerrain
+//
+
+#include "GpuProfiler.h"
+#include "cinder/app/AppBasic.h"
+#include <fstream>
+#include <algorithm>
+#include <assert.h>
+
+using namespace ci;
+
+GpuProfiler::GpuProfiler()
+{
+	mWindowSize		= 60;
+	mMaxTraceEvents	= 20000;
+	mFrame			= 0;
+	mActiveStage	= -1;
+	mIsEnabled		= false;
+	mIsSupported	= false;
+}
+
+GpuProfiler::~GpuProfiler()
+{
+	for( size_t i = 0; i < mStages.size(); i++ ){
+		glDeleteQueries( 2, mStages[i].mQueries );
+	}
+}
+
+void GpuProfiler::setup( int windowSize, int maxTraceEvents )
+{
+	mWindowSize		= windowSize;
+	mMaxTraceEvents	= maxTraceEvents;
+	mIsSupported	= gl::isExtensionAvailable( "GL_EXT_timer_query" ) || gl::isExtensionAvailable( "GL_ARB_timer_query" );
+	mIsEnabled		= mIsSupported;
+	mTrace.reserve( mMaxTraceEvents );
+
+	if( ! mIsSupported )
+		app::console() << "GpuProfiler: timer queries not supported, profiling disabled" << std::endl;
+}
+
+int GpuProfiler::findOrCreateStage( const std::string &name )
+{
+	std::map<std::string, int>::iterator it = mStageIndices.find( name );
+	if( it != mStageIndices.end() )
+		return it->second;
+
+	Stage stage;
+	stage.mName			= name;
+	glGenQueries( 2, stage.mQueries );
+	stage.mIssued[0]	= stage.mIssued[1] = false;
+	stage.mCpuTimes[0]	= stage.mCpuTimes[1] = 0.0;
+	stage.mSamples.assign( mWindowSize, 0.0f );
+	stage.mSampleIndex	= 0;
+	stage.mSampleCount	= 0;
+	stage.mLastMs		= 0.0f;
+
+	mStages.push_back( stage );
+	mStageIndices[name] = (int)mStages.size() - 1;
+	return (int)mStages.size() - 1;
+}
+
+void GpuProfiler::collect( Stage &stage, int buffer, int stageIndex )
+{
+	if( ! stage.mIssued[buffer] )
+		return;
+	stage.mIssued[buffer] = false;
+
+	// The query was issued a full frame ago so it is almost always ready. If not, drop the
+	// sample rather than stall the pipeline.
+	GLint available = 0;
+	glGetQueryObjectiv( stage.mQueries[buffer], GL_QUERY_RESULT_AVAILABLE, &available );
+	if( ! available )
+		return;
+
+	GLuint64EXT elapsedNs = 0;
+	glGetQueryObjectui64vEXT( stage.mQueries[buffer], GL_QUERY_RESULT, &elapsedNs );
+
+	float ms					= (float)( elapsedNs / 1000000.0 );
+	stage.mLastMs				= ms;
+	stage.mSamples[stage.mSampleIndex] = ms;
+	stage.mSampleIndex			= ( stage.mSampleIndex + 1 ) % mWindowSize;
+	stage.mSampleCount			= std::min( stage.mSampleCount + 1, mWindowSize );
+
+	if( (int)mTrace.size() < mMaxTraceEvents ){
+		TraceEvent event;
+		event.mStage	= stageIndex;
+		event.mCpuTime	= stage.mCpuTimes[buffer];
+		event.mGpuMs	= ms;
+		mTrace.push_back( event );
+	}
+}
+
+void GpuProfiler::beginFrame()
+{
+	if( ! mIsEnabled )
+		return;
+
+	assert( mActiveStage == -1 );
+
+	mFrame++;
+	// The buffer written this frame is the one we read last frame's results from
+	int buffer = mFrame % 2;
+	for( size_t i = 0; i < mStages.size(); i++ ){
+		collect( mStages[i], buffer, (int)i );
+	}
+}
+
+void GpuProfiler::begin( const std::string &name )
+{
+	if( ! mIsEnabled )
+		return;
+
+	// GL_TIME_ELAPSED queries can't nest
+	assert( mActiveStage == -1 );
+
+	mActiveStage	= findOrCreateStage( name );
+	Stage &stage	= mStages[mActiveStage];
+	int buffer		= mFrame % 2;
+	stage.mCpuTimes[buffer] = app::getElapsedSeconds();
+	glBeginQuery( GL_TIME_ELAPSED_EXT, stage.mQueries[buffer] );
+}
+
+void GpuProfiler::end()
+{
+	if( ! mIsEnabled || mActiveStage == -1 )
+		return;
+
+	glEndQuery( GL_TIME_ELAPSED_EXT );
+	mStages[mActiveStage].mIssued[mFrame % 2] = true;
+	mActiveStage = -1;
+}
+
+float GpuProfiler::getAverageMs( const std::string &name )
+{
+	std::map<std::string, int>::iterator it = mStageIndices.find( name );
+	if( it == mStageIndices.end() )
+		return 0.0f;
+
+	const Stage &stage = mStages[it->second];
+	if( stage.mSampleCount == 0 )
+		return 0.0f;
+
+	float total = 0.0f;
+	for( int i = 0; i < stage.mSampleCount; i++ ){
+		total += stage.mSamples[i];
+	}
+	return total / (float)stage.mSampleCount;
+}
+
+float GpuProfiler::getTotalAverageMs()
+{
+	float total = 0.0f;
+	for( size_t i = 0; i < mStages.size(); i++ ){
+		total += getAverageMs( mStages[i].mName );
+	}
+	return total;
+}
+
+float GpuProfiler::getAverageMsWithPrefix( const std::string &prefix )
+{
+	float total = 0.0f;
+	for( size_t i = 0; i < mStages.size(); i++ ){
+		if( mStages[i].mName.compare( 0, prefix.size(), prefix ) == 0 )
+			total += getAverageMs( mStages[i].mName );
+	}
+	return total;
+}
+
+void GpuProfiler::writeChromeTrace( const fs::path &path )
+{
+	std::ofstream out( path.string().c_str() );
+	if( ! out ){
+		app::console() << "GpuProfiler: unable to write " << path << std::endl;
+		return;
+	}
+
+	// Timestamps are the CPU submit time of each stage, durations are measured on the GPU
+	out << "{\"traceEvents\":[" << std::endl;
+	for( size_t i = 0; i < mTrace.size(); i++ ){
+		const TraceEvent &event = mTrace[i];
+		out << "{\"name\":\"" << mStages[event.mStage].mName << "\",\"cat\":\"gpu\",\"ph\":\"X\""
+			<< ",\"ts\":" << (long long)( event.mCpuTime * 1000000.0 )
+			<< ",\"dur\":" << (long long)( event.mGpuMs * 1000.0f )
+			<< ",\"pid\":0,\"tid\":0}";
+		if( i + 1 < mTrace.size() )
+			out << ",";
+		out << std::endl;
+	}
+	out << "],\"displayTimeUnit\":\"ms\"}" << std::endl;
+
+	app::console() << "GpuProfiler: wrote " << mTrace.size() << " events to " << path << std::endl;
+}
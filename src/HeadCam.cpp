@@ -7,6 +7,7 @@
 //
 
 #include "HeadCam.h"
+#include "Logger.h"
 
 using namespace ci;
 
@@ -155,8 +156,7 @@ void HeadCam::calculateProjectionMatrix(Vec3f topLeft, Vec3f bottomLeft, Vec3f b
 
 	n = -vTopLeft.dot(planeNormal);
 
-	app::console() << "n" << n << std::endl;
-	app::console() << "planeNormal" << planeNormal << std::endl;
+	LOG_DEBUG_EVERY( 1.0, "n %g planeNormal [%g,%g,%g]", n, planeNormal.x, planeNormal.y, planeNormal.z );
 
 	l = vRight.dot(vBottomLeft);
 	r = vRight.dot(vBottomRight);
@@ -0,0 +1,108 @@
+//
+//  HeadPoseFilter.cpp
+//  KinectTerrain
+//
+
+#include "HeadPoseFilter.h"
+#include "cinder/CinderMath.h"
+
+using namespace ci;
+
+// Velocity for prediction is fit over this much recent history
+static const double VELOCITY_WINDOW = 0.1;
+
+static float smoothingFactor( float cutoff, float dt )
+{
+	float tau = 1.0f / ( 2.0f * (float)M_PI * cutoff );
+	return 1.0f / ( 1.0f + tau / dt );
+}
+
+HeadPoseFilter::HeadPoseFilter()
+{
+	reset();
+}
+
+void HeadPoseFilter::reset()
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	mNewest		= -1;
+	mNumSamples	= 0;
+	mDerivative	= Vec3f::zero();
+}
+
+void HeadPoseFilter::setParams( const Params &params )
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	mParams = params;
+}
+
+HeadPoseFilter::Params HeadPoseFilter::getParams()
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return mParams;
+}
+
+void HeadPoseFilter::addSample( const Vec3f &position, double time )
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+
+	Vec3f filtered = position;
+	if( mNumSamples > 0 ){
+		const Sample &prev = mHistory[mNewest];
+		float dt = (float)( time - prev.mTime );
+		if( dt <= 0.0f )
+			return;
+
+		Vec3f rawDerivative	= ( position - prev.mPosition ) / dt;
+		mDerivative			= mDerivative.lerp( smoothingFactor( mParams.mDerivativeCutoff, dt ), rawDerivative );
+		float cutoff		= mParams.mMinCutoff + mParams.mBeta * mDerivative.length();
+		filtered			= prev.mPosition.lerp( smoothingFactor( cutoff, dt ), position );
+	}
+
+	mNewest						= ( mNewest + 1 ) % HISTORY_SIZE;
+	mHistory[mNewest].mPosition	= filtered;
+	mHistory[mNewest].mTime		= time;
+	mNumSamples					= std::min( mNumSamples + 1, (int)HISTORY_SIZE );
+}
+
+Vec3f HeadPoseFilter::getVelocity()
+{
+	// Least squares slope over the samples in the window, steadier than the last difference
+	const Sample &newest = mHistory[mNewest];
+	double sumT = 0.0, sumTT = 0.0;
+	Vec3f sumP = Vec3f::zero(), sumTP = Vec3f::zero();
+	int count = 0;
+	for( int i = 0; i < mNumSamples; i++ ){
+		const Sample &s = mHistory[( mNewest - i + HISTORY_SIZE ) % HISTORY_SIZE];
+		double t = s.mTime - newest.mTime;
+		if( t < -VELOCITY_WINDOW )
+			break;
+		sumT	+= t;
+		sumTT	+= t * t;
+		sumP	+= s.mPosition;
+		sumTP	+= s.mPosition * (float)t;
+		count++;
+	}
+
+	double denom = count * sumTT - sumT * sumT;
+	if( count < 3 || denom <= 0.0 )
+		return mDerivative;
+	return ( sumTP * (float)count - sumP * (float)sumT ) / (float)denom;
+}
+
+Vec3f HeadPoseFilter::predict( double time )
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	if( mNumSamples == 0 )
+		return Vec3f::zero();
+
+	const Sample &newest = mHistory[mNewest];
+	float ahead = math<float>::clamp( (float)( time - newest.mTime ), 0.0f, mParams.mMaxPrediction );
+	return newest.mPosition + getVelocity() * ahead;
+}
+
+bool HeadPoseFilter::isTracking( double time, double timeout )
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return mNumSamples > 0 && time - mHistory[mNewest].mTime < timeout;
+}
@@ -0,0 +1,237 @@
+//
+//  Logger.cpp
+//  KinectTerrain
+//
+
+#include "Logger.h"
+#include "ResourceRegistry.h"
+#include "cinder/app/AppBasic.h"
+#include "cinder/Utilities.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#if defined( _MSC_VER )
+	#define LOGGER_THREAD_LOCAL __declspec( thread )
+	#define snprintf _snprintf
+#else
+	#define LOGGER_THREAD_LOCAL __thread
+#endif
+
+using namespace ci;
+
+static const char* LEVEL_NAMES[] = { "debug", "info", "warning", "error" };
+
+// Each thread's ring lives for the rest of the app so the writer never reads freed memory
+static LOGGER_THREAD_LOCAL Logger::Ring *sThreadRing = NULL;
+
+std::vector<Logger::Ring*>		Logger::sRings;
+std::mutex						Logger::sRingsMutex;
+std::shared_ptr<std::thread>	Logger::sWriter;
+bool							Logger::sHasShutDown = false;
+std::atomic<bool>				Logger::sIsRunning( false );
+
+bool Logger::Ring::push( const Entry &entry )
+{
+	unsigned int head = mHead.load( std::memory_order_relaxed );
+	unsigned int tail = mTail.load( std::memory_order_acquire );
+	if( head - tail >= CAPACITY ){
+		mDropped.fetch_add( 1, std::memory_order_relaxed );
+		return false;
+	}
+
+	mEntries[head & ( CAPACITY - 1 )] = entry;
+	mHead.store( head + 1, std::memory_order_release );
+	return true;
+}
+
+bool Logger::Ring::pop( Entry *entry )
+{
+	unsigned int tail = mTail.load( std::memory_order_relaxed );
+	unsigned int head = mHead.load( std::memory_order_acquire );
+	if( tail == head )
+		return false;
+
+	*entry = mEntries[tail & ( CAPACITY - 1 )];
+	mTail.store( tail + 1, std::memory_order_release );
+	return true;
+}
+
+bool Logger::RateLimit::allow( double intervalSeconds )
+{
+	double now = app::getElapsedSeconds();
+	if( now - mLastTime < intervalSeconds )
+		return false;
+	mLastTime = now;
+	return true;
+}
+
+Logger::Ring* Logger::getThreadRing()
+{
+	if( ! sThreadRing ){
+		sThreadRing = new Ring();
+		ResourceRegistry::addCpuBuffer( sThreadRing, "Logger", "thread ring", sizeof( Ring ) );
+		std::lock_guard<std::mutex> lock( sRingsMutex );
+		sRings.push_back( sThreadRing );
+		startWriter();
+	}
+	return sThreadRing;
+}
+
+void Logger::startWriter()
+{
+	// Called with sRingsMutex held. Once shut down nothing would join a new writer.
+	if( sWriter || sHasShutDown )
+		return;
+	sIsRunning = true;
+	sWriter = std::shared_ptr<std::thread>( new std::thread( &Logger::writerThread ) );
+}
+
+void Logger::write( int level, const char *format, const Arg &a0, const Arg &a1, const Arg &a2, const Arg &a3 )
+{
+	const Arg *args[MAX_ARGS] = { &a0, &a1, &a2, &a3 };
+
+	Entry entry;
+	entry.mTime		= app::getElapsedSeconds();
+	entry.mFormat	= format;
+	entry.mLevel	= level;
+	size_t textLength = 0;
+	for( int i = 0; i < MAX_ARGS; i++ ){
+		entry.mArgs[i] = *args[i];
+		if( args[i]->mType != Arg::TEXT )
+			continue;
+
+		// Copied now, the string may be gone by the time the writer gets to it. Once the text is
+		// full the rest point at its last terminator and come out empty.
+		size_t offset = std::min( textLength, (size_t)TEXT_SIZE - 1 );
+		size_t length = std::min( strlen( args[i]->mString ), (size_t)TEXT_SIZE - 1 - offset );
+		memcpy( entry.mText + offset, args[i]->mString, length );
+		entry.mText[offset + length] = 0;
+		entry.mArgs[i].mInteger = (long long)offset;
+		textLength = offset + length + 1;
+	}
+	getThreadRing()->push( entry );
+}
+
+// Formats one conversion at a time, passing its argument as the type the conversion expects
+// whatever it was logged as, so a mismatched format can't read the wrong thing off the stack
+static void formatEntry( const Logger::Entry &entry, char *message, size_t size )
+{
+	size_t length = 0;
+	int argIndex = 0;
+	const char *format = entry.mFormat;
+	while( *format && length + 1 < size ){
+		if( *format != '%' ){
+			message[length++] = *format++;
+			continue;
+		}
+		if( format[1] == '%' ){
+			message[length++] = '%';
+			format += 2;
+			continue;
+		}
+
+		// Keep the flags, width and precision, the length modifier is replaced to suit the argument
+		char spec[32];
+		size_t specLength = 0;
+		spec[specLength++] = *format++;
+		while( *format && strchr( "-+ #0123456789.", *format ) && specLength < sizeof( spec ) - 4 )
+			spec[specLength++] = *format++;
+		while( *format && strchr( "hlLqjzt", *format ) )
+			format++;
+		char conversion = *format;
+		if( ! conversion )
+			break;
+		format++;
+
+		Logger::Arg arg = ( argIndex < Logger::MAX_ARGS ) ? entry.mArgs[argIndex] : Logger::Arg();
+		argIndex++;
+		double number	= ( arg.mType == Logger::Arg::NUMBER ) ? arg.mNumber : ( arg.mType == Logger::Arg::INTEGER ) ? (double)arg.mInteger : 0.0;
+		long long integer = ( arg.mType == Logger::Arg::INTEGER ) ? arg.mInteger : ( arg.mType == Logger::Arg::NUMBER ) ? (long long)arg.mNumber : 0;
+		const char *string = ( arg.mType == Logger::Arg::STRING ) ? arg.mString : ( arg.mType == Logger::Arg::TEXT ) ? entry.mText + arg.mInteger : "?";
+
+		int written;
+		if( strchr( "diouxX", conversion ) ){
+			spec[specLength++] = 'l';
+			spec[specLength++] = 'l';
+			spec[specLength++] = conversion;
+			spec[specLength] = 0;
+			written = snprintf( message + length, size - length, spec, integer );
+		}
+		else if( strchr( "fFeEgGaA", conversion ) ){
+			spec[specLength++] = conversion;
+			spec[specLength] = 0;
+			written = snprintf( message + length, size - length, spec, number );
+		}
+		else if( conversion == 's' ){
+			spec[specLength++] = conversion;
+			spec[specLength] = 0;
+			written = snprintf( message + length, size - length, spec, string );
+		}
+		else {
+			// %n, %p and the like have no business in a log line
+			written = snprintf( message + length, size - length, "?" );
+		}
+
+		// _snprintf returns -1 when it truncates
+		if( written < 0 || (size_t)written >= size - length ){
+			length = size - 1;
+			break;
+		}
+		length += written;
+	}
+	message[length] = 0;
+}
+
+bool Logger::drain( std::vector<Ring*> *rings )
+{
+	bool wroteAny = false;
+	char message[1024];
+
+	// Copied so a thread logging for the first time never waits on the console
+	{
+		std::lock_guard<std::mutex> lock( sRingsMutex );
+		rings->assign( sRings.begin(), sRings.end() );
+	}
+
+	for( size_t i = 0; i < rings->size(); i++ ){
+		Ring *ring = (*rings)[i];
+		Entry entry;
+		while( ring->pop( &entry ) ){
+			formatEntry( entry, message, sizeof( message ) );
+			app::console() << "[" << entry.mTime << "][" << LEVEL_NAMES[entry.mLevel] << "] " << message << std::endl;
+			wroteAny = true;
+		}
+
+		unsigned int dropped = ring->mDropped.exchange( 0 );
+		if( dropped > 0 )
+			app::console() << "[logger] dropped " << dropped << " entries, ring full" << std::endl;
+	}
+	return wroteAny;
+}
+
+void Logger::writerThread()
+{
+	std::vector<Ring*> rings;
+	while( sIsRunning ){
+		if( ! drain( &rings ) )
+			ci::sleep( 10 );
+	}
+	drain( &rings );
+}
+
+void Logger::shutdown()
+{
+	std::shared_ptr<std::thread> writer;
+	{
+		std::lock_guard<std::mutex> lock( sRingsMutex );
+		writer = sWriter;
+		sWriter.reset();
+		sHasShutDown = true;
+	}
+	if( ! writer )
+		return;
+
+	sIsRunning = false;
+	writer->join();
+}
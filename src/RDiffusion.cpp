@@ -9,6 +9,7 @@
 #include "RDiffusion.h"
 #include "cinder/app/AppBasic.h"
 #include "cinder/gl/Fbo.h"
+#include "ResourceRegistry.h"
 
 using namespace ci;
 
@@ -48,6 +49,11 @@ RDiffusion::RDiffusion( int w, int h )
 	mFbos[1]		= gl::Fbo( mFboWidth, mFboHeight, format );
 	mHeightsFbo		= gl::Fbo( mFboWidth, mFboHeight, format );
 	mNormalsFbo		= gl::Fbo( mFboWidth, mFboHeight, format );
+	ResourceRegistry::addFbo( mFbo, "RDiffusion", "output" );
+	ResourceRegistry::addFbo( mFbos[0], "RDiffusion", "ping" );
+	ResourceRegistry::addFbo( mFbos[1], "RDiffusion", "pong" );
+	ResourceRegistry::addFbo( mHeightsFbo, "RDiffusion", "heights" );
+	ResourceRegistry::addFbo( mNormalsFbo, "RDiffusion", "normals" );
 	
 	
 	float W			= 1.0f/(float)app::getWindowWidth();
@@ -113,7 +119,7 @@ void RDiffusion::reset()
 	mHeightsFbo.unbindFramebuffer();
 }
 
-void RDiffusion::update( float dt, gl::GlslProg *shader, const gl::Texture &glowTex, const bool &isPressed, const ci::Vec2f &spherePos, float zoom )
+void RDiffusion::update( float dt, gl::GlslProg *shader, const gl::Texture &glowTex, const bool &isPressed, const ci::Vec2f &spherePos, float zoom, int iterations )
 {	
 	float xo	= 0.0f;
 	float yo	= 0.0f;
@@ -138,11 +144,13 @@ void RDiffusion::update( float dt, gl::GlslProg *shader, const gl::Texture &glow
 	mKernel[7]	= side + yo;
 	mKernel[8]	= diag + xo + yo;
 	
-	const int ITERATIONS = 7;
+	// Fewer iterations take longer steps so the pattern evolves at about the same
+	//  speed, capped at twice the usual step to keep the integration stable
+	float stepScale = std::min( DEFAULT_ITERATIONS / (float)iterations, 2.0f );
 
 	gl::setMatricesWindow( mFboSize, false );
 	gl::setViewport( mFboBounds );
-	for( int i = 0; i < ITERATIONS; i++ ) {
+	for( int i = 0; i < iterations; i++ ) {
 		mThisFbo	= ( mThisFbo + 1 ) % 2;
 		mPrevFbo	= ( mThisFbo + 1 ) % 2;
 		
@@ -164,7 +172,7 @@ void RDiffusion::update( float dt, gl::GlslProg *shader, const gl::Texture &glow
 		shader->uniform( "f", mParamF );
 		shader->uniform( "n", mParamN );
 		shader->uniform( "wind", mParamWind );
-		shader->uniform( "dt", dt * 0.25f );
+		shader->uniform( "dt", dt * 0.25f * stepScale );
 		
 		gl::drawSolidRect( mFboBounds );
 		
@@ -0,0 +1,299 @@
+//
+//  ResourceRegistry.cpp
+//  KinectTerrain
+//
+
+#include "ResourceRegistry.h"
+#include "Logger.h"
+#include "cinder/app/AppBasic.h"
+#include <fstream>
+#include <stdio.h>
+
+using namespace ci;
+
+// Cinder's wrappers keep their shared state protected. A copy in a subclass can
+// reach it, and it lives exactly as long as the wrapper and its copies do.
+struct TextureLifetime : public gl::Texture {
+	TextureLifetime( const gl::Texture &texture ) : gl::Texture( texture ) {}
+	std::weak_ptr<void>	get() const {	return mObj;	}
+};
+
+struct FboLifetime : public gl::Fbo {
+	FboLifetime( const gl::Fbo &fbo ) : gl::Fbo( fbo ) {}
+	std::weak_ptr<void>	get() const {	return mObj;	}
+};
+
+struct VboMeshLifetime : public gl::VboMesh {
+	VboMeshLifetime( const gl::VboMesh &mesh ) : gl::VboMesh( mesh ) {}
+	std::weak_ptr<void>	get() const {	return mObj;	}
+};
+
+struct GlslProgLifetime : public gl::GlslProg {
+	GlslProgLifetime( const gl::GlslProg &prog ) : gl::GlslProg( prog ) {}
+	std::weak_ptr<void>	get() const {	return mObj;	}
+};
+
+static std::string escapeJson( const std::string &text )
+{
+	// Asset names come from file names, which can hold quotes and backslashes
+	std::string escaped;
+	escaped.reserve( text.size() );
+	for( size_t i = 0; i < text.size(); i++ ){
+		char c = text[i];
+		if( c == '"' || c == '\\' ){
+			escaped += '\\';
+			escaped += c;
+		} else if( (unsigned char)c < 0x20 ){
+			char code[8];
+			sprintf( code, "\\u%04x", (int)(unsigned char)c );
+			escaped += code;
+		} else {
+			escaped += c;
+		}
+	}
+	return escaped;
+}
+
+std::vector<ResourceRegistry::Entry>	ResourceRegistry::sEntries;
+std::mutex								ResourceRegistry::sMutex;
+
+static const char* KIND_NAMES[ResourceRegistry::NUM_KINDS] = { "texture", "fbo", "vbo", "program", "cpu" };
+
+void ResourceRegistry::add( Kind kind, uint64_t handle, const std::string &owner, const std::string &name,
+						    GLenum format, int width, int height, int depth, size_t bytes,
+							const std::weak_ptr<void> &lifetime )
+{
+	Entry entry;
+	entry.mKind		= kind;
+	entry.mHandle	= handle;
+	entry.mOwner	= owner;
+	entry.mName		= name;
+	entry.mFormat	= getFormatName( format );
+	entry.mWidth	= width;
+	entry.mHeight	= height;
+	entry.mDepth	= depth;
+	entry.mBytes	= bytes;
+	entry.mTime		= app::App::get() ? app::getElapsedSeconds() : 0.0;
+	entry.mIsLeaked	= false;
+	entry.mLifetime	= lifetime;
+	// An empty weak_ptr reads as expired, this tells it apart from a dead owner
+	entry.mHasLifetime = ! lifetime.expired();
+
+	std::lock_guard<std::mutex> lock( sMutex );
+	for( size_t i = 0; i < sEntries.size(); i++ ){
+		if( sEntries[i].mKind == kind && sEntries[i].mHandle == handle ){
+			sEntries[i] = entry;
+			return;
+		}
+	}
+	sEntries.push_back( entry );
+}
+
+void ResourceRegistry::addTexture( const gl::Texture &texture, const std::string &owner, const std::string &name )
+{
+	if( ! texture )
+		return;
+	GLenum format = texture.getInternalFormat();
+	add( TEXTURE, texture.getId(), owner, name, format, texture.getWidth(), texture.getHeight(), 1,
+		 texture.getWidth() * texture.getHeight() * getBytesPerPixel( format ), getLifetime( texture ) );
+}
+
+void ResourceRegistry::addFbo( gl::Fbo &fbo, const std::string &owner, const std::string &name )
+{
+	if( ! fbo )
+		return;
+	const gl::Fbo::Format &format = fbo.getFormat();
+	size_t pixels		= fbo.getWidth() * fbo.getHeight();
+	size_t samples		= std::max( format.getSamples(), 1 );
+	// Multisampled targets keep a resolve texture plus the samples in renderbuffers
+	size_t fboBytes		= format.hasDepthBuffer() ? pixels * samples * 4 : 0;
+	if( format.getSamples() > 0 )
+		fboBytes		+= pixels * samples * getBytesPerPixel( format.getColorInternalFormat() );
+
+	add( FBO, fbo.getId(), owner, name, format.getColorInternalFormat(), fbo.getWidth(), fbo.getHeight(), 1, fboBytes, getLifetime( fbo ) );
+	addTexture( fbo.getTexture(), owner, name + " color" );
+}
+
+void ResourceRegistry::addVboMesh( gl::VboMesh &mesh, const std::string &owner, const std::string &name )
+{
+	if( ! mesh )
+		return;
+	const gl::VboMesh::Layout &layout = mesh.getLayout();
+	size_t vertexBytes = 0;
+	if( layout.hasStaticPositions() )		vertexBytes += sizeof( Vec3f );
+	if( layout.hasStaticNormals() )			vertexBytes += sizeof( Vec3f );
+	if( layout.hasStaticTexCoords2d() )		vertexBytes += sizeof( Vec2f );
+	if( layout.hasStaticColorsRGB() )		vertexBytes += sizeof( Color );
+	if( layout.hasStaticColorsRGBA() )		vertexBytes += sizeof( ColorA );
+
+	std::weak_ptr<void> lifetime = getLifetime( mesh );
+	add( VBO, mesh.getStaticVbo().getId(), owner, name, 0, (int)mesh.getNumVertices(), 1, 1, mesh.getNumVertices() * vertexBytes, lifetime );
+	if( layout.hasIndices() )
+		add( VBO, mesh.getIndexVbo().getId(), owner, name + " indices", 0, (int)mesh.getNumIndices(), 1, 1, mesh.getNumIndices() * sizeof( uint32_t ), lifetime );
+}
+
+void ResourceRegistry::addCpuBuffer( const void *data, const std::string &owner, const std::string &name, size_t bytes )
+{
+	add( CPU_BUFFER, (uint64_t)(size_t)data, owner, name, 0, (int)bytes, 1, 1, bytes );
+}
+
+void ResourceRegistry::refresh()
+{
+	std::lock_guard<std::mutex> lock( sMutex );
+	for( size_t i = 0; i < sEntries.size(); ){
+		Entry &entry = sEntries[i];
+		if( entry.mKind == CPU_BUFFER ){
+			i++;
+			continue;
+		}
+		if( ! isAlive( entry.mKind, entry.mHandle ) ){
+			sEntries.erase( sEntries.begin() + i );
+			continue;
+		}
+		// Still alive with its wrapper gone, nothing is left to delete it
+		if( entry.mHasLifetime && ! entry.mIsLeaked && entry.mLifetime.expired() ){
+			entry.mIsLeaked = true;
+			LOG_WARNING( "ResourceRegistry: %s %u, %s's %s, outlived its wrapper, see resources.json", KIND_NAMES[entry.mKind], entry.mHandle, entry.mOwner, entry.mName );
+		}
+		i++;
+	}
+}
+
+std::weak_ptr<void> ResourceRegistry::getLifetime( const gl::Texture &texture )
+{
+	return TextureLifetime( texture ).get();
+}
+
+std::weak_ptr<void> ResourceRegistry::getLifetime( const gl::Fbo &fbo )
+{
+	return FboLifetime( fbo ).get();
+}
+
+std::weak_ptr<void> ResourceRegistry::getLifetime( const gl::VboMesh &mesh )
+{
+	return VboMeshLifetime( mesh ).get();
+}
+
+std::weak_ptr<void> ResourceRegistry::getLifetime( const gl::GlslProg &prog )
+{
+	return GlslProgLifetime( prog ).get();
+}
+
+bool ResourceRegistry::isAlive( Kind kind, uint64_t handle )
+{
+	GLuint name = (GLuint)handle;
+	switch( kind ){
+		case TEXTURE:	return glIsTexture( name ) == GL_TRUE;
+		case FBO:		return glIsFramebufferEXT( name ) == GL_TRUE;
+		case VBO:		return glIsBuffer( name ) == GL_TRUE;
+		case PROGRAM:	return glIsProgram( name ) == GL_TRUE;
+		default:		return false;
+	}
+}
+
+size_t ResourceRegistry::getTotalBytes( Kind kind )
+{
+	std::lock_guard<std::mutex> lock( sMutex );
+	size_t total = 0;
+	for( size_t i = 0; i < sEntries.size(); i++ ){
+		if( sEntries[i].mKind == kind )
+			total += sEntries[i].mBytes;
+	}
+	return total;
+}
+
+size_t ResourceRegistry::getGpuBytes()
+{
+	return getTotalBytes( TEXTURE ) + getTotalBytes( FBO ) + getTotalBytes( VBO ) + getTotalBytes( PROGRAM );
+}
+
+int ResourceRegistry::getNumLeaks()
+{
+	std::lock_guard<std::mutex> lock( sMutex );
+	int leaks = 0;
+	for( size_t i = 0; i < sEntries.size(); i++ ){
+		if( sEntries[i].mIsLeaked )
+			leaks++;
+	}
+	return leaks;
+}
+
+std::vector<ResourceRegistry::Entry> ResourceRegistry::getEntries()
+{
+	std::lock_guard<std::mutex> lock( sMutex );
+	return sEntries;
+}
+
+void ResourceRegistry::writeJson( const fs::path &path )
+{
+	std::ofstream out( path.string().c_str() );
+	if( ! out ){
+		LOG_WARNING( "ResourceRegistry: unable to write resources.json" );
+		return;
+	}
+
+	std::vector<Entry> entries = getEntries();
+	out << "{\"totals\":{";
+	for( int k = 0; k < NUM_KINDS; k++ ){
+		out << "\"" << KIND_NAMES[k] << "\":" << getTotalBytes( (Kind)k );
+		if( k + 1 < NUM_KINDS )
+			out << ",";
+	}
+	out << "},\"leaks\":" << getNumLeaks() << ",\"resources\":[" << std::endl;
+	for( size_t i = 0; i < entries.size(); i++ ){
+		const Entry &entry = entries[i];
+		out << "{\"kind\":\"" << KIND_NAMES[entry.mKind] << "\",\"handle\":" << entry.mHandle
+			<< ",\"owner\":\"" << escapeJson( entry.mOwner ) << "\",\"name\":\"" << escapeJson( entry.mName ) << "\",\"format\":\"" << entry.mFormat << "\""
+			<< ",\"width\":" << entry.mWidth << ",\"height\":" << entry.mHeight << ",\"depth\":" << entry.mDepth
+			<< ",\"bytes\":" << entry.mBytes << ",\"time\":" << entry.mTime << ",\"leaked\":" << ( entry.mIsLeaked ? "true" : "false" ) << "}";
+		if( i + 1 < entries.size() )
+			out << ",";
+		out << std::endl;
+	}
+	out << "]}" << std::endl;
+
+	LOG_INFO( "ResourceRegistry: wrote %d resources to resources.json", entries.size() );
+}
+
+size_t ResourceRegistry::getBytesPerPixel( GLenum format )
+{
+	// DXT is under a byte per pixel, callers that know the compressed size pass it to add() instead
+	switch( format ){
+		case GL_RGBA32F_ARB:						return 16;
+		case GL_RGB32F_ARB:							return 12;
+		case GL_RGBA16F_ARB:						return 8;
+		case GL_RGB16F_ARB:							return 6;
+		case GL_RGB:
+		case GL_RGB8:								return 3;
+		case GL_LUMINANCE:
+		case GL_ALPHA:								return 1;
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:		return 1;
+		default:									return 4;
+	}
+}
+
+const char* ResourceRegistry::getFormatName( GLenum format )
+{
+	switch( format ){
+		case 0:										return "";
+		case GL_RGBA32F_ARB:						return "RGBA32F";
+		case GL_RGB32F_ARB:							return "RGB32F";
+		case GL_RGBA16F_ARB:						return "RGBA16F";
+		case GL_RGB16F_ARB:							return "RGB16F";
+		case GL_RGB:
+		case GL_RGB8:								return "RGB8";
+		case GL_RGBA:
+		case GL_RGBA8:								return "RGBA8";
+		case GL_LUMINANCE:							return "L8";
+		case GL_ALPHA:								return "A8";
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:		return "DXT1";
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:		return "DXT5";
+		default:									return "other";
+	}
+}
+
+const char* ResourceRegistry::getKindName( Kind kind )
+{
+	return KIND_NAMES[kind];
+}
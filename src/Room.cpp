@@ -10,6 +10,8 @@
 #include "cinder/gl/Texture.h"
 #include "cinder/Rand.h"
 #include "Room.h"
+#include "ResourceRegistry.h"
+#include <cstddef>
 
 const float MAX_TIMEMULTI	= 150.0f;
 const float GRAVITY			= -0.02f;
@@ -28,6 +30,7 @@ Room::Room( const Vec3f &dims, bool isPowerOn, bool isGravityOn )
 	mTimeMulti		= 60.0f;
 	mTimer			= 0.0f;
 	mTick			= false;
+	mFixedTimeStep	= 0.0f;
 	
 	mDims		= dims;
 	mDimsDest	= dims;
@@ -38,6 +41,9 @@ Room::Room( const Vec3f &dims, bool isPowerOn, bool isGravityOn )
 	
 	mIsGravityOn	= isGravityOn;
 	mDefaultGravity = Vec3f( 0.0f, GRAVITY, 0.0f );
+	
+	mFrame			= 0;
+	mIsInstancingSupported = false;
 }
 
 void Room::init()
@@ -126,6 +132,25 @@ void Room::init()
 	mVbo.bufferNormals( normals );
 	mVbo.bufferTexCoords2d( 0, texCoords );
 	mVbo.unbindBuffers();
+	ResourceRegistry::addVboMesh( mVbo, "Room", "box" );
+	
+	// WALLS
+	// One quad shared by every wall, walls.vert places it from the instance data
+	std::vector<ci::Vec3f> corners;
+	corners.push_back( Vec3f(-1.0f, 1.0f, 0.0f ) );
+	corners.push_back( Vec3f(-1.0f,-1.0f, 0.0f ) );
+	corners.push_back( Vec3f( 1.0f, 1.0f, 0.0f ) );
+	corners.push_back( Vec3f( 1.0f,-1.0f, 0.0f ) );
+	
+	gl::VboMesh::Layout quadLayout;
+	quadLayout.setStaticPositions();
+	mWallQuad = gl::VboMesh( corners.size(), 0, quadLayout, GL_TRIANGLE_STRIP );
+	mWallQuad.bufferPositions( corners );
+	mWallQuad.unbindBuffers();
+	ResourceRegistry::addVboMesh( mWallQuad, "Room", "wall quad" );
+	
+	mWallVbo				= gl::Vbo( GL_ARRAY_BUFFER );
+	mIsInstancingSupported	= gl::isExtensionAvailable( "GL_ARB_instanced_arrays" ) && gl::isExtensionAvailable( "GL_ARB_draw_instanced" );
 }
 
 void Room::updateTime()
@@ -133,6 +158,8 @@ void Room::updateTime()
 	float prevTime	= mTime;
 	mTime			= (float)app::getElapsedSeconds();
 	float dt		= mTime - prevTime;
+	if( mFixedTimeStep > 0.0f )
+		dt			= mFixedTimeStep;
 	mTimeAdjusted	= dt * mTimeMulti;
 	mTimeElapsed	+= mTimeAdjusted;
 	
@@ -154,6 +181,8 @@ void Room::update()
 	
 	mDims -= ( mDims - mDimsDest ) * 0.1f;
 	
+	mFrame++;
+	
 	updateTime();
 }
 
@@ -162,56 +191,97 @@ void Room::draw()
 	gl::draw( mVbo );
 }
 
-void Room::drawWalls( float power, 
-					 const gl::Texture &backTex, 
-					 const gl::Texture &leftTex, 
-					 const gl::Texture &rightTex, 
-					 const gl::Texture &ceilingTex,
-					 const gl::Texture &floorTex,
-					 const gl::Texture &blankTex )
+void Room::addWall( const Vec3f &center, const Vec3f &right, const Vec3f &up, int layer )
 {
-	// If the power is on, bind the wall texture. If it's not on, bind the blank texture, and draw some billboards
-	if( Rand::randFloat() < power ){
-		if( Rand::randFloat() < power ){
-			backTex.bind();
-		} else {
-			blankTex.bind();
-		}
-		gl::drawBillboard( Vec3f( 0.0f, 0.0f, -mDims.z ), Vec2f( mDims.xy() * 2.0f ), 0.0f, Vec3f::xAxis(), Vec3f::yAxis() );
-		gl::drawBillboard( Vec3f( 0.0f, 0.0f, mDims.z ), Vec2f( mDims.xy() * 2.0f ), 0.0f, Vec3f::xAxis(), Vec3f::yAxis() );
+	WallInstance wall;
+	wall.mCenter	= Vec4f( center, (float)layer );
+	wall.mRight		= right;
+	wall.mUp		= up;
+	mWalls.push_back( wall );
+}
+
+void Room::drawWalls( float power, TextureArray &wallsTex, gl::GlslProg &shader )
+{
+	// If the power is on, use the wall's layer. If it's not on, use the blank layer, or skip the wall.
+	// Same seed for every view this frame so they all flicker together.
+	Rand rand( mFrame );
+	mWalls.clear();
+	
+	if( rand.nextFloat() < power ){
+		int layer = rand.nextFloat() < power ? WALL_BACK : WALL_BLANK;
+		addWall( Vec3f( 0.0f, 0.0f, -mDims.z ), Vec3f::xAxis() * mDims.x, Vec3f::yAxis() * mDims.y, layer );
+		addWall( Vec3f( 0.0f, 0.0f, mDims.z ), Vec3f::xAxis() * mDims.x, Vec3f::yAxis() * mDims.y, layer );
 	}
 	
-	if( Rand::randFloat() < power ){
-		if( Rand::randFloat() < power ){
-			leftTex.bind();
-		} else {
-			blankTex.bind();
-		}
-		gl::drawBillboard( Vec3f( mDims.x, 0.0f, 0.0f ), Vec2f( mDims.zy() * 2.0f ), 0.0f, Vec3f::zAxis(), Vec3f::yAxis() );
+	if( rand.nextFloat() < power ){
+		int layer = rand.nextFloat() < power ? WALL_LEFT : WALL_BLANK;
+		addWall( Vec3f( mDims.x, 0.0f, 0.0f ), Vec3f::zAxis() * mDims.z, Vec3f::yAxis() * mDims.y, layer );
 	}
 	
-	if( Rand::randFloat() < power ){
-		if( Rand::randFloat() < power ){
-			rightTex.bind();
-		} else {
-			blankTex.bind();
-		}
-		gl::drawBillboard( Vec3f( -mDims.x, 0.0f, 0.0f ), Vec2f( mDims.zy() * 2.0f ), 0.0f, Vec3f::zAxis(), Vec3f::yAxis() );
+	if( rand.nextFloat() < power ){
+		int layer = rand.nextFloat() < power ? WALL_RIGHT : WALL_BLANK;
+		addWall( Vec3f( -mDims.x, 0.0f, 0.0f ), Vec3f::zAxis() * mDims.z, Vec3f::yAxis() * mDims.y, layer );
 	}
 	
-	if( Rand::randFloat() < power ){
-		if( Rand::randFloat() < power ){
-			ceilingTex.bind();
-		} else {
-			blankTex.bind();
-		}
-		gl::drawBillboard( Vec3f( 0.0f, mDims.y, 0.0f ), Vec2f( mDims.xz() * 2.0f ), 0.0f, Vec3f::xAxis(), Vec3f::zAxis() );
+	if( rand.nextFloat() < power ){
+		int layer = rand.nextFloat() < power ? WALL_CEILING : WALL_BLANK;
+		addWall( Vec3f( 0.0f, mDims.y, 0.0f ), Vec3f::xAxis() * mDims.x, Vec3f::zAxis() * mDims.z, layer );
 	}
 	
 	if( power > 0.5f ){
-		floorTex.bind();
-		gl::drawBillboard( Vec3f( 0.0f, -mDims.y, 0.0f ), Vec2f( mDims.xz() * 2.0f ), 0.0f, Vec3f::xAxis(), Vec3f::zAxis() );
+		addWall( Vec3f( 0.0f, -mDims.y, 0.0f ), Vec3f::xAxis() * mDims.x, Vec3f::zAxis() * mDims.z, WALL_FLOOR );
+	}
+	
+	GLint centerAttrib	= shader.getAttribLocation( "wallCenter" );
+	GLint rightAttrib	= shader.getAttribLocation( "wallRight" );
+	GLint upAttrib		= shader.getAttribLocation( "wallUp" );
+	if( mWalls.empty() || ! wallsTex.getId() || centerAttrib < 0 || rightAttrib < 0 || upAttrib < 0 )
+		return;
+	
+	wallsTex.bind( 0 );
+	shader.bind();
+	shader.uniform( "wallsTex", 0 );
+	mWallQuad.enableClientStates();
+	mWallQuad.bindAllData();
+	
+	if( mIsInstancingSupported ){
+		GLsizei stride = sizeof( WallInstance );
+		mWallVbo.bind();
+		mWallVbo.bufferData( mWalls.size() * stride, &mWalls[0], GL_STREAM_DRAW );
+		glEnableVertexAttribArray( centerAttrib );
+		glEnableVertexAttribArray( rightAttrib );
+		glEnableVertexAttribArray( upAttrib );
+		glVertexAttribPointer( centerAttrib, 4, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)offsetof( WallInstance, mCenter ) );
+		glVertexAttribPointer( rightAttrib, 3, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)offsetof( WallInstance, mRight ) );
+		glVertexAttribPointer( upAttrib, 3, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)offsetof( WallInstance, mUp ) );
+		glVertexAttribDivisorARB( centerAttrib, 1 );
+		glVertexAttribDivisorARB( rightAttrib, 1 );
+		glVertexAttribDivisorARB( upAttrib, 1 );
+		mWallVbo.unbind();
+		
+		glDrawArraysInstancedARB( GL_TRIANGLE_STRIP, 0, 4, (GLsizei)mWalls.size() );
+		
+		glVertexAttribDivisorARB( centerAttrib, 0 );
+		glVertexAttribDivisorARB( rightAttrib, 0 );
+		glVertexAttribDivisorARB( upAttrib, 0 );
+		glDisableVertexAttribArray( centerAttrib );
+		glDisableVertexAttribArray( rightAttrib );
+		glDisableVertexAttribArray( upAttrib );
+	} else {
+		// Still one texture bind, just a draw per wall
+		for( size_t i = 0; i < mWalls.size(); i++ ){
+			const WallInstance &wall = mWalls[i];
+			glVertexAttrib4f( centerAttrib, wall.mCenter.x, wall.mCenter.y, wall.mCenter.z, wall.mCenter.w );
+			glVertexAttrib3f( rightAttrib, wall.mRight.x, wall.mRight.y, wall.mRight.z );
+			glVertexAttrib3f( upAttrib, wall.mUp.x, wall.mUp.y, wall.mUp.z );
+			glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+		}
 	}
+	
+	gl::VboMesh::unbindBuffers();
+	mWallQuad.disableClientStates();
+	shader.unbind();
+	wallsTex.unbind( 0 );
 }
 
 void Room::adjustTimeMulti( float amt )
@@ -0,0 +1,209 @@
+//
+//  ShaderCache.cpp
+//  KinectTerrain
+//
+
+#include "ShaderCache.h"
+#include "Logger.h"
+#include "Hash.h"
+#include "GlProc.h"
+#include "ResourceRegistry.h"
+#include "cinder/app/AppBasic.h"
+#include "cinder/Utilities.h"
+#include <fstream>
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+	#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT	0x8257
+	#define GL_PROGRAM_BINARY_LENGTH			0x8741
+	#define GL_NUM_PROGRAM_BINARY_FORMATS		0x87FE
+#endif
+
+using namespace ci;
+
+// Bump when the file layout changes so old entries miss instead of failing
+static const uint32_t CACHE_VERSION = 1;
+
+// Loaded at runtime, the headers we build against predate ARB_get_program_binary
+typedef void ( APIENTRY *GetProgramBinaryProc )( GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary );
+typedef void ( APIENTRY *ProgramBinaryProc )( GLuint program, GLenum binaryFormat, const void *binary, GLsizei length );
+typedef void ( APIENTRY *ProgramParameteriProc )( GLuint program, GLenum pname, GLint value );
+
+static GetProgramBinaryProc		sGetProgramBinary	= NULL;
+static ProgramBinaryProc		sProgramBinary		= NULL;
+static ProgramParameteriProc	sProgramParameteri	= NULL;
+
+// GlslProg keeps its handle and compile steps protected, this lets us build one from a binary
+class CachedGlslProg : public gl::GlslProg {
+  public:
+	CachedGlslProg()
+	{
+		mObj = std::shared_ptr<Obj>( new Obj );
+		mObj->mHandle = glCreateProgram();
+	}
+
+	bool loadBinary( GLenum format, const std::string &binary )
+	{
+		sProgramBinary( mObj->mHandle, format, binary.data(), (GLsizei)binary.size() );
+		return isLinked();
+	}
+
+	void compile( const std::string &vertexSource, const std::string &fragmentSource, bool retrievable )
+	{
+		loadShader( vertexSource.c_str(), GL_VERTEX_SHADER );
+		loadShader( fragmentSource.c_str(), GL_FRAGMENT_SHADER );
+		if( retrievable )
+			sProgramParameteri( mObj->mHandle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
+		link();
+	}
+
+	bool isLinked()
+	{
+		GLint status = GL_FALSE;
+		glGetProgramiv( mObj->mHandle, GL_LINK_STATUS, &status );
+		return status == GL_TRUE;
+	}
+};
+
+ShaderCache::ShaderCache()
+{
+	mIsSupported	= false;
+	mNumHits		= 0;
+	mNumMisses		= 0;
+}
+
+void ShaderCache::setup( const fs::path &directory )
+{
+	mDirectory	= directory;
+	mDriver		= std::string( (const char*)glGetString( GL_VENDOR ) ) + "|" +
+				  std::string( (const char*)glGetString( GL_RENDERER ) ) + "|" +
+				  std::string( (const char*)glGetString( GL_VERSION ) );
+
+	if( gl::isExtensionAvailable( "GL_ARB_get_program_binary" ) ){
+		sGetProgramBinary	= (GetProgramBinaryProc)getGlProcAddress( "glGetProgramBinary" );
+		sProgramBinary		= (ProgramBinaryProc)getGlProcAddress( "glProgramBinary" );
+		sProgramParameteri	= (ProgramParameteriProc)getGlProcAddress( "glProgramParameteri" );
+	}
+
+	GLint numFormats = 0;
+	if( sGetProgramBinary && sProgramBinary && sProgramParameteri )
+		glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats );
+	mIsSupported = numFormats > 0;
+
+	if( mIsSupported ){
+		try {
+			fs::create_directories( mDirectory );
+		} catch( ... ) {
+			mIsSupported = false;
+		}
+	}
+
+	if( ! mIsSupported )
+		app::console() << "ShaderCache: program binaries not available, compiling from source" << std::endl;
+}
+
+std::string ShaderCache::getKey( const std::string &vertexSource, const std::string &fragmentSource )
+{
+	// Hash everything that can invalidate a binary
+	uint64_t hash = HASH_SEED;
+	const std::string parts[] = { vertexSource, fragmentSource, mDriver };
+	for( int i = 0; i < 3; i++ ){
+		hash = hashBytes( parts[i].data(), parts[i].size(), hash );
+		// Separator so moving text between the sources changes the key
+		hash = hashBytes( "|", 1, hash );
+	}
+	return hashToString( hash );
+}
+
+bool ShaderCache::readBinary( const fs::path &path, GLenum *format, std::string *binary )
+{
+	std::ifstream file( path.string().c_str(), std::ios::binary );
+	if( ! file )
+		return false;
+
+	uint32_t header[3];		// version, format, length
+	if( ! file.read( (char*)header, sizeof( header ) ) || header[0] != CACHE_VERSION || header[2] == 0 )
+		return false;
+
+	*format = header[1];
+	binary->resize( header[2] );
+	return (bool)file.read( &(*binary)[0], header[2] );
+}
+
+void ShaderCache::writeBinary( const fs::path &path, GLuint program )
+{
+	GLint length = 0;
+	glGetProgramiv( program, GL_PROGRAM_BINARY_LENGTH, &length );
+	if( length <= 0 )
+		return;
+
+	std::string binary( length, 0 );
+	GLenum format = 0;
+	sGetProgramBinary( program, length, &length, &format, &binary[0] );
+
+	std::ofstream file( path.string().c_str(), std::ios::binary | std::ios::trunc );
+	uint32_t header[3] = { CACHE_VERSION, (uint32_t)format, (uint32_t)length };
+	file.write( (const char*)header, sizeof( header ) );
+	file.write( binary.data(), length );
+}
+
+std::string ShaderCache::injectDefines( const std::string &source, const std::string &defines )
+{
+	if( defines.empty() )
+		return source;
+
+	// #version has to stay the first statement
+	size_t pos = source.find( "#version" );
+	if( pos == std::string::npos )
+		return defines + source;
+	pos = source.find( '\n', pos );
+	if( pos == std::string::npos )
+		return source + "\n" + defines;
+	return source.substr( 0, pos + 1 ) + defines + source.substr( pos + 1 );
+}
+
+gl::GlslProg ShaderCache::load( DataSourceRef vertexShader, DataSourceRef fragmentShader, const std::string &defines )
+{
+	return load( loadString( vertexShader ), loadString( fragmentShader ), defines );
+}
+
+gl::GlslProg ShaderCache::load( const std::string &vertexShaderSource, const std::string &fragmentShaderSource, const std::string &defines )
+{
+	// Defines are part of the source, so each variant gets its own key
+	std::string vertexSource	= injectDefines( vertexShaderSource, defines );
+	std::string fragmentSource	= injectDefines( fragmentShaderSource, defines );
+
+	std::string key = getKey( vertexSource, fragmentSource );
+	if( ! mIsSupported ){
+		gl::GlslProg prog( vertexSource.c_str(), fragmentSource.c_str() );
+		ResourceRegistry::add( ResourceRegistry::PROGRAM, prog.getHandle(), "ShaderCache", key, 0, 0, 0, 0, 0, ResourceRegistry::getLifetime( prog ) );
+		return prog;
+	}
+
+	fs::path path = mDirectory / ( key + ".bin" );
+
+	// HIT
+	GLenum format;
+	std::string binary;
+	if( readBinary( path, &format, &binary ) ){
+		CachedGlslProg prog;
+		if( prog.loadBinary( format, binary ) ){
+			mNumHits++;
+			ResourceRegistry::add( ResourceRegistry::PROGRAM, prog.getHandle(), "ShaderCache", key, 0, 0, 0, 0, binary.size(), ResourceRegistry::getLifetime( prog ) );
+			return prog;
+		}
+		LOG_WARNING( "ShaderCache: cached binary rejected by the driver, recompiling" );
+	}
+
+	// MISS
+	mNumMisses++;
+	CachedGlslProg prog;
+	prog.compile( vertexSource, fragmentSource, true );
+	GLint length = 0;
+	if( prog.isLinked() ){
+		writeBinary( path, prog.getHandle() );
+		glGetProgramiv( prog.getHandle(), GL_PROGRAM_BINARY_LENGTH, &length );
+	}
+	// The binary length is the best size estimate the driver gives us
+	ResourceRegistry::add( ResourceRegistry::PROGRAM, prog.getHandle(), "ShaderCache", key, 0, 0, 0, 0, length, ResourceRegistry::getLifetime( prog ) );
+	return prog;
+}
@@ -0,0 +1,41 @@
+//
+//  ShaderVariants.cpp
+//  KinectTerrain
+//
+
+#include "ShaderVariants.h"
+#include "cinder/Utilities.h"
+
+using namespace ci;
+
+// Under a 1/255 step in the mix, so switching variants never shows
+static const float SETTLED_EPSILON = 0.002f;
+
+static const char* DEFINES[ShaderVariants::NUM_VARIANTS] = {
+	"#define POWER_OFF\n",
+	"#define POWER_ON\n",
+	""
+};
+
+static const char* NAMES[ShaderVariants::NUM_VARIANTS] = { "off", "on", "blend" };
+
+void ShaderVariants::setup( ShaderCache &cache, DataSourceRef vertexShader, DataSourceRef fragmentShader, const std::string &defines )
+{
+	std::string vertexSource	= loadString( vertexShader );
+	std::string fragmentSource	= loadString( fragmentShader );
+
+	for( int i = 0; i < NUM_VARIANTS; i++ )
+		mVariants[i] = cache.load( vertexSource, fragmentSource, defines + DEFINES[i] );
+}
+
+int ShaderVariants::getVariant( float power )
+{
+	if( power <= SETTLED_EPSILON )			return POWER_OFF;
+	if( power >= 1.0f - SETTLED_EPSILON )	return POWER_ON;
+	return POWER_BLEND;
+}
+
+const char* ShaderVariants::getVariantName( int variant )
+{
+	return NAMES[variant];
+}
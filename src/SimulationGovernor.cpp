@@ -0,0 +1,66 @@
+//
+//  SimulationGovernor.cpp
+//  KinectTerrain
+//
+
+#include "SimulationGovernor.h"
+#include "Logger.h"
+
+// Level 0 is what the simulation always used to run at
+const SimulationGovernor::Level SimulationGovernor::LEVELS[NUM_LEVELS] = {
+	{ 7, 1 },
+	{ 6, 1 },
+	{ 5, 2 },
+	{ 3, 3 }
+};
+
+static const float	OVER_BUDGET			= 1.05f;	// Fraction of the budget that counts as over
+static const float	UNDER_BUDGET		= 0.8f;		// Fraction of the budget that counts as comfortably under
+static const int	FRAMES_TO_DROP		= 30;
+static const int	FRAMES_TO_RAISE		= 90;
+static const int	MIN_HOLD_FRAMES		= 30;
+
+SimulationGovernor::SimulationGovernor()
+{
+	mBudgetMs			= 30.0f;
+	mIsBudgetEnabled	= true;
+	mLevel				= 0;
+	mFramesOver			= 0;
+	mFramesUnder		= 0;
+	mFramesSinceChange	= 0;
+	mFrame				= 0;
+}
+
+void SimulationGovernor::setup( float budgetMs )
+{
+	mBudgetMs = budgetMs;
+}
+
+void SimulationGovernor::update( float simulationMs )
+{
+	mFrame++;
+	mFramesSinceChange++;
+
+	// SIMULATION BUDGET
+	int target = 0;
+	if( mIsBudgetEnabled && simulationMs > 0.0f ){
+		mFramesOver		= simulationMs > mBudgetMs * OVER_BUDGET ? mFramesOver + 1 : 0;
+		mFramesUnder	= simulationMs < mBudgetMs * UNDER_BUDGET ? mFramesUnder + 1 : 0;
+		target = mLevel;
+		if( mFramesOver >= FRAMES_TO_DROP && mLevel < NUM_LEVELS - 1 )
+			target = mLevel + 1;
+		else if( mFramesUnder >= FRAMES_TO_RAISE && mLevel > 0 )
+			target = mLevel - 1;
+	}
+
+	if( target == mLevel || mFramesSinceChange < MIN_HOLD_FRAMES )
+		return;
+
+	int level = mLevel + ( target > mLevel ? 1 : -1 );
+	LOG_INFO( "SimulationGovernor: level %g -> %g, simulation %g ms, budget %g ms", mLevel, level, simulationMs, mBudgetMs );
+	LOG_DEBUG( "SimulationGovernor: %g iterations, normals every %g frames", LEVELS[level].mIterations, LEVELS[level].mNormalsInterval );
+	mLevel				= level;
+	mFramesSinceChange	= 0;
+	mFramesOver			= 0;
+	mFramesUnder		= 0;
+}
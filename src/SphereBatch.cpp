@@ -0,0 +1,219 @@
+//
+//  SphereBatch.cpp
+//  KinectTerrain
+//
+
+#include "SphereBatch.h"
+#include "ResourceRegistry.h"
+#include "cinder/CinderMath.h"
+#include "cinder/Utilities.h"
+
+using namespace ci;
+using std::vector;
+
+SphereBatch::SphereBatch()
+{
+	mIsInstancingSupported	= false;
+	mNumDrawCalls			= 0;
+}
+
+void SphereBatch::setup()
+{
+	// LOD 0 matches the 128 segments the main sphere was always drawn with
+	mSegments[0]		= 128;
+	mSegments[1]		= 40;
+	mSegments[2]		= 16;
+	mMinPixelRadius[0]	= 60.0f;
+	mMinPixelRadius[1]	= 15.0f;
+	mMinPixelRadius[2]	= 0.0f;
+
+	for( int i = 0; i < NUM_LODS; i++ ){
+		mLods[i] = createUnitSphere( mSegments[i] );
+		ResourceRegistry::addVboMesh( mLods[i], "SphereBatch", "lod " + toString( i ) );
+	}
+	mQuad = createQuad();
+	ResourceRegistry::addVboMesh( mQuad, "SphereBatch", "impostor quad" );
+
+	mInstanceVbo			= gl::Vbo( GL_ARRAY_BUFFER );
+	mIsInstancingSupported	= gl::isExtensionAvailable( "GL_ARB_instanced_arrays" ) && gl::isExtensionAvailable( "GL_ARB_draw_instanced" );
+}
+
+gl::VboMesh SphereBatch::createUnitSphere( int segments )
+{
+	int rings = segments / 2;
+
+	vector<Vec3f>		positions;
+	vector<Vec3f>		normals;
+	vector<Vec2f>		texCoords;
+	vector<uint32_t>	indices;
+
+	for( int r = 0; r <= rings; r++ ){
+		float v		= r / (float)rings;
+		float phi	= v * (float)M_PI;
+		for( int s = 0; s <= segments; s++ ){
+			float u		= s / (float)segments;
+			float theta	= u * (float)M_PI * 2.0f;
+			Vec3f n( cos( theta ) * sin( phi ), -cos( phi ), sin( theta ) * sin( phi ) );
+			positions.push_back( n );
+			normals.push_back( n );
+			texCoords.push_back( Vec2f( u, v ) );
+		}
+	}
+
+	for( int r = 0; r < rings; r++ ){
+		for( int s = 0; s < segments; s++ ){
+			uint32_t i0 = r * ( segments + 1 ) + s;
+			uint32_t i1 = i0 + segments + 1;
+			indices.push_back( i0 );
+			indices.push_back( i1 );
+			indices.push_back( i0 + 1 );
+			indices.push_back( i0 + 1 );
+			indices.push_back( i1 );
+			indices.push_back( i1 + 1 );
+		}
+	}
+
+	gl::VboMesh::Layout layout;
+	layout.setStaticIndices();
+	layout.setStaticPositions();
+	layout.setStaticNormals();
+	layout.setStaticTexCoords2d();
+
+	gl::VboMesh mesh( positions.size(), indices.size(), layout, GL_TRIANGLES );
+	mesh.bufferIndices( indices );
+	mesh.bufferPositions( positions );
+	mesh.bufferNormals( normals );
+	mesh.bufferTexCoords2d( 0, texCoords );
+	mesh.unbindBuffers();
+	return mesh;
+}
+
+gl::VboMesh SphereBatch::createQuad()
+{
+	// Corners in the quad's own plane, the vertex shader orients and sizes it
+	vector<Vec3f> positions;
+	positions.push_back( Vec3f( -1.0f, -1.0f, 0.0f ) );
+	positions.push_back( Vec3f(  1.0f, -1.0f, 0.0f ) );
+	positions.push_back( Vec3f(  1.0f,  1.0f, 0.0f ) );
+	positions.push_back( Vec3f( -1.0f,  1.0f, 0.0f ) );
+
+	vector<uint32_t> indices;
+	uint32_t quad[6] = { 0, 1, 2, 0, 2, 3 };
+	indices.assign( quad, quad + 6 );
+
+	gl::VboMesh::Layout layout;
+	layout.setStaticIndices();
+	layout.setStaticPositions();
+
+	gl::VboMesh mesh( positions.size(), indices.size(), layout, GL_TRIANGLES );
+	mesh.bufferIndices( indices );
+	mesh.bufferPositions( positions );
+	mesh.unbindBuffers();
+	return mesh;
+}
+
+int SphereBatch::getLod( const Sphere &sphere, const HeadCam &cam, float viewportHeight )
+{
+	// Projected radius in pixels; m11 is the projection's vertical scale
+	float dist			= std::max( sphere.getCenter().distance( cam.mEye ), 1.0f );
+	float pixelRadius	= sphere.getRadius() / dist * cam.mProjectionMatrix.m11 * viewportHeight * 0.5f;
+
+	for( int i = 0; i < NUM_LODS - 1; i++ ){
+		if( pixelRadius >= mMinPixelRadius[i] )
+			return i;
+	}
+	return NUM_LODS - 1;
+}
+
+void SphereBatch::draw( const vector<Sphere> &spheres, const HeadCam &cam, float viewportHeight, gl::GlslProg &shader )
+{
+	mNumDrawCalls = 0;
+
+	for( int i = 0; i < NUM_LODS; i++ )
+		mInstances[i].clear();
+	for( size_t i = 0; i < spheres.size(); i++ ){
+		const Sphere &sphere = spheres[i];
+		mInstances[getLod( sphere, cam, viewportHeight )].push_back( Vec4f( sphere.getCenter(), sphere.getRadius() ) );
+	}
+
+	GLint attrib = shader.getAttribLocation( "instanceSphere" );
+	if( attrib < 0 )
+		return;
+
+	// Every LOD's instances go into one buffer, one orphaning upload per view
+	mInstanceData.clear();
+	for( int i = 0; i < NUM_LODS; i++ )
+		mInstanceData.insert( mInstanceData.end(), mInstances[i].begin(), mInstances[i].end() );
+	if( mInstanceData.empty() )
+		return;
+	uploadInstances();
+
+	size_t offset = 0;
+	for( int i = 0; i < NUM_LODS; i++ ){
+		drawInstanced( mLods[i], mInstances[i], offset, attrib );
+		offset += mInstances[i].size();
+	}
+}
+
+void SphereBatch::drawImpostors( const vector<Sphere> &spheres, gl::GlslProg &shader )
+{
+	mNumDrawCalls = 0;
+
+	GLint attrib = shader.getAttribLocation( "instanceSphere" );
+	if( attrib < 0 || spheres.empty() )
+		return;
+
+	// No LODs, every sphere shares the quad
+	mInstanceData.clear();
+	for( size_t i = 0; i < spheres.size(); i++ )
+		mInstanceData.push_back( Vec4f( spheres[i].getCenter(), spheres[i].getRadius() ) );
+
+	uploadInstances();
+	drawInstanced( mQuad, mInstanceData, 0, attrib );
+}
+
+void SphereBatch::uploadInstances()
+{
+	if( ! mIsInstancingSupported )
+		return;
+
+	mInstanceVbo.bind();
+	mInstanceVbo.bufferData( mInstanceData.size() * sizeof( Vec4f ), NULL, GL_STREAM_DRAW );
+	mInstanceVbo.bufferSubData( 0, mInstanceData.size() * sizeof( Vec4f ), &mInstanceData[0] );
+	mInstanceVbo.unbind();
+}
+
+void SphereBatch::drawInstanced( gl::VboMesh &mesh, const vector<Vec4f> &instances, size_t offset, GLint attrib )
+{
+	if( instances.empty() )
+		return;
+
+	mesh.enableClientStates();
+	mesh.bindAllData();
+
+	if( mIsInstancingSupported ){
+		// offset is where these instances start in mInstanceVbo
+		mInstanceVbo.bind();
+		glEnableVertexAttribArray( attrib );
+		glVertexAttribPointer( attrib, 4, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)( offset * sizeof( Vec4f ) ) );
+		glVertexAttribDivisorARB( attrib, 1 );
+		mInstanceVbo.unbind();
+		mesh.bindIndexBuffer();
+
+		glDrawElementsInstancedARB( mesh.getPrimitiveType(), mesh.getNumIndices(), GL_UNSIGNED_INT, (GLvoid*)0, (GLsizei)instances.size() );
+		mNumDrawCalls++;
+
+		glVertexAttribDivisorARB( attrib, 0 );
+		glDisableVertexAttribArray( attrib );
+	} else {
+		// Still reuses the cached meshes, just one draw per sphere
+		for( size_t j = 0; j < instances.size(); j++ ){
+			glVertexAttrib4f( attrib, instances[j].x, instances[j].y, instances[j].z, instances[j].w );
+			glDrawElements( mesh.getPrimitiveType(), mesh.getNumIndices(), GL_UNSIGNED_INT, (GLvoid*)0 );
+			mNumDrawCalls++;
+		}
+	}
+
+	gl::VboMesh::unbindBuffers();
+	mesh.disableClientStates();
+}
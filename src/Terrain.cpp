@@ -7,6 +7,7 @@
 //
 
 #include "Terrain.h"
+#include "ResourceRegistry.h"
 
 using namespace ci;
 using std::vector;
@@ -55,6 +56,7 @@ Terrain::Terrain( int vboWidth, int vboHeight )
 	mVboMesh.bufferIndices( indices );
 	mVboMesh.bufferTexCoords2d( 0, texCoords );
 	mVboMesh.unbindBuffers();
+	ResourceRegistry::addVboMesh( mVboMesh, "Terrain", "grid" );
 }
 
 void Terrain::setup( float scale )
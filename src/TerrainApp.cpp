@@ -16,8 +16,21 @@
 #include "HeadCam.h"
 #include "Terrain.h"
 #include "RDiffusion.h"
+#include "GpuProfiler.h"
+#include "Benchmark.h"
+#include "DisplayConfig.h"
+#include "SphereBatch.h"
+#include "ShaderCache.h"
+#include "ShaderVariants.h"
+#include "ResourceRegistry.h"
+#include "AssetLoader.h"
+#include "DynamicResolution.h"
+#include "SimulationGovernor.h"
+#include "HeadPoseFilter.h"
+#include "Logger.h"
 #include "OscListener.h"
 #include "OscMessage.h"
+#include "OscDispatcher.h"
 
 using namespace ci;
 using namespace ci::app;
@@ -31,6 +44,8 @@ using namespace std;
 #define ROOM_HEIGHT		400.0f //Y dimension
 #define ROOM_WIDTH		800.0f	//X dimension
 #define ROOM_DEPTH		800.0f	//Z dimension
+#define FRAME_BUDGET_MS		( 1000.0f / 30.0f * 0.9f )	// 90% of the 30fps frame
+#define SCENE_BUDGET_SHARE	0.7f	// Of the frame budget, for the stages dynamic resolution scales
 
 class TerrainApp : public AppBasic {
   public:
@@ -43,6 +58,7 @@ class TerrainApp : public AppBasic {
 	virtual void	mouseWheel( MouseEvent event );
 	virtual void	keyDown( KeyEvent event );
 	virtual void	update();
+	virtual void	shutdown();
 	void			drawIntoRoomFbo();
 	virtual void	draw();
 	void			drawGuts(Area);
@@ -51,8 +67,11 @@ class TerrainApp : public AppBasic {
 	void			drawNodes();
 	void			drawTerrain();
 	void			drawInfoPanel();
+	float			getSceneGpuMs();
 	void			createNewWindow();
-	void			checkOSCMessage(const osc::Message*);
+	int				getCurrentWindowIndex();
+	void			setHeadFilterParams(const osc::Message&);
+	void			addHeadSample(const osc::Message&);
 	void			setCameras(Vec3f headPosition, bool fromKeyboard);
 	void 			adjustProjection(Vec3f bottomLeft, Vec3f bottomRight, Vec3f topLeft, Vec3f eyePos, float n, float f);
 
@@ -61,24 +80,29 @@ class TerrainApp : public AppBasic {
 
 	// OSC listener
 	osc::Listener   oscListener;
+	std::shared_ptr<osc::Dispatcher>	mOscDispatcher;
+	int				mHeadMailbox;
+	osc::Message	mHeadMessage;
+	osc::Message	mOscMessage;
+	HeadPoseFilter	mHeadFilter;
 	
 	// SHADERS
 	gl::GlslProg		mRoomShader;
 	gl::GlslProg		mSphereShader;
+	ShaderVariants		mRoomShaders, mSphereShaders, mTerrainShaders, mSphereImpostorShaders;
+	gl::GlslProg		mSphereImpostorShader;
+	int					mShaderVariant;
 	
 	// TEXTURES
+	AssetLoader			mAssets;
 	gl::Texture			mIconTex;
 	CubeMap				mCubeMap;
 	
 	// ROOM
 	Room				mRoom;
 	gl::Fbo				mRoomFbo;
-	gl::Texture			mRoomBackWallTex;
-	gl::Texture			mRoomLeftWallTex;
-	gl::Texture			mRoomRightWallTex;
-	gl::Texture			mRoomCeilingTex;
-	gl::Texture			mRoomFloorTex;
-	gl::Texture			mRoomBlankTex;
+	TextureArray		mRoomWallsTex;
+	gl::GlslProg		mRoomWallsShader;
 	
 	// ENVIRONMENT AND LIGHTING
 	Color				mFogColor;
@@ -98,7 +122,9 @@ class TerrainApp : public AppBasic {
 	
 	// REACTION DIFFUSION
 	RDiffusion			mRd;
+	SimulationGovernor	mSimGovernor;
 	gl::GlslProg		mRdShader, mHeightsShader, mNormalsShader, mTerrainShader;
+	ShaderCache			mShaderCache;
 	gl::Texture			mGlowTex;
 
 	// SPHERE
@@ -106,20 +132,33 @@ class TerrainApp : public AppBasic {
 	Vec3f				mSpherePos, mSpherePosDest;
 
 	std::vector<Sphere>	mRandomSpheres;
+	std::vector<Sphere>	mDrawSpheres;
+	SphereBatch			mSphereBatch;
+	bool				mUseSphereImpostors;
 	
 	// MOUSE
 	Vec2f				mMouseRightPos;
 	Vec2f				mMousePos, mMousePosNorm, mMouseDownPos, mMouseOffset;
 	bool				mMouseLeftDown, mMouseRightDown;
 
-	// Viewports
-	gl::Fbo				mFbo0, mFbo1;
-	Area				mViewArea0, mViewArea1;
+	// DYNAMIC RESOLUTION
+	DynamicResolution	mDynamicRes;
+	gl::GlslProg		mUpscaleShader;
+	Vec2f				mRoomUvScale;
 
 	// Camera stuff
-	HeadCam			mHeadCam0;
+	DisplayConfig	mDisplays;
 	HeadCam			mActiveHeadCam;
-	HeadCam			mHeadCam1;
+	int				mActiveView;
+	Area			mActiveViewport;
+	Vec3f			mHeadPos;
+
+	// PROFILING
+	GpuProfiler		mProfiler;
+	bool			mShowInfoPanel;
+
+	// BENCHMARK
+	Benchmark		mBenchmark;
 
 };
 
@@ -131,16 +170,26 @@ void TerrainApp::prepareSettings( Settings *settings )
 	settings->setWindowPos(0,0);
 }
 
-void TerrainApp::checkOSCMessage(const osc::Message * message){
-	// Sanity check that we have our legit head message
-	if (message->getAddress() == "/head" && message->getNumArgs() == 3){
-		//console() << "New message received" << std::endl;
-		float headX = message->getArgAsFloat(0);
-		float headY = message->getArgAsFloat(1);
-		float headZ = message->getArgAsFloat(2);
+// Runs on the OSC thread, the dispatcher has already checked for five floats.
+// Filter tuning: min cutoff, beta, derivative cutoff, latency and max prediction
+void TerrainApp::setHeadFilterParams(const osc::Message &message){
+	HeadPoseFilter::Params params;
+	params.mMinCutoff			= message.getArgAsFloat(0);
+	params.mBeta				= message.getArgAsFloat(1);
+	params.mDerivativeCutoff	= message.getArgAsFloat(2);
+	params.mLatency				= message.getArgAsFloat(3);
+	params.mMaxPrediction		= message.getArgAsFloat(4);
+	mHeadFilter.setParams(params);
+	LOG_INFO("Head filter: min cutoff %g beta %g latency %g max prediction %g", params.mMinCutoff, params.mBeta, params.mLatency, params.mMaxPrediction);
+}
 
-		setCameras(Vec3f(headX, headY, headZ), false);
-	}
+// Runs on the OSC thread for every /head, so the filter sees each sample at the
+// time it arrived however rarely update() gets to the mailbox
+void TerrainApp::addHeadSample(const osc::Message &message){
+	if( message.getNumArgs() != 3 || message.getArgType(0) != osc::TYPE_FLOAT || message.getArgType(1) != osc::TYPE_FLOAT || message.getArgType(2) != osc::TYPE_FLOAT )
+		return;
+	Vec3f head( message.getArgAsFloat( 0 ), message.getArgAsFloat( 1 ), message.getArgAsFloat( 2 ) );
+	mHeadFilter.addSample( head, getElapsedSeconds() - message.getReceiveAge() );
 }
 
 void TerrainApp::setCameras(Vec3f headPosition, bool fromKeyboard = false){
@@ -172,19 +221,9 @@ void TerrainApp::setCameras(Vec3f headPosition, bool fromKeyboard = false){
 	//console() << "headX: " << headX << std::endl;
 	//console() << "headZ: " << headZ << std::endl;
 
-	if (headZ > ROOM_DEPTH / 2){
-		mHeadCam0.setEye(Vec3f(headX, headY, headZ));
-	}
-	else{
-		mHeadCam0.mEye = Vec3f(0,0,1200);
-	}
-	if (headX < -ROOM_WIDTH / 2){
-		// headZ is negative here since that axis is backwards on Screen 2
-		mHeadCam1.setEye(Vec3f(headX, headY, headZ));
-	}
-	else{
-		mHeadCam1.mEye = Vec3f(-1200,0,0);
-	}
+	// Each wall only follows the head when it's in front of it
+	mHeadPos = Vec3f(headX, headY, headZ);
+	mDisplays.setHeadPosition(mHeadPos);
 }
 
 
@@ -193,67 +232,123 @@ void TerrainApp::setup()
 {	
 	setFrameRate(30);
 
-	mFbo0 = gl::Fbo(APP_WIDTH / 2, APP_HEIGHT / 2);
-	mFbo1 = gl::Fbo(APP_WIDTH / 2, APP_HEIGHT / 2);
-	
-	// Setup the camera for the main window
-	mHeadCam0 = HeadCam( 1210.0f, getWindowAspectRatio() );
-	mHeadCam0.mEye = Vec3f(-1200,0,1200);
-	mHeadCam0.mEye.y = 0;
-	mHeadCam0.mCenter = Vec3f(0,0, 0 );
+	// A fixed seed, fixed time step and scripted head path make benchmark runs repeatable
+	mBenchmark.parseArgs( getArgs() );
+	if( mBenchmark.isEnabled() ){
+		Rand::randSeed( mBenchmark.getSeed() );
+		disableFrameRate();
+	}
 
-	mHeadCam1 = HeadCam( 1200.0f, getWindowAspectRatio() );
-	mHeadCam1.mEye = Vec3f(-1210,0,0);
-	mHeadCam1.mCenter = Vec3f(0, 0, 0 );
+	// Setup the display walls, either from displays.json next to the app or the default
+	//  two screens at 90 degrees. Walls can be spread across several windows.
+	fs::path displaysPath = getAppPath() / "displays.json";
+	if( ! fs::exists( displaysPath ) || ! mDisplays.load( displaysPath, getWindowAspectRatio() ) )
+		mDisplays.setupDefault( Vec3f( ROOM_WIDTH, ROOM_HEIGHT, ROOM_DEPTH ), getWindowAspectRatio() );
+	for( int i = 1; i < mDisplays.getNumWindows(); i++ )
+		createNewWindow();
+	mHeadPos = mDisplays.getWall( 0 ).mCam.mEye;
+
+	// Set up a listener for OSC messages. Every /head goes to the filter as it
+	//  arrives, and its mailbox keeps the newest one for the info panel instead of
+	//  queueing them. Everything else is dispatched as it arrives on the listener's
+	//  thread, or in update() if it was time tagged for later.
+	mHeadMailbox = oscListener.registerMailbox("/head");
+	oscListener.setMailboxHandler(mHeadMailbox, std::bind(&TerrainApp::addHeadSample, this, std::placeholders::_1));
+	mOscDispatcher = std::shared_ptr<osc::Dispatcher>(new osc::Dispatcher);
+	mOscDispatcher->add("/headfilter", "fffff", std::bind(&TerrainApp::setHeadFilterParams, this, std::placeholders::_1));
+	oscListener.setDispatcher(mOscDispatcher);
+
+	// "--osc-shm <name>" takes messages from a tracker on the same machine through
+	//  shared memory instead of the network, the tracker writes with the same name.
+	//  The OSC block's OscHeadSender sample stands in for the tracker.
+	std::string oscSharedMemory;
+	const std::vector<std::string> &args = getArgs();
+	for( size_t i = 0; i + 1 < args.size(); i++ ){
+		if( args[i] == "--osc-shm" )
+			oscSharedMemory = args[i+1];
+	}
+	if( ! oscSharedMemory.empty() )
+		oscListener.setupSharedMemory(oscSharedMemory);
+	else
+		oscListener.setup(7111);
+
+	// GPU PROFILER
+	mProfiler.setup();
+	mShowInfoPanel	= false;
+	mActiveView		= 0;
+
+	// DYNAMIC RESOLUTION
+	// Aims for its share of the frame budget, measured on the scene and upscale
+	//  stages only since the simulation's cost doesn't change with resolution.
+	//  Needs the profiler's timings, and stays at full resolution when
+	//  benchmarking so runs are comparable.
+	mDynamicRes.setup( FRAME_BUDGET_MS * SCENE_BUDGET_SHARE );
+	mDynamicRes.setEnabled( mProfiler.isEnabled() && ! mBenchmark.isEnabled() );
+	// The simulation gets the rest of the budget, and only reacts to its own stages under the same conditions
+	mSimGovernor.setup( FRAME_BUDGET_MS * ( 1.0f - SCENE_BUDGET_SHARE ) );
+	mShaderVariant = ShaderVariants::POWER_BLEND;
+	mSimGovernor.setBudgetEnabled( mProfiler.isEnabled() && ! mBenchmark.isEnabled() );
+	mRoomUvScale	= Vec2f::one();
 
-	// Set up a listener for OSC messages
-	oscListener.setup(7111);
+	// LOAD TEXTURES
+	// Decoded on worker threads while the shaders compile. The room textures aren't
+	//  needed for the first frame and show a placeholder until they arrive, unless
+	//  we're benchmarking.
+	bool waitForAll = mBenchmark.isEnabled();
+	mAssets.setup( getAppPath() / "texturecache" );
+	DataSourceRef cubeFaces[6] = { loadResource( RES_CUBE1_ID ), loadResource( RES_CUBE2_ID ), loadResource( RES_CUBE3_ID ),
+								   loadResource( RES_CUBE4_ID ), loadResource( RES_CUBE5_ID ), loadResource( RES_CUBE6_ID ) };
+	CubeMap::Format cubeFmt;
+	cubeFmt.mCompress	= true;
+	mAssets.loadCubeMap( &mCubeMap, cubeFaces, 512, true, cubeFmt );
+	mAssets.loadTexture( &mGlowTex, loadResource( GLOW_ID ), true );
+	mAssets.loadTexture( &mGradientTex, loadResource( GRADIENT_TEX_ID ), true );
+	gl::Texture::Format repeatFmt;
+	repeatFmt.setWrap( GL_REPEAT, GL_REPEAT );
+	mAssets.loadTexture( &mSandNormalTex, loadResource( SAND_NORMAL_TEX_ID ), true, false, repeatFmt );
+	mAssets.loadTexture( &mIconTex, loadResource( ICON_TERRAIN_ID ), waitForAll );
+	// In Room's wall layer order. The walls are 800x500 and the ceiling and floor 512x512.
+	std::vector<DataSourceRef> wallLayers( Room::NUM_WALL_LAYERS );
+	wallLayers[Room::WALL_BACK]		= loadResource( BACK_WALL_TEX_ID );
+	wallLayers[Room::WALL_LEFT]		= loadResource( WALL_TEX_ID );
+	wallLayers[Room::WALL_RIGHT]	= loadResource( WALL_TEX_ID );
+	wallLayers[Room::WALL_CEILING]	= loadResource( CEILING_TEX_ID );
+	wallLayers[Room::WALL_FLOOR]	= loadResource( FLOOR_TEX_ID );
+	wallLayers[Room::WALL_BLANK]	= loadResource( BLANK_TEX_ID );
+	mAssets.loadTextureArray( &mRoomWallsTex, wallLayers, 800, 512, waitForAll, true );
 
 	// LOAD SHADERS
+	mShaderCache.setup( getAppPath() / "shadercache" );
 	try {
-		mRoomShader		= gl::GlslProg( loadResource( ROOM_VERT_ID ), loadResource( ROOM_FRAG_ID ) );
-		mRdShader		= gl::GlslProg( loadResource( PASS_THRU_VERT_ID ), loadResource( RD_FRAG_ID ) );
-		mHeightsShader	= gl::GlslProg( loadResource( PASS_THRU_VERT_ID ), loadResource( HEIGHTS_FRAG_ID ) );
-		mNormalsShader	= gl::GlslProg( loadResource( PASS_THRU_VERT_ID ), loadResource( NORMALS_FRAG_ID ) );
-		mTerrainShader	= gl::GlslProg( loadResource( TERRAIN_VERT_ID ), loadResource( TERRAIN_FRAG_ID ) );
-		mSphereShader	= gl::GlslProg( loadResource( SPHERE_VERT_ID ), loadResource( SPHERE_FRAG_ID ) );
+		mRdShader		= mShaderCache.load( loadResource( PASS_THRU_VERT_ID ), loadResource( RD_FRAG_ID ) );
+		mHeightsShader	= mShaderCache.load( loadResource( PASS_THRU_VERT_ID ), loadResource( HEIGHTS_FRAG_ID ) );
+		mNormalsShader	= mShaderCache.load( loadResource( PASS_THRU_VERT_ID ), loadResource( NORMALS_FRAG_ID ) );
+		mUpscaleShader	= mShaderCache.load( loadResource( PASS_THRU_VERT_ID ), loadResource( UPSCALE_FRAG_ID ) );
+		mRoomWallsShader = mShaderCache.load( loadResource( WALLS_VERT_ID ), loadResource( WALLS_FRAG_ID ) );
+		mRoomShaders.setup( mShaderCache, loadResource( ROOM_VERT_ID ), loadResource( ROOM_FRAG_ID ) );
+		mTerrainShaders.setup( mShaderCache, loadResource( TERRAIN_VERT_ID ), loadResource( TERRAIN_FRAG_ID ) );
+		mSphereShaders.setup( mShaderCache, loadResource( SPHERE_VERT_ID ), loadResource( SPHERE_FRAG_ID ) );
+		mSphereImpostorShaders.setup( mShaderCache, loadResource( SPHERE_IMPOSTOR_VERT_ID ), loadResource( SPHERE_FRAG_ID ), "#define SPHERE_IMPOSTOR\n" );
+		LOG_INFO( "ShaderCache: %d hits, %d misses", mShaderCache.getNumHits(), mShaderCache.getNumMisses() );
 	} catch( gl::GlslProgCompileExc e ) {
 		std::cout << e.what() << std::endl;
 		quit();
 	}
 	
-	// TEXTURE FORMAT
-	gl::Texture::Format mipFmt;
-    mipFmt.enableMipmapping( true );
-    mipFmt.setMinFilter( GL_LINEAR_MIPMAP_LINEAR );    
-    mipFmt.setMagFilter( GL_LINEAR );
-	
-	// LOAD TEXTURES
-	mIconTex		= gl::Texture( loadImage( loadResource( ICON_TERRAIN_ID ) ) );
-	mGlowTex		= gl::Texture( loadImage( loadResource( GLOW_ID ) ) );
-	mCubeMap		= CubeMap( GLsizei(512), GLsizei(512),
-							   Surface8u( loadImage( loadResource( RES_CUBE1_ID ) ) ),
-							   Surface8u( loadImage( loadResource( RES_CUBE2_ID ) ) ),
-							   Surface8u( loadImage( loadResource( RES_CUBE3_ID ) ) ),
-							   Surface8u( loadImage( loadResource( RES_CUBE4_ID ) ) ),
-							   Surface8u( loadImage( loadResource( RES_CUBE5_ID ) ) ),
-							   Surface8u( loadImage( loadResource( RES_CUBE6_ID ) ) )
-							   );
+	// SPHERE MESHES
+	mSphereBatch.setup();
 	
 	// ROOM
 	gl::Fbo::Format roomFormat;
 	roomFormat.setColorInternalFormat( GL_RGB );
 	mRoomFbo			= gl::Fbo( APP_WIDTH/ROOM_FBO_RES, APP_HEIGHT/ROOM_FBO_RES, roomFormat );
+	ResourceRegistry::addFbo( mRoomFbo, "TerrainApp", "room" );
 	bool isPowerOn		= false;
 	bool isGravityOn	= true;
 	// Build us a room of a certain size
 	mRoom				= Room( Vec3f( ROOM_WIDTH / 2, ROOM_HEIGHT / 2, ROOM_DEPTH / 2 ), isPowerOn, isGravityOn );	
-	mRoomBackWallTex	= gl::Texture( loadImage( loadResource( BACK_WALL_TEX_ID ) ) );
-	mRoomLeftWallTex	= gl::Texture( loadImage( loadResource( WALL_TEX_ID ) ) );
-	mRoomRightWallTex	= gl::Texture( loadImage( loadResource( WALL_TEX_ID ) ) );
-	mRoomCeilingTex		= gl::Texture( loadImage( loadResource( CEILING_TEX_ID ) ) );
-	mRoomFloorTex		= gl::Texture( loadImage( loadResource( FLOOR_TEX_ID ) ) );
-	mRoomBlankTex		= gl::Texture( loadImage( loadResource( BLANK_TEX_ID ) ) );
+	if( mBenchmark.isEnabled() )
+		mRoom.setFixedTimeStep( mBenchmark.getTimeStep() );
 	
 	// ENVIRONMENT AND LIGHTING
 	mFogColor		= Color( 255.0f/255.0f, 255.0f/255.0f, 230.0f/255.0f );
@@ -271,9 +366,6 @@ void TerrainApp::setup()
 	mTerrain		= Terrain( VBO_SIZE, VBO_SIZE );
 	mZoomMulti		= 1.0f;
 	mZoomMultiDest	= 1.0f;
-	mGradientTex	= gl::Texture( loadImage( loadResource( GRADIENT_TEX_ID) ) );
-	mSandNormalTex	= gl::Texture( loadImage( loadResource( SAND_NORMAL_TEX_ID ) ) );
-	mSandNormalTex.setWrap( GL_REPEAT, GL_REPEAT );
 	
 	// REACTION DIFFUSION
 	// This gets placed over the mesh I guess?
@@ -284,6 +376,7 @@ void TerrainApp::setup()
 	mSpherePosDest	= Vec3f::zero();
 	mSphere.setCenter( mSpherePosDest );
 	mSphere.setRadius( 20.0f );
+	mUseSphereImpostors = true;
 
 /*	for (int i = 0; i < 3; i++){
 		for (int j = 0; j < 3; j++){
@@ -314,6 +407,9 @@ void TerrainApp::setup()
 	mMouseRightDown	= false;
 	
 	mRoom.init();
+
+	// Everything the first frame samples has to be uploaded by now
+	mAssets.finishCritical();
 }
 
 void TerrainApp::mouseDown( MouseEvent event )
@@ -391,34 +487,53 @@ void TerrainApp::keyDown( KeyEvent event )
 		case '1':	mRd.setMode(1);				break;
 		case '2':	mRd.setMode(2);				break;
 		case '3':	mRd.setMode(3);				break;
-		case 'c':	mHeadCam0.setPreset( 0 );	break;
-		case 'C':	mHeadCam0.setPreset( 2 );	break;
-		case 'r':   mHeadCam0.setEye(Vec3f(mHeadCam0.mEye.x, mHeadCam0.mEye.y, mHeadCam0.mEye.z));	break;
+		case 'c':	mDisplays.getWall( 0 ).mCam.setPreset( 0 );	break;
+		case 'C':	mDisplays.getWall( 0 ).mCam.setPreset( 2 );	break;
+		case 'r':   setCameras(mHeadPos, true);	break;
+		case 'i':	mShowInfoPanel = !mShowInfoPanel;	break;
+		case 'p':	mProfiler.writeChromeTrace( getAppPath() / "gpu_trace.json" );	break;
+		case 'j':	ResourceRegistry::refresh();
+					ResourceRegistry::writeJson( getAppPath() / "resources.json" );	break;
+		case 'd':	mDynamicRes.setEnabled( ! mDynamicRes.isEnabled() );	break;
+		case 'm':	mUseSphereImpostors = ! mUseSphereImpostors;	break;
 		default:								break;
 	}
 	
 	switch( event.getCode() ){
 		//case KeyEvent::KEY_UP:		mMouseRightPos = Vec2f( 222.0f, 205.0f ) + getWindowCenter();	break;
-		case KeyEvent::KEY_UP:		setCameras(Vec3f(mHeadCam0.mEye.x, mHeadCam0.mEye.y, mHeadCam0.mEye.z - 100), true);
+		case KeyEvent::KEY_UP:		setCameras(mHeadPos + Vec3f(0, 0, -100), true);
 									break;
 		//case KeyEvent::KEY_LEFT:	mMouseRightPos = Vec2f(-128.0f,-178.0f ) + getWindowCenter();	break;
-		case KeyEvent::KEY_LEFT:	setCameras(Vec3f(mHeadCam0.mEye.x - 100, mHeadCam0.mEye.y, mHeadCam0.mEye.z), true);
+		case KeyEvent::KEY_LEFT:	setCameras(mHeadPos + Vec3f(-100, 0, 0), true);
 									break;
 			//case KeyEvent::KEY_RIGHT:	mMouseRightPos = Vec2f(-256.0f, 122.0f ) + getWindowCenter();	break;
-		case KeyEvent::KEY_RIGHT:	setCameras(Vec3f(mHeadCam0.mEye.x + 100, mHeadCam0.mEye.y, mHeadCam0.mEye.z), true);	break;
+		case KeyEvent::KEY_RIGHT:	setCameras(mHeadPos + Vec3f(100, 0, 0), true);	break;
 		//case KeyEvent::KEY_DOWN:	mMouseRightPos = Vec2f(   0.0f,   0.0f ) + getWindowCenter();	break;
-		case KeyEvent::KEY_DOWN:	setCameras(Vec3f(mHeadCam0.mEye.x, mHeadCam0.mEye.y, mHeadCam0.mEye.z + 100), true);
+		case KeyEvent::KEY_DOWN:	setCameras(mHeadPos + Vec3f(0, 0, 100), true);
 									break;
 		default: break;
 	}
 	
-	std::cout << "F: " << mRd.mParamF << " K: " << mRd.mParamK << std::endl;
+	LOG_INFO( "F: %g K: %g", mRd.mParamF, mRd.mParamK );
 }
 
 
 
 void TerrainApp::update()
 {	
+	mProfiler.beginFrame();
+	mDynamicRes.update( getSceneGpuMs() );
+	if( mBenchmark.isEnabled() )
+		mBenchmark.beginFrame();
+	mAssets.update();
+	
+	// HEAD TRACKING
+	// The filter already has every sample, this is only the raw pose for the info panel
+	oscListener.getLatestMessage( mHeadMailbox, &mHeadMessage );
+	// Releases scheduled messages to the dispatcher. Nothing reads the rest, drain them so the queue never fills.
+	while( oscListener.getNextMessage( &mOscMessage ) )
+		;
+
 	//float x = mMouseRightPos.x - getWindowSize().x * 0.5f;
 	//float y = mSphere.getCenter().y;
 	//float z = mMouseRightPos.y - getWindowSize().y * 0.5f;
@@ -433,6 +548,13 @@ void TerrainApp::update()
 	// ROOM
 	mRoom.update();
 	
+	// SHADER VARIANTS
+	mShaderVariant	= ShaderVariants::getVariant( mRoom.getPower() );
+	mRoomShader		= mRoomShaders.get( mShaderVariant );
+	mTerrainShader	= mTerrainShaders.get( mShaderVariant );
+	mSphereShader	= mSphereShaders.get( mShaderVariant );
+	mSphereImpostorShader = mSphereImpostorShaders.get( mShaderVariant );
+	
 	mZoomMulti		-= ( mZoomMulti - mZoomMultiDest ) * 0.1f;
 	
 	gl::disableDepthRead();
@@ -441,55 +563,63 @@ void TerrainApp::update()
 	gl::disableAlphaBlending();
 	
 	// REACTION DIFFUSION
-	mRd.update( mRoom.getTimeDelta(), &mRdShader, mGlowTex, mMouseRightDown, mSphere.getCenter().xz(), mZoomMulti );
+	// Normals only run every few frames at the lower levels, the average is per run
+	mSimGovernor.update( mProfiler.getAverageMs( "rd" ) + mProfiler.getAverageMs( "heights" ) +
+						 mProfiler.getAverageMs( "normals" ) / mSimGovernor.getNormalsInterval() );
+	mProfiler.begin( "rd" );
+	mRd.update( mRoom.getTimeDelta(), &mRdShader, mGlowTex, mMouseRightDown, mSphere.getCenter().xz(), mZoomMulti, mSimGovernor.getIterations() );
+	mProfiler.end();
+	mProfiler.begin( "heights" );
 	mRd.drawIntoHeightsFbo( &mHeightsShader, mTerrainScale );
-	mRd.drawIntoNormalsFbo( &mNormalsShader );
+	mProfiler.end();
+	if( mSimGovernor.shouldUpdateNormals() ){
+		mProfiler.begin( "normals" );
+		mRd.drawIntoNormalsFbo( &mNormalsShader );
+		mProfiler.end();
+	}
 	
 	
 	// CAMERA
 	HeadCam *thisViewsCam = getWindow()->getUserData<HeadCam>();
-			// Get in OSC data
-	osc::Message headMessage;
-
-	while( oscListener.hasWaitingMessages() ) {
-		osc::Message message;
-		oscListener.getNextMessage( &message );
-		
-		checkOSCMessage(&message);
-	}
+	// Tracked heads are applied per window in draw(), closer to scanout
+	if( mBenchmark.isEnabled() )
+		setCameras( mBenchmark.getHeadPosition(), true );
 
 	//if( mMouseLeftDown ) 
 	//	mActiveHeadCam.dragCam( ( mMouseOffset ) * 0.01f, ( mMouseOffset ).length() * 0.01 );
 	//mActiveHeadCam.update( mRoom.getPower(), 0.5f );
 
-	Vec3f topLeft = Vec3f(-ROOM_WIDTH/2, ROOM_HEIGHT/2, ROOM_DEPTH/2);
-	Vec3f bottomLeft = Vec3f(-ROOM_WIDTH/2, -ROOM_HEIGHT/2, ROOM_DEPTH/2);
-	Vec3f bottomRight = Vec3f(ROOM_WIDTH/2, -ROOM_HEIGHT/2, ROOM_DEPTH/2);
-
-	// Update the cameras, setting the projection offsets correctly
-	Vec3f straightAhead = Vec3f(mHeadCam0.mEye.x, mHeadCam0.mEye.y, 0);
-
-//	mHeadCam0.update(straightAhead, -ROOM_WIDTH/2 - mHeadCam0.mEye.x, ROOM_WIDTH/2 -  mHeadCam0.mEye.x, 
-//		                             ROOM_HEIGHT/2, -ROOM_HEIGHT/2, 
-//									 mHeadCam0.mEye.z - ROOM_DEPTH/2, ROOM_DEPTH * 2);
-	mHeadCam0.update(topLeft, bottomLeft, bottomRight, 10000);
-
-	console() << "cam0 position" << mHeadCam0.mEye << std::endl;
+	// Update every wall's camera, setting the projection offsets correctly
+	mDisplays.update(10000);
 
-	// Now update Camera 1
+	// Walks every GL object with glIs* under the registry's lock, so not every frame and not while
+	// the profiler is timing. 'j' refreshes before it dumps.
+	static Logger::RateLimit sRegistryRefreshLimit;
+	if( sRegistryRefreshLimit.allow( 1.0 ) )
+		ResourceRegistry::refresh();
 
-	topLeft = Vec3f(-ROOM_WIDTH/2, ROOM_HEIGHT/2, -ROOM_DEPTH/2);
-    bottomLeft = Vec3f(-ROOM_WIDTH/2, -ROOM_HEIGHT/2, -ROOM_DEPTH/2);
-	bottomRight = Vec3f(-ROOM_WIDTH/2, -ROOM_HEIGHT/2, ROOM_DEPTH/2);
-
-	straightAhead = Vec3f(0, mHeadCam1.mEye.y, mHeadCam1.mEye.z);
-	// This is different from the above, since our axes are rotated for this camera.
-	//  Therfore, we set up a window for viewing that flips the x's and z's
+	static Logger::RateLimit sCamLogLimit;
+	if( sCamLogLimit.allow( 1.0 ) ){
+		for( size_t i = 0; i < mDisplays.getNumWalls(); i++ ){
+			Vec3f eye = mDisplays.getWall( i ).mCam.mEye;
+			LOG_DEBUG( "cam%d position [%g,%g,%g]", i, eye.x, eye.y, eye.z );
+		}
+	}
 
-	mHeadCam1.update(topLeft, bottomLeft, bottomRight, 10000);
+}
 
-	console() << "cam1 position" << mHeadCam1.mEye << std::endl;
+// The stages whose cost follows the render resolution, across every view
+float TerrainApp::getSceneGpuMs()
+{
+	return mProfiler.getAverageMsWithPrefix( "roomFbo" ) + mProfiler.getAverageMsWithPrefix( "walls" ) +
+		   mProfiler.getAverageMsWithPrefix( "terrain" ) + mProfiler.getAverageMsWithPrefix( "sphere" ) +
+		   mProfiler.getAverageMsWithPrefix( "upscale" );
+}
 
+void TerrainApp::shutdown()
+{
+	mAssets.shutdown();
+	Logger::shutdown();
 }
 
 void TerrainApp::drawIntoRoomFbo()
@@ -499,8 +629,11 @@ void TerrainApp::drawIntoRoomFbo()
 	mRoomFbo.bindFramebuffer();
 	gl::clear( ColorA( 0.0f, 0.0f, 0.0f, 0.0f ), true );
 	
+	// The room follows the scene's resolution scale, only the lower left corner is rendered
+	Vec2i roomSize = mDynamicRes.isEnabled() ? mDynamicRes.getRenderSize( mRoomFbo.getSize() ) : mRoomFbo.getSize();
+	mRoomUvScale = Vec2f( roomSize.x / (float)mRoomFbo.getWidth(), roomSize.y / (float)mRoomFbo.getHeight() );
 	gl::setMatricesWindow( mRoomFbo.getSize(), false );
-	gl::setViewport( mRoomFbo.getBounds() );
+	gl::setViewport( Area( Vec2i::zero(), roomSize ) );
 	gl::disableAlphaBlending();
 	gl::enable( GL_TEXTURE_2D );
 	glEnable( GL_CULL_FACE );
@@ -537,16 +670,56 @@ void TerrainApp::draw(){
 		SendInput(1, &Input, sizeof(Input));
 	}
 	*/
-	mViewArea0 = Area(0, 0, getWindowSize().x / 2,getWindowSize().y);
-	mViewArea1 = Area(getWindowSize().x / 2, 0, getWindowSize().x, getWindowSize().y);
-
 	gl::clear( ColorA( 0.1f, 0.1f, 0.1f, 0.0f ), true );
 
-	mActiveHeadCam = mHeadCam0;
-	drawGuts(mViewArea1);
+	// The simulation was stepped once in update(), here we only draw the walls that
+	//  belong to the window being drawn
+	int windowIndex = getCurrentWindowIndex();
+
+	// Extrapolate the tracked head to when this window will be on screen
+	double now = getElapsedSeconds();
+	if( ! mBenchmark.isEnabled() && mHeadFilter.isTracking( now ) ){
+		setCameras( mHeadFilter.predict( now + mHeadFilter.getParams().mLatency ), false );
+		mDisplays.update(10000);
+	}
+
+	for( size_t i = 0; i < mDisplays.getNumWalls(); i++ ){
+		DisplayWall &wall = mDisplays.getWall( i );
+		if( wall.mWindow != windowIndex )
+			continue;
+		mActiveHeadCam = wall.mCam;
+		mActiveView = (int)i;
+		drawGuts( wall.getViewportArea( getWindowSize() ) );
+	}
+
+	// DRAW INFO PANEL
+	if( mShowInfoPanel ){
+		gl::setViewport( getWindowBounds() );
+		drawInfoPanel();
+	}
 
-	mActiveHeadCam = mHeadCam1;
-	drawGuts(mViewArea0);
+	if( mBenchmark.isEnabled() ){
+		bool capture = mBenchmark.shouldCapture();
+		vector<fs::path> capturePaths;
+		for( size_t i = 0; i < mDisplays.getNumWalls(); i++ )
+			capturePaths.push_back( mBenchmark.getCapturePath( (int)i ) );
+
+		// A frame ends once its last window has been drawn. Captures happen after the
+		//  frame is timed so they don't skew the results.
+		if( windowIndex == mDisplays.getNumWindows() - 1 )
+			mBenchmark.endFrame();
+		if( capture ){
+			for( size_t i = 0; i < mDisplays.getNumWalls(); i++ ){
+				DisplayWall &wall = mDisplays.getWall( i );
+				if( wall.mWindow == windowIndex )
+					writeImage( capturePaths[i], copyWindowSurface( wall.getWindowArea( getWindowSize() ) ) );
+			}
+		}
+		if( mBenchmark.isFinished() ){
+			mBenchmark.writeResults( getAppPath() / "benchmark.json" );
+			quit();
+		}
+	}
 }
 
 void TerrainApp::drawGuts(Area area)
@@ -557,12 +730,24 @@ void TerrainApp::drawGuts(Area area)
 	// ROOM
 	// This used to be in Update for some reason.
 	// That made it not be able to get the correct rendering camera.
+	string view = "[" + toString( mActiveView ) + "]";
+	mProfiler.begin( "roomFbo" + view );
 	drawIntoRoomFbo();
-	
+	mProfiler.end();
+	
+	// SCENE TARGET
+	// With dynamic resolution the view is drawn offscreen at the current scale and
+	//  upscaled at the end, otherwise straight into its viewport
+	bool isOffscreen = mDynamicRes.isEnabled();
+	if( isOffscreen ){
+		mDynamicRes.bind( mActiveView, area.getSize() );
+		gl::clear( ColorA( 0.0f, 0.0f, 0.0f, 0.0f ), true );
+		mActiveViewport = Area( Vec2i::zero(), mDynamicRes.getRenderSize( area.getSize() ) );
+	} else {
+		gl::setViewport(area);
+		mActiveViewport = area;
+	}
 	gl::setMatricesWindow( getWindowSize(), false );
-	// Set the viewport to match the whole thing
-//	gl::setViewport( getWindowBounds() );
-	gl::setViewport(area);
 	
 
 	gl::disableDepthRead();
@@ -575,21 +760,28 @@ void TerrainApp::drawGuts(Area area)
 	// DRAW ROOM FBO
 	// Bind 
 	mRoomFbo.bindTexture();
+	glMatrixMode( GL_TEXTURE );
+	glPushMatrix();
+	glLoadIdentity();
+	glScalef( mRoomUvScale.x, mRoomUvScale.y, 1.0f );
+	glMatrixMode( GL_MODELVIEW );
 	gl::drawSolidRect( getWindowBounds() );
+	glMatrixMode( GL_TEXTURE );
+	glPopMatrix();
+	glMatrixMode( GL_MODELVIEW );
 	//HeadCam *thisViewsCam = getWindow()->getUserData<HeadCam>();
 	//gl::setMatrices( mActiveHeadCam.getCam() );
 
 	gl::color( ColorA( power, power, power, power * 0.1f + 0.9f ) );
 	
 
-	// DRAW INFO PANEL
-	//drawInfoPanel();
-	
 	gl::enable( GL_TEXTURE_2D );
 	gl::color( ColorA( 1.0f, 1.0f, 1.0f, 1.0f ) );
 	
 	// DRAW WALLS
-	mRoom.drawWalls( mRoom.getPower(), mRoomBackWallTex, mRoomLeftWallTex, mRoomRightWallTex, mRoomCeilingTex, mRoomFloorTex, mRoomBlankTex );
+	mProfiler.begin( "walls" + view );
+	mRoom.drawWalls( mRoom.getPower(), mRoomWallsTex, mRoomWallsShader );
+	mProfiler.end();
 	
 	gl::enableAlphaBlending();
 	gl::enableDepthRead();
@@ -597,48 +789,65 @@ void TerrainApp::drawGuts(Area area)
 	gl::enable( GL_TEXTURE_2D );
 	
 	// DRAW TERRAIN
+	mProfiler.begin( "terrain" + view );
 	drawTerrain();
+	mProfiler.end();
 	
 	gl::disable( GL_TEXTURE_2D );
 	
 	// DRAW SPHERE
+	mProfiler.begin( "sphere" + view );
 	drawSphere();
+	mProfiler.end();
+	
+	// UPSCALE
+	if( isOffscreen ){
+		mDynamicRes.unbind( mActiveView );
+		gl::setViewport( area );
+		gl::disableDepthRead();
+		gl::disableDepthWrite();
+		gl::disableAlphaBlending();
+		gl::color( Color::white() );
+		mProfiler.begin( "upscale" + view );
+		mDynamicRes.drawUpscaled( mActiveView, mUpscaleShader );
+		mProfiler.end();
+	}
 }
 
 void TerrainApp::drawSphere()
 {
 	HeadCam *thisViewsCam = getWindow()->getUserData<HeadCam>();
-	Vec3f spherePos = mSphere.getCenter();
-	Vec3f roomDims	= mRoom.getDims();
-	float x = ( spherePos.x + roomDims.x ) / ( roomDims.x * 2.0f );
-	float y = ( spherePos.z + roomDims.z ) / ( roomDims.z * 2.0f );
 
-	Vec2f texCoord = Vec2f( x, y );
+	// The shader works out each sphere's terrain lookup from its center and roomDims
+	mDrawSpheres.clear();
+	mDrawSpheres.push_back( mSphere );
+	mDrawSpheres.insert( mDrawSpheres.end(), mRandomSpheres.begin(), mRandomSpheres.end() );
+	
+	// Impostors share the mesh shader's uniforms, only the vertex stage differs
+	gl::GlslProg &shader = mUseSphereImpostors ? mSphereImpostorShader : mSphereShader;
 	
 	mCubeMap.bind();
 	mRd.getHeightsTexture().bind( 1 );
 	mRd.getNormalsTexture().bind( 2 );
-	mSphereShader.bind();
-	mSphereShader.uniform( "cubeMap", 0 );
-	mSphereShader.uniform( "heightsTex", 1 );
-	mSphereShader.uniform( "normalsTex", 2 );
-	mSphereShader.uniform( "mvpMatrix", mActiveHeadCam.mMvpMatrix );
-	mSphereShader.uniform( "terrainScale", mTerrainScale );
-	mSphereShader.uniform( "eyePos", mActiveHeadCam.getEye() );
-	mSphereShader.uniform( "fogColor", mFogColor );
-	mSphereShader.uniform( "sandColor", mSandColor );
-	mSphereShader.uniform( "power", mRoom.getPower() );
-	mSphereShader.uniform( "roomDims", mRoom.getDims() );
-	mSphereShader.uniform( "texCoord", texCoord );
-	mSphereShader.uniform( "sphereRadius", mSphere.getRadius() * 0.45f );
-	mSphereShader.uniform( "zoomMulti", mZoomMulti );
-	mSphereShader.uniform( "timePer", mRoom.getTimePer() * 1.5f + 0.5f );
-	gl::draw( mSphere, 128 );
-
-	for (unsigned int i = 0; i < mRandomSpheres.size(); i++){
-		gl::draw(mRandomSpheres[i], 20);
-	}
-	mSphereShader.unbind();
+	shader.bind();
+	shader.uniform( "cubeMap", 0 );
+	shader.uniform( "heightsTex", 1 );
+	shader.uniform( "normalsTex", 2 );
+	shader.uniform( "mvpMatrix", mActiveHeadCam.mMvpMatrix );
+	shader.uniform( "terrainScale", mTerrainScale );
+	shader.uniform( "eyePos", mActiveHeadCam.getEye() );
+	shader.uniform( "fogColor", mFogColor );
+	shader.uniform( "sandColor", mSandColor );
+	shader.uniform( "power", mRoom.getPower() );
+	shader.uniform( "roomDims", mRoom.getDims() );
+	shader.uniform( "sphereRadius", mSphere.getRadius() * 0.45f );
+	shader.uniform( "zoomMulti", mZoomMulti );
+	shader.uniform( "timePer", mRoom.getTimePer() * 1.5f + 0.5f );
+	if( mUseSphereImpostors )
+		mSphereBatch.drawImpostors( mDrawSpheres, shader );
+	else
+		mSphereBatch.draw( mDrawSpheres, mActiveHeadCam, (float)mActiveViewport.getHeight(), shader );
+	shader.unbind();
 }
 
 void TerrainApp::drawTerrain()
@@ -673,8 +882,9 @@ void TerrainApp::drawTerrain()
 void TerrainApp::drawInfoPanel()
 {
 	gl::pushMatrices();
-	gl::translate( mRoom.getDims() );
-	gl::scale( Vec3f( -1.0f, -1.0f, 1.0f ) );
+	gl::setMatricesWindow( getWindowSize() );
+	gl::disableDepthRead();
+	gl::disableDepthWrite();
 	gl::color( Color( 1.0f, 1.0f, 1.0f ) * ( 1.0f - mRoom.getPower() ) );
 	gl::enableAlphaBlending();
 	
@@ -682,7 +892,7 @@ void TerrainApp::drawInfoPanel()
 	
 	float X0			= 15.0f;
 	float X1			= X0 + iconWidth;
-	float Y0			= 300.0f;
+	float Y0			= 15.0f;
 	float Y1			= Y0 + iconWidth;
 	
 	// DRAW ROOM NUM AND DESC
@@ -702,6 +912,33 @@ void TerrainApp::drawInfoPanel()
 	float fpsPer		= getAverageFps()/60.0f;
 	gl::drawSolidRect( Rectf( Vec2f( X0, Y1 + 4.0f + 4.0f ), Vec2f( X0 + fpsPer * ( iconWidth ), Y1 + 4.0f + 6.0f ) ) );
 	
+	// DRAW GPU TIMINGS
+	float Y = Y1 + 20.0f;
+	gl::drawString( "fps: " + toString( (int)getAverageFps() ), Vec2f( X0, Y ), Color::white() );
+	Y += 12.0f;
+	const vector<GpuProfiler::Stage> &stages = mProfiler.getStages();
+	for( size_t i = 0; i < stages.size(); i++ ){
+		float ms = mProfiler.getAverageMs( stages[i].mName );
+		gl::drawString( stages[i].mName + ": " + toString( ms ) + " ms", Vec2f( X0, Y ), Color::white() );
+		Y += 12.0f;
+	}
+	gl::drawString( "gpu total: " + toString( mProfiler.getTotalAverageMs() ) + " ms", Vec2f( X0, Y ), Color::white() );
+	Y += 12.0f;
+	string scale = mDynamicRes.isEnabled() ? toString( mDynamicRes.getScale() ) : "off";
+	gl::drawString( "resolution scale: " + scale, Vec2f( X0, Y ), Color::white() );
+	Y += 12.0f;
+	gl::drawString( "sim level: " + toString( mSimGovernor.getLevelIndex() ) + " (" + toString( mSimGovernor.getIterations() ) + " iterations)", Vec2f( X0, Y ), Color::white() );
+	Y += 12.0f;
+	gl::drawString( "shader variant: " + string( ShaderVariants::getVariantName( mShaderVariant ) ), Vec2f( X0, Y ), Color::white() );
+	Y += 12.0f;
+	gl::drawString( "gpu memory: " + toString( ResourceRegistry::getGpuBytes() / ( 1024 * 1024 ) ) + " MB, leaks: " + toString( ResourceRegistry::getNumLeaks() ), Vec2f( X0, Y ), Color::white() );
+	Y += 12.0f;
+	if( mHeadMessage.getNumArgs() == 3 && mHeadMessage.getArgType(0) == osc::TYPE_FLOAT && mHeadMessage.getArgType(1) == osc::TYPE_FLOAT && mHeadMessage.getArgType(2) == osc::TYPE_FLOAT ){
+		Vec3f head( mHeadMessage.getArgAsFloat( 0 ), mHeadMessage.getArgAsFloat( 1 ), mHeadMessage.getArgAsFloat( 2 ) );
+		gl::drawString( "head: " + toString( head ) + " (" + toString( (int)( mHeadMessage.getReceiveAge() * 1000 ) ) + " ms ago)", Vec2f( X0, Y ), Color::white() );
+	}
+	else
+		gl::drawString( "head: none", Vec2f( X0, Y ), Color::white() );
 	
 	gl::popMatrices();
 }
@@ -722,8 +959,6 @@ class WindowData {
 void TerrainApp::createNewWindow()
 {
 	app::WindowRef newWindow = createWindow( Window::Format().size( APP_WIDTH, APP_HEIGHT ) );
-	mHeadCam1 = HeadCam( -1000.0f, getWindowAspectRatio() );
-	newWindow->setUserData( &mHeadCam1  ); //new WindowData );
 	
 	// for demonstration purposes, we'll connect a lambda unique to this window which fires on close
 	int uniqueId = getNumWindows();
@@ -732,6 +967,15 @@ void TerrainApp::createNewWindow()
 		);
 }
 
+int TerrainApp::getCurrentWindowIndex()
+{
+	for( size_t i = 0; i < getNumWindows(); i++ ){
+		if( getWindowIndex( i ) == getWindow() )
+			return (int)i;
+	}
+	return 0;
+}
+
 void TerrainApp::adjustProjection(Vec3f bottomLeft, Vec3f bottomRight, Vec3f topLeft, Vec3f eyePos, float n, float f)
 {
 	Vec3f va, vb, vc;
@@ -0,0 +1,180 @@
+//
+//  TextureArray.cpp
+//  KinectTerrain
+//
+
+#include "TextureArray.h"
+#include "Logger.h"
+#include "ResourceRegistry.h"
+#include "cinder/ip/Resize.h"
+#include <fstream>
+
+#ifndef GL_TEXTURE_2D_ARRAY_EXT
+	#define GL_TEXTURE_2D_ARRAY_EXT			0x8C1A
+#endif
+
+using namespace ci;
+using std::vector;
+
+static const uint32_t CONTAINER_MAGIC	= 0x52524154;	// "TARR"
+static const uint32_t CONTAINER_VERSION	= 1;
+
+// Level 0 of every layer, the way glGetCompressedTexImage and glCompressedTexImage3D lay it out
+static size_t getDataSize( int width, int height, int numLayers, GLenum internalFormat )
+{
+	// DXT1 is 8 bytes per 4x4 block
+	if( internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT )
+		return (size_t)( ( width + 3 ) / 4 ) * ( ( height + 3 ) / 4 ) * 8 * numLayers;
+	return (size_t)width * height * 4 * numLayers;
+}
+
+TextureArray::Obj::~Obj()
+{
+	if( mId )
+		glDeleteTextures( 1, &mId );
+}
+
+TextureArray::TextureArray()
+{
+}
+
+TextureArray::TextureArray( int width, int height, const vector<Surface8u> &layers, bool compress )
+{
+	if( ! isSupported() || layers.empty() ){
+		LOG_WARNING( "TextureArray: EXT_texture_array not available or no layers given" );
+		return;
+	}
+
+	// The driver compresses each layer as it's uploaded, like CubeMap's faces
+	compress = compress && gl::isExtensionAvailable( "GL_EXT_texture_compression_s3tc" );
+	GLenum internalFormat = compress ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_RGBA8;
+	allocate( width, height, (int)layers.size(), internalFormat );
+	glTexImage3D( GL_TEXTURE_2D_ARRAY_EXT, 0, internalFormat, width, height, (GLsizei)layers.size(), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL );
+
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+	for( size_t i = 0; i < layers.size(); i++ ){
+		Surface8u layer = layers[i];
+		if( ! layer )
+			continue;
+
+		if( ! layer.hasAlpha() || layer.getChannelOrder().getCode() != SurfaceChannelOrder::RGBA ){
+			Surface8u rgba( layer.getWidth(), layer.getHeight(), true, SurfaceChannelOrder::RGBA );
+			rgba.copyFrom( layer, layer.getBounds() );
+			layer = rgba;
+		}
+		if( layer.getWidth() != width || layer.getHeight() != height )
+			layer = ip::resize( layer, layer.getBounds(), Vec2i( width, height ) );
+
+		glPixelStorei( GL_UNPACK_ROW_LENGTH, layer.getRowBytes() / 4 );
+		glTexSubImage3D( GL_TEXTURE_2D_ARRAY_EXT, 0, 0, 0, (GLint)i, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, layer.getData() );
+	}
+	glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+
+	glBindTexture( GL_TEXTURE_2D_ARRAY_EXT, 0 );
+}
+
+void TextureArray::allocate( int width, int height, int numLayers, GLenum internalFormat )
+{
+	mObj = std::shared_ptr<Obj>( new Obj );
+	mObj->mWidth			= width;
+	mObj->mHeight			= height;
+	mObj->mNumLayers		= numLayers;
+	mObj->mInternalFormat	= internalFormat;
+
+	glGenTextures( 1, &mObj->mId );
+	glBindTexture( GL_TEXTURE_2D_ARRAY_EXT, mObj->mId );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY_EXT, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY_EXT, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY_EXT, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY_EXT, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	ResourceRegistry::add( ResourceRegistry::TEXTURE, mObj->mId, "TextureArray", "texture array", internalFormat, width, height, numLayers,
+						   getDataSize( width, height, numLayers, internalFormat ), mObj );
+}
+
+TextureArray TextureArray::load( const fs::path &path )
+{
+	std::ifstream file( path.string().c_str(), std::ios::binary );
+	if( ! file || ! isSupported() )
+		return TextureArray();
+
+	uint32_t header[6];		// magic, version, width, height, layers, internal format
+	if( ! file.read( (char*)header, sizeof( header ) ) || header[0] != CONTAINER_MAGIC || header[1] != CONTAINER_VERSION )
+		return TextureArray();
+
+	GLenum internalFormat	= header[5];
+	bool isCompressed		= internalFormat != GL_RGBA8;
+	if( isCompressed && ! gl::isExtensionAvailable( "GL_EXT_texture_compression_s3tc" ) )
+		return TextureArray();
+
+	size_t dataSize = getDataSize( header[2], header[3], header[4], internalFormat );
+	vector<char> data( dataSize );
+	if( dataSize == 0 || ! file.read( &data[0], dataSize ) )
+		return TextureArray();
+
+	TextureArray textureArray;
+	textureArray.allocate( header[2], header[3], header[4], internalFormat );
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+	if( isCompressed )
+		glCompressedTexImage3D( GL_TEXTURE_2D_ARRAY_EXT, 0, internalFormat, header[2], header[3], header[4], 0, (GLsizei)dataSize, &data[0] );
+	else
+		glTexImage3D( GL_TEXTURE_2D_ARRAY_EXT, 0, internalFormat, header[2], header[3], header[4], 0, GL_RGBA, GL_UNSIGNED_BYTE, &data[0] );
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+	glBindTexture( GL_TEXTURE_2D_ARRAY_EXT, 0 );
+	return textureArray;
+}
+
+bool TextureArray::write( const fs::path &path )
+{
+	if( ! mObj )
+		return false;
+
+	bool isCompressed	= mObj->mInternalFormat != GL_RGBA8;
+	size_t dataSize		= getDataSize( mObj->mWidth, mObj->mHeight, mObj->mNumLayers, mObj->mInternalFormat );
+	glBindTexture( GL_TEXTURE_2D_ARRAY_EXT, mObj->mId );
+
+	// Only cached if the driver kept the blocks load() will hand back to it
+	GLint storedSize = 0;
+	if( isCompressed )
+		glGetTexLevelParameteriv( GL_TEXTURE_2D_ARRAY_EXT, 0, GL_TEXTURE_COMPRESSED_IMAGE_SIZE_ARB, &storedSize );
+	if( isCompressed && (size_t)storedSize != dataSize ){
+		glBindTexture( GL_TEXTURE_2D_ARRAY_EXT, 0 );
+		return false;
+	}
+
+	vector<char> data( dataSize );
+	glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+	if( isCompressed )
+		glGetCompressedTexImage( GL_TEXTURE_2D_ARRAY_EXT, 0, &data[0] );
+	else
+		glGetTexImage( GL_TEXTURE_2D_ARRAY_EXT, 0, GL_RGBA, GL_UNSIGNED_BYTE, &data[0] );
+	glPixelStorei( GL_PACK_ALIGNMENT, 4 );
+	glBindTexture( GL_TEXTURE_2D_ARRAY_EXT, 0 );
+
+	std::ofstream file( path.string().c_str(), std::ios::binary | std::ios::trunc );
+	if( ! file )
+		return false;
+	uint32_t header[6] = { CONTAINER_MAGIC, CONTAINER_VERSION, (uint32_t)mObj->mWidth, (uint32_t)mObj->mHeight, (uint32_t)mObj->mNumLayers, mObj->mInternalFormat };
+	file.write( (const char*)header, sizeof( header ) );
+	file.write( &data[0], dataSize );
+	return (bool)file;
+}
+
+bool TextureArray::isSupported()
+{
+	return gl::isExtensionAvailable( "GL_EXT_texture_array" );
+}
+
+void TextureArray::bind( int unit )
+{
+	glActiveTexture( GL_TEXTURE0 + unit );
+	glBindTexture( GL_TEXTURE_2D_ARRAY_EXT, getId() );
+	glActiveTexture( GL_TEXTURE0 );
+}
+
+void TextureArray::unbind( int unit )
+{
+	glActiveTexture( GL_TEXTURE0 + unit );
+	glBindTexture( GL_TEXTURE_2D_ARRAY_EXT, 0 );
+	glActiveTexture( GL_TEXTURE0 );
+}